@@ -0,0 +1,68 @@
+/* arena.c
+ * Akira Youngblood, 2026-10-17
+ * Hostname arenas for multi-lookup's requesters
+ */
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+struct arena_chunk_s {
+    // Names released minus names carved, once the carved ones are added
+    // in: zero means the chunk is free to go
+    atomic_long refs;
+    char data[];
+};
+
+#define CHUNK_DATA (ARENA_CHUNK_SIZE - offsetof(arena_chunk, data))
+
+static arena_chunk* chunk_of(const char* name) {
+    return (arena_chunk*)((uintptr_t)name & ~(uintptr_t)(ARENA_CHUNK_SIZE - 1));
+}
+
+// Add the names carved from a chunk that is no longer filled. If every one
+// of them was released already, nobody else will, so free it here.
+static void retire(name_arena* a) {
+    if (a->chunk == NULL) return;
+    if (atomic_fetch_add(&a->chunk->refs, a->carved) + a->carved == 0) free(a->chunk);
+    a->chunk = NULL;
+}
+
+void arena_init(name_arena* a) {
+    memset(a, 0, sizeof(*a));
+}
+
+char* arena_copy(name_arena* a, const char* s, size_t len) {
+    char* name;
+    if (len + 1 > CHUNK_DATA) return NULL;
+    if (a->chunk == NULL || a->used + len + 1 > CHUNK_DATA) {
+        void* mem;
+        retire(a);
+        if (posix_memalign(&mem, ARENA_CHUNK_SIZE, ARENA_CHUNK_SIZE)) return NULL;
+        a->chunk = mem;
+        atomic_init(&a->chunk->refs, 0);
+        a->used = 0;
+        a->carved = 0;
+        a->chunks++;
+    }
+    name = a->chunk->data + a->used;
+    memcpy(name, s, len);
+    name[len] = '\0';
+    a->used += len + 1;
+    a->carved++;
+    a->names++;
+    return name;
+}
+
+void arena_release(char* name) {
+    arena_chunk* c = chunk_of(name);
+    // Until retire() adds the carved names, this only goes negative
+    if (atomic_fetch_sub(&c->refs, 1) - 1 == 0) free(c);
+}
+
+void arena_finish(name_arena* a) {
+    retire(a);
+}
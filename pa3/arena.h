@@ -0,0 +1,55 @@
+/* arena.h
+ * Akira Youngblood, 2026-10-17
+ * Hostname arenas for multi-lookup's requesters
+ *
+ * Without them every name read from a file is its own malloc(), freed by a
+ * resolver on another thread: two allocator calls per name, and the free
+ * goes back to the requester's malloc arena under that arena's lock, in
+ * contention with the requester's next malloc().
+ *
+ * A requester instead copies its names one after another into chunks of
+ * ARENA_CHUNK_SIZE bytes. Chunks are allocated aligned to their size, so a
+ * name's chunk is found by masking its address, with nothing stored per
+ * name. Each chunk counts the names still out; a resolver done with a name
+ * drops the count with one atomic decrement, and whoever drops the last one
+ * frees the chunk. While a chunk is still being filled its count can't
+ * reach zero: the requester only adds the names it carved once it moves on
+ * to the next chunk (or is done), so the hot path takes no shared write at
+ * all on the requester's side.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_CHUNK_SIZE (64 * 1024) // a power of two, names can't be longer
+
+typedef struct arena_chunk_s arena_chunk;
+
+// One requester's arena, used by that thread only
+typedef struct name_arena_s {
+    arena_chunk* chunk;      // being filled, NULL before the first name
+    size_t used;             // bytes of it handed out
+    long carved;             // names copied into it
+    unsigned long chunks;    // allocated so far
+    unsigned long names;
+} name_arena;
+
+void arena_init(name_arena* a);
+
+/* Copy len bytes of s, NUL-terminated, into the arena
+ * Returns the copy (to be given back with arena_release()), or NULL if out
+ * of memory
+ */
+char* arena_copy(name_arena* a, const char* s, size_t len);
+
+/* Done with a name from arena_copy(); any thread may call this */
+void arena_release(char* name);
+
+/* The requester is done: the last chunk goes once its names are released.
+ * The arena may be used again after this, with a new chunk.
+ */
+void arena_finish(name_arena* a);
+
+#endif
@@ -0,0 +1,218 @@
+/* batch-bench.c
+ * Akira Youngblood, 2026-10-17
+ * Sweeps handoff batch size and resolver thread count over real input files
+ *
+ * Loads the hostnames from each input file up front (one producer per file,
+ * like multi-lookup's requesters), then times handing them all to a pool of
+ * consumers through handoff_push_batch()/handoff_pop_batch() for every
+ * combination of queue type (a mesh has a ring per producer and consumer),
+ * batch size and consumer count. Consumers only normalize and hash each name
+ * (what the cache does before any lookup), so the queue is the bottleneck.
+ * ops/item is queue calls per name, i.e. lock acquisitions per name for the
+ * blocking queue. Counts are checked, so a lost or duplicated name shows up
+ * as MISMATCH.
+ *
+ * Usage: batch-bench [-r rounds] [-s queue size] file [file ...]
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../dnscache.h"
+#include "../handoff.h"
+
+static const int batch_sizes[] = { 1, 4, 16, 64 };
+static const int consumer_counts[] = { 1, 4, 16, 64 };
+#define NELEMS(a) ((int)(sizeof(a)/sizeof((a)[0])))
+
+typedef struct {
+    char** names;
+    long count;
+} name_list;
+
+// Shared benchmark state, set up once per run
+static handoff hq;
+static int batch;
+static int rounds = 20;
+static int queue_size = 32;
+static atomic_long ops;
+
+typedef struct {
+    name_list* list;  // producers
+    long count;       // consumers
+    uint64_t sum;
+} worker_arg;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int load(const char* path, name_list* list) {
+    char hostname[1025];
+    long cap = 0;
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Failed to open input file %s\n", path);
+        return -1;
+    }
+    list->names = NULL;
+    list->count = 0;
+    while (fscanf(fp, "%1024s", hostname) > 0) {
+        if (list->count == cap) {
+            cap = cap ? cap * 2 : 256;
+            list->names = realloc(list->names, cap * sizeof(char*));
+            if (list->names == NULL) {
+                fclose(fp);
+                return -1;
+            }
+        }
+        list->names[list->count++] = strdup(hostname);
+    }
+    fclose(fp);
+    return 0;
+}
+
+static void* producer(void* p) {
+    worker_arg* arg = p;
+    void* buf[batch];
+    long calls = 0, i;
+    int r, n = 0;
+    for (r = 0; r < rounds; ++r) {
+        for (i = 0; i < arg->list->count; ++i) {
+            buf[n++] = arg->list->names[i];
+            if (n == batch) {
+                handoff_push_batch(&hq, buf, n);
+                calls++;
+                n = 0;
+            }
+        }
+    }
+    if (n > 0) {
+        handoff_push_batch(&hq, buf, n);
+        calls++;
+    }
+    atomic_fetch_add(&ops, calls);
+    handoff_producer_done(&hq);
+    return NULL;
+}
+
+static void* consumer(void* p) {
+    worker_arg* arg = p;
+    void* buf[batch];
+    char name[1025];
+    long calls = 0;
+    int i, n;
+    while ((n = handoff_pop_batch(&hq, buf, batch)) > 0) {
+        calls++;
+        for (i = 0; i < n; ++i) {
+            arg->sum += dnscache_normalize(buf[i], name, sizeof(name));
+        }
+        arg->count += n;
+    }
+    atomic_fetch_add(&ops, calls + 1); // + the final empty pop
+    return NULL;
+}
+
+static int run(handoff_kind kind, name_list* lists, int nlists, int nconsumers,
+               long expected_count, uint64_t expected_sum) {
+    pthread_t producers[nlists];
+    pthread_t consumers[nconsumers];
+    worker_arg pargs[nlists];
+    worker_arg cargs[nconsumers];
+    uint64_t sum = 0;
+    long count = 0;
+    int i;
+
+    if ((kind == HANDOFF_MESH ? handoff_init_mesh(&hq, queue_size, nlists, nconsumers)
+                              : handoff_init(&hq, kind, queue_size)) == QUEUE_FAILURE) return -1;
+    handoff_add_producers(&hq, nlists);
+    atomic_store(&ops, 0);
+
+    double tic = now_seconds();
+    for (i = 0; i < nconsumers; ++i) {
+        memset(&cargs[i], 0, sizeof(cargs[i]));
+        pthread_create(&consumers[i], NULL, consumer, &cargs[i]);
+    }
+    for (i = 0; i < nlists; ++i) {
+        pargs[i].list = &lists[i];
+        pthread_create(&producers[i], NULL, producer, &pargs[i]);
+    }
+    for (i = 0; i < nlists; ++i) {
+        pthread_join(producers[i], NULL);
+    }
+    for (i = 0; i < nconsumers; ++i) {
+        pthread_join(consumers[i], NULL);
+        sum += cargs[i].sum;
+        count += cargs[i].count;
+    }
+    double toc = now_seconds();
+    handoff_cleanup(&hq);
+
+    int ok = (count == expected_count && sum == expected_sum);
+    printf("%-9s %5d %9d %10ld %8.3f %12.0f %8.3f%s\n",
+           handoff_kind_name(kind), batch, nconsumers, count, toc - tic,
+           count / (toc - tic), (double)atomic_load(&ops) / count,
+           ok ? "" : "  MISMATCH");
+    return ok ? 0 : -1;
+}
+
+static int usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-r rounds] [-s queue size] file [file ...]\n", prog);
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char* argv[]) {
+    int opt, i, j, k, nlists, rv = 0;
+    long expected_count = 0;
+    uint64_t expected_sum = 0;
+    char name[1025];
+
+    while ((opt = getopt(argc, argv, "r:s:")) != -1) {
+        switch (opt) {
+            case 'r': rounds = atoi(optarg); break;
+            case 's': queue_size = atoi(optarg); break;
+            default: return usage(argv[0]);
+        }
+    }
+    nlists = argc - optind;
+    if (nlists < 1 || rounds <= 0 || queue_size <= 0) return usage(argv[0]);
+
+    name_list lists[nlists];
+    for (i = 0; i < nlists; ++i) {
+        if (load(argv[optind + i], &lists[i])) return EXIT_FAILURE;
+        for (j = 0; j < lists[i].count; ++j) {
+            expected_sum += dnscache_normalize(lists[i].names[j], name, sizeof(name));
+        }
+        expected_count += lists[i].count;
+    }
+    expected_count *= rounds;
+    expected_sum *= rounds;
+    printf("%d producers, %ld names (%d rounds), queue size %d\n",
+           nlists, expected_count, rounds, queue_size);
+    printf("%-9s %5s %9s %10s %8s %12s %8s\n",
+           "queue", "batch", "consumers", "items", "wall s", "items/s", "ops/item");
+
+    for (k = 0; k < 3; ++k) {
+        handoff_kind kind = (handoff_kind)k;
+        for (i = 0; i < NELEMS(batch_sizes); ++i) {
+            batch = batch_sizes[i];
+            for (j = 0; j < NELEMS(consumer_counts); ++j) {
+                rv |= run(kind, lists, nlists, consumer_counts[j], expected_count, expected_sum);
+            }
+        }
+    }
+
+    for (i = 0; i < nlists; ++i) {
+        for (j = 0; j < lists[i].count; ++j) free(lists[i].names[j]);
+        free(lists[i].names);
+    }
+    return rv ? EXIT_FAILURE : EXIT_SUCCESS;
+}
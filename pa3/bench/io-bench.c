@@ -0,0 +1,289 @@
+/* io-bench.c
+ * Akira Youngblood, 2026-10-17
+ * Times multi-lookup's file input and output paths with nothing else running
+ *
+ * Input: reads every hostname in the file the way each requester does
+ * (fscanf() and a malloc'ed copy per name, the mapped scan of -m, and the
+ * io_uring chunks of -u with a copy per name) and reports MB/s and names/s.
+ * Output: writes a result line per name through outbuf.h from -t threads
+ * sharing one file, with write() under the output lock and with -u's
+ * io_uring writes at claimed offsets. Each path's names are hashed, so a
+ * path that reads or writes something different shows up as MISMATCH.
+ *
+ * The file is read once first, so every path starts from a warm page cache;
+ * drop the cache between runs to time the disk instead.
+ *
+ * Usage: io-bench [-t threads] [-r rounds] file [outfile]
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../mapinput.h"
+#include "../outbuf.h"
+#include "../uring.h"
+
+static int threads = 4;
+static int rounds = 3;
+
+typedef struct {
+    unsigned long names;
+    uint64_t hash;     // sum of the names' hashes, order doesn't matter
+} tally;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t hash_name(const char* p, size_t n) {
+    // FNV-1a, 64 bit
+    uint64_t h = 14695981039346656037ULL;
+    while (n-- > 0) {
+        h ^= (unsigned char)*p++;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// What a requester does with each name: a copy on the heap, freed by the
+// resolver later
+static void take(tally* t, const char* p, size_t n) {
+    char* copy = malloc(n + 1);
+    memcpy(copy, p, n);
+    copy[n] = '\0';
+    t->names++;
+    t->hash += hash_name(copy, n);
+    free(copy);
+}
+
+static int read_stdio(const char* path, tally* t) {
+    char hostname[MAPINPUT_MAX_NAME + 1];
+    FILE* fp = fopen(path, "r");
+    if (!fp) return -1;
+    while (fscanf(fp, "%1024s", hostname) > 0) {
+        take(t, hostname, strlen(hostname));
+    }
+    fclose(fp);
+    return 0;
+}
+
+static int read_mapped(const char* path, tally* t) {
+    mapped_file mf;
+    const char *p, *end;
+    size_t len;
+    if (mapinput_open(&mf, path)) return -1;
+    end = mf.base + mf.size;
+    // Queued in place, no copy
+    for (p = mf.base; p < end && (p = mapinput_next(p, end, &len)) != NULL; p += len) {
+        t->names++;
+        t->hash += hash_name(p, len);
+    }
+    mapinput_close(&mf);
+    return 0;
+}
+
+static int read_uring(const char* path, tally* t) {
+    uring_reader rd;
+    char* data;
+    size_t keep = 0, namelen;
+    ssize_t len = 0;
+    int last = 0, fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    if (uring_reader_init(&rd, fd)) {
+        close(fd);
+        return -1;
+    }
+    while (!last && (len = uring_reader_next(&rd, keep, &data, &last)) >= 0) {
+        const char *p = data, *end = data + len;
+        keep = 0;
+        while (p < end && (p = mapinput_next(p, end, &namelen)) != NULL) {
+            if (p + namelen == end && !last && namelen < MAPINPUT_MAX_NAME) {
+                keep = namelen;
+                break;
+            }
+            take(t, p, namelen);
+            p += namelen;
+        }
+    }
+    uring_reader_cleanup(&rd);
+    close(fd);
+    return len < 0 ? -1 : 0;
+}
+
+// Output: every thread writes the lines for a share of the names
+typedef struct {
+    char** names;
+    long from, to;
+    int fd;
+    int use_uring;
+    pthread_mutex_t* lock;
+    atomic_ullong* offset;
+} writer_arg;
+
+static void* writer(void* arg) {
+    writer_arg* w = arg;
+    outbuf ob;
+    long i;
+    if (outbuf_init(&ob, w->fd, w->lock, 0)) return NULL;
+    if (w->use_uring) outbuf_use_uring(&ob, w->offset);
+    for (i = w->from; i < w->to; ++i) {
+        outbuf_line(&ob, w->names[i], "10.0.0.1");
+    }
+    outbuf_cleanup(&ob);
+    return NULL;
+}
+
+static int write_lines(const char* path, char** names, long count, int use_uring) {
+    pthread_t tids[threads];
+    writer_arg args[threads];
+    pthread_mutex_t lock;
+    atomic_ullong offset;
+    int i, fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    pthread_mutex_init(&lock, NULL);
+    atomic_init(&offset, 0);
+    for (i = 0; i < threads; ++i) {
+        args[i] = (writer_arg){ names, count * i / threads, count * (i + 1) / threads, fd, use_uring,
+                                &lock, &offset };
+        pthread_create(&tids[i], NULL, writer, &args[i]);
+    }
+    for (i = 0; i < threads; ++i) {
+        pthread_join(tids[i], NULL);
+    }
+    pthread_mutex_destroy(&lock);
+    return close(fd);
+}
+
+// Hash the hostnames back out of a written output file
+static int read_back(const char* path, tally* t) {
+    mapped_file mf;
+    const char *p, *end;
+    if (mapinput_open(&mf, path)) return -1;
+    end = mf.base + mf.size;
+    for (p = mf.base; p < end; ) {
+        const char* comma = memchr(p, ',', end - p);
+        const char* eol = comma ? memchr(comma, '\n', end - comma) : NULL;
+        if (eol == NULL) break;
+        t->names++;
+        t->hash += hash_name(p, comma - p);
+        p = eol + 1;
+    }
+    mapinput_close(&mf);
+    return 0;
+}
+
+static void report(const char* what, double secs, double mb, const tally* t, const tally* ref) {
+    printf("%-16s %8.3f s %9.1f MB/s %11.0f names/s%s\n", what, secs, mb / secs, t->names / secs,
+           t->names == ref->names && t->hash == ref->hash ? "" : "  MISMATCH");
+}
+
+int main(int argc, char* argv[]) {
+    const char* path;
+    const char* outpath = "io-bench.out";
+    struct stat st;
+    tally ref = { 0, 0 };
+    double mb, best;
+    int opt, r;
+
+    while ((opt = getopt(argc, argv, "t:r:")) != -1) {
+        switch (opt) {
+            case 't': threads = atoi(optarg); break;
+            case 'r': rounds = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: io-bench [-t threads] [-r rounds] file [outfile]\n");
+                return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc || threads < 1 || rounds < 1) {
+        fprintf(stderr, "Usage: io-bench [-t threads] [-r rounds] file [outfile]\n");
+        return EXIT_FAILURE;
+    }
+    path = argv[optind];
+    if (optind + 1 < argc) outpath = argv[optind + 1];
+    if (stat(path, &st) < 0) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+    mb = st.st_size / 1048576.0;
+    if (!uring_supported()) {
+        fprintf(stderr, "io_uring isn't available here\n");
+        return EXIT_FAILURE;
+    }
+    // Warm the page cache, and take the reference tally
+    read_mapped(path, &ref);
+    printf("%s: %.1f MB, %lu names, best of %d\n", path, mb, ref.names, rounds);
+
+    static const struct {
+        const char* name;
+        int (*fn)(const char*, tally*);
+    } readers[] = {
+        { "read stdio", read_stdio },
+        { "read mmap (-m)", read_mapped },
+        { "read uring (-u)", read_uring },
+    };
+    for (size_t k = 0; k < sizeof(readers) / sizeof(readers[0]); ++k) {
+        tally t = { 0, 0 };
+        best = 0;
+        for (r = 0; r < rounds; ++r) {
+            double start = now_seconds();
+            t = (tally){ 0, 0 };
+            if (readers[k].fn(path, &t)) {
+                perror(readers[k].name);
+                return EXIT_FAILURE;
+            }
+            double secs = now_seconds() - start;
+            if (best == 0 || secs < best) best = secs;
+        }
+        report(readers[k].name, best, mb, &t, &ref);
+    }
+
+    // Output: the names as an array, written out as result lines
+    char** names = malloc(ref.names * sizeof(char*));
+    mapped_file mf;
+    const char *p, *end;
+    size_t len;
+    long n = 0;
+    if (names == NULL || mapinput_open(&mf, path)) {
+        fprintf(stderr, "Out of memory.\n");
+        return EXIT_FAILURE;
+    }
+    end = mf.base + mf.size;
+    for (p = mf.base; p < end && (p = mapinput_next(p, end, &len)) != NULL; p += len) {
+        names[n] = malloc(len + 1);
+        memcpy(names[n], p, len);
+        names[n++][len] = '\0';
+    }
+    for (int use_uring = 0; use_uring <= 1; ++use_uring) {
+        char what[32];
+        struct stat ost;
+        tally t = { 0, 0 };
+        best = 0;
+        for (r = 0; r < rounds; ++r) {
+            double start = now_seconds();
+            if (write_lines(outpath, names, n, use_uring)) {
+                perror(outpath);
+                return EXIT_FAILURE;
+            }
+            double secs = now_seconds() - start;
+            if (best == 0 || secs < best) best = secs;
+        }
+        read_back(outpath, &t);
+        stat(outpath, &ost);
+        snprintf(what, sizeof(what), "write %s", use_uring ? "uring (-u)" : "write()");
+        report(what, best, ost.st_size / 1048576.0, &t, &ref);
+    }
+    unlink(outpath);
+    for (long i = 0; i < n; ++i) free(names[i]);
+    free(names);
+    mapinput_close(&mf);
+    return EXIT_SUCCESS;
+}
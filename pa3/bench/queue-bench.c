@@ -0,0 +1,178 @@
+/* queue-bench.c
+ * Akira Youngblood, 2026-10-17
+ * Microbenchmark for the producer/consumer handoff used by multi-lookup
+ *
+ * Compares the original spin loop (mutex + queue_is_full() + usleep) with the
+ * handoff queues multi-lookup can use (blocking bqueue, lock-free lfqueue).
+ * Reports wall time, handoff throughput and CPU time, and checks that every
+ * item was handed off exactly once, so it doubles as a stress test: run it
+ * with many producers/consumers and a tiny queue to hammer the full/empty
+ * edges.
+ *
+ * Usage: queue-bench [items] [producers] [consumers] [queue size]
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../queue.h"
+#include "../handoff.h"
+
+typedef enum { MODE_SPIN, MODE_BLOCKING, MODE_LOCKFREE } bench_mode;
+
+static const char* mode_names[] = { "spin", "blocking", "lockfree" };
+
+// Shared benchmark state, set up once per run
+static bench_mode mode;
+static long num_items;
+static int num_producers;
+static int num_consumers;
+static int queue_size;
+
+static queue spin_q;
+static pthread_mutex_t spin_lock = PTHREAD_MUTEX_INITIALIZER;
+static int spin_done;
+static handoff hq;
+
+typedef struct {
+    long first;
+    long count;
+    uint64_t sum;
+} worker_arg;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void* producer(void* p) {
+    worker_arg* arg = p;
+    long i;
+    for (i = arg->first; i < arg->first + arg->count; ++i) {
+        // Payloads are never NULL, NULL means "empty slot" to queue.c
+        void* payload = (void*)(uintptr_t)(i + 1);
+        if (mode == MODE_SPIN) {
+            // Same wait loop as the original RequesterThreadAction
+            pthread_mutex_lock(&spin_lock);
+            while (queue_is_full(&spin_q)) {
+                pthread_mutex_unlock(&spin_lock);
+                usleep(rand()%100);
+                pthread_mutex_lock(&spin_lock);
+            }
+            queue_push(&spin_q, payload);
+            pthread_mutex_unlock(&spin_lock);
+        } else {
+            handoff_push(&hq, payload);
+        }
+    }
+    if (mode != MODE_SPIN) handoff_producer_done(&hq);
+    return NULL;
+}
+
+static void* consumer(void* p) {
+    worker_arg* arg = p;
+    void* payload;
+    for (;;) {
+        if (mode == MODE_SPIN) {
+            // Consumers have to spin too, there is nothing to sleep on
+            pthread_mutex_lock(&spin_lock);
+            while (queue_is_empty(&spin_q) && !spin_done) {
+                pthread_mutex_unlock(&spin_lock);
+                usleep(rand()%100);
+                pthread_mutex_lock(&spin_lock);
+            }
+            payload = queue_pop(&spin_q);
+            pthread_mutex_unlock(&spin_lock);
+        } else {
+            payload = handoff_pop(&hq);
+        }
+        if (payload == NULL) break;
+        arg->sum += (uintptr_t)payload;
+        arg->count++;
+    }
+    return NULL;
+}
+
+static int run(bench_mode m) {
+    pthread_t producers[num_producers];
+    pthread_t consumers[num_consumers];
+    worker_arg pargs[num_producers];
+    worker_arg cargs[num_consumers];
+    uint64_t sum = 0, expected;
+    long count = 0, per_producer = num_items / num_producers;
+    int i;
+
+    mode = m;
+    spin_done = 0;
+    if (m == MODE_SPIN) {
+        if (queue_init(&spin_q, queue_size) == QUEUE_FAILURE) return -1;
+    } else {
+        handoff_kind kind = (m == MODE_LOCKFREE) ? HANDOFF_LOCKFREE : HANDOFF_BLOCKING;
+        if (handoff_init(&hq, kind, queue_size) == QUEUE_FAILURE) return -1;
+        handoff_add_producers(&hq, num_producers);
+    }
+
+    clock_t cpu_tic = clock();
+    double tic = now_seconds();
+    for (i = 0; i < num_consumers; ++i) {
+        memset(&cargs[i], 0, sizeof(cargs[i]));
+        pthread_create(&consumers[i], NULL, consumer, &cargs[i]);
+    }
+    for (i = 0; i < num_producers; ++i) {
+        pargs[i].first = i * per_producer;
+        pargs[i].count = (i == num_producers - 1) ? num_items - pargs[i].first : per_producer;
+        pthread_create(&producers[i], NULL, producer, &pargs[i]);
+    }
+    for (i = 0; i < num_producers; ++i) {
+        pthread_join(producers[i], NULL);
+    }
+    if (m == MODE_SPIN) {
+        pthread_mutex_lock(&spin_lock);
+        spin_done = 1;
+        pthread_mutex_unlock(&spin_lock);
+    }
+    for (i = 0; i < num_consumers; ++i) {
+        pthread_join(consumers[i], NULL);
+        sum += cargs[i].sum;
+        count += cargs[i].count;
+    }
+    double toc = now_seconds();
+    clock_t cpu_toc = clock();
+
+    if (m == MODE_SPIN) {
+        queue_cleanup(&spin_q);
+    } else {
+        handoff_cleanup(&hq);
+    }
+
+    expected = (uint64_t)num_items * (num_items + 1) / 2;
+    printf("%-9s %10ld items %8.3f s wall %12.0f items/s %8.3f s cpu%s\n",
+           mode_names[m], count, toc - tic, count / (toc - tic),
+           (double)(cpu_toc - cpu_tic)/CLOCKS_PER_SEC,
+           (count == num_items && sum == expected) ? "" : "  MISMATCH");
+    return (count == num_items && sum == expected) ? 0 : -1;
+}
+
+int main(int argc, char* argv[]) {
+    num_items = (argc > 1) ? atol(argv[1]) : 1000000;
+    num_producers = (argc > 2) ? atoi(argv[2]) : 6;
+    num_consumers = (argc > 3) ? atoi(argv[3]) : 16;
+    queue_size = (argc > 4) ? atoi(argv[4]) : 32;
+    if (num_items <= 0 || num_producers <= 0 || num_consumers <= 0 || queue_size <= 0) {
+        fprintf(stderr, "Usage: %s [items] [producers] [consumers] [queue size]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    printf("%ld items, %d producers, %d consumers, queue size %d\n",
+           num_items, num_producers, num_consumers, queue_size);
+    int rv = 0;
+    rv |= run(MODE_SPIN);
+    rv |= run(MODE_BLOCKING);
+    rv |= run(MODE_LOCKFREE);
+    return rv ? EXIT_FAILURE : EXIT_SUCCESS;
+}
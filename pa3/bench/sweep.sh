@@ -0,0 +1,103 @@
+#!/bin/sh
+# sweep.sh
+# Akira Youngblood, 2026-10-17
+# Sweeps multi-lookup over queue size, resolver threads and queue type
+#
+# Every combination runs over each input set RUNS times, against an
+# in-memory hosts table that answers every name in the inputs after
+# LATENCY +- JITTER ms (-r hosts:, see dnsbackend.h), with the cache off and
+# a fixed pool, so the numbers depend on the threading layer and not on the
+# network. Runs are interleaved (all combinations once, then again) so
+# drift on the machine spreads over every combination alike.
+#
+# Writes the median and spread (min-max) of wall time and lookups/s per
+# combination as CSV and as a markdown table, and every run as CSV.
+#
+# Usage (from pa3/, after make): bench/sweep.sh [summary.csv] [summary.md]
+# Environment: RUNS, SIZES, THREADS, QUEUES, INPUTS, LATENCY, JITTER
+
+set -e
+
+RUNS=${RUNS:-5}
+SIZES=${SIZES:-"8 32 128"}
+THREADS=${THREADS:-"4 16 64"}
+QUEUES=${QUEUES:-"blocking lockfree"}
+INPUTS=${INPUTS:-"input input-med input-big"}
+LATENCY=${LATENCY:-2}
+JITTER=${JITTER:-1}
+CSV=${1:-bench-sweep.csv}
+MD=${2:-bench-sweep.md}
+RAW=${CSV%.csv}-runs.csv
+
+hosts=$(mktemp)
+metrics=$(mktemp)
+trap 'rm -f "$hosts" "$metrics"' EXIT
+
+# One address per distinct name in the inputs
+for dir in $INPUTS; do cat "$dir"/*; done |
+    awk '$1 != "" && !seen[tolower($1)]++ { n++; printf "10.%d.%d.%d %s\n", int(n / 65536) % 256, int(n / 256) % 256, n % 256, $1 }' > "$hosts"
+
+echo "input,queue,queue_size,threads,run,wall_s,lookups_per_s" > "$RAW"
+run=1
+while [ $run -le "$RUNS" ]; do
+    for dir in $INPUTS; do
+        for queue in $QUEUES; do
+            for size in $SIZES; do
+                for threads in $THREADS; do
+                    printf "\rrun %d/%d: %-9s %-8s size %4d, %3d threads " $run "$RUNS" "$dir" "$queue" "$size" "$threads" >&2
+                    ./multi-lookup -c 0 -t "$threads" -s "$size" -q "$queue" \
+                        -r "hosts:$hosts,latency=$LATENCY,jitter=$JITTER" -j "$metrics" \
+                        "$dir"/* output.txt > /dev/null 2>&1
+                    # First (top-level) wall_s and lookups_per_s in the JSON
+                    wall=$(sed -n 's/.*"wall_s": \([0-9.]*\).*/\1/p' "$metrics" | head -n 1)
+                    lps=$(sed -n 's/.*"lookups_per_s": \([0-9.]*\).*/\1/p' "$metrics" | head -n 1)
+                    echo "$dir,$queue,$size,$threads,$run,$wall,$lps" >> "$RAW"
+                done
+            done
+        done
+    done
+    run=$((run + 1))
+done
+echo >&2
+
+# Median, min and max per combination, in the order they were first run
+awk -F, -v csv="$CSV" -v md="$MD" -v runs="$RUNS" -v latency="$LATENCY" -v jitter="$JITTER" '
+function sort(a, n,    i, j, t) {
+    for (i = 2; i <= n; i++) {
+        t = a[i]
+        for (j = i - 1; j > 0 && a[j] > t; j--) a[j + 1] = a[j]
+        a[j + 1] = t
+    }
+}
+function median(a, n) {
+    return n % 2 ? a[(n + 1) / 2] : (a[n / 2] + a[n / 2 + 1]) / 2
+}
+NR > 1 {
+    key = $1 "," $2 "," $3 "," $4
+    if (!(key in count)) order[++nkeys] = key
+    count[key]++
+    wall[key, count[key]] = $6
+    lps[key, count[key]] = $7
+}
+END {
+    print "input,queue,queue_size,threads,runs,wall_median_s,wall_min_s,wall_max_s,lps_median,lps_min,lps_max" > csv
+    printf "Latency %s +- %s ms per lookup, cache off, %d runs each. Spread is (max - min) / median.\n\n", latency, jitter, runs > md
+    print "| input | queue | size | threads | wall median (s) | spread | lookups/s median | spread |" > md
+    print "|---|---|---:|---:|---:|---:|---:|---:|" > md
+    for (k = 1; k <= nkeys; k++) {
+        key = order[k]
+        n = count[key]
+        for (i = 1; i <= n; i++) { w[i] = wall[key, i]; l[i] = lps[key, i] }
+        sort(w, n)
+        sort(l, n)
+        wm = median(w, n)
+        lm = median(l, n)
+        printf "%s,%d,%.6f,%.6f,%.6f,%.1f,%.1f,%.1f\n", key, n, wm, w[1], w[n], lm, l[1], l[n] > csv
+        ws = wm > 0 ? 100 * (w[n] - w[1]) / wm : 0
+        ls = lm > 0 ? 100 * (l[n] - l[1]) / lm : 0
+        split(key, f, ",")
+        printf "| %s | %s | %d | %d | %.3f | %.1f%% | %.0f | %.1f%% |\n", f[1], f[2], f[3], f[4], wm, ws, lm, ls > md
+    }
+}' "$RAW"
+
+echo "Wrote $CSV, $MD and $RAW" >&2
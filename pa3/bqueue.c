@@ -0,0 +1,150 @@
+/* bqueue.c
+ * Akira Youngblood, 2026-10-17
+ * Blocking bounded FIFO queue, wraps the PA3 queue with a mutex and
+ * two condition variables
+ */
+
+#include "bqueue.h"
+
+int bqueue_init(bqueue* bq, int size) {
+    int rv = queue_init(&bq->q, size);
+    if (rv == QUEUE_FAILURE) return QUEUE_FAILURE;
+    if (pthread_mutex_init(&bq->lock, NULL)) goto fail_queue;
+    if (pthread_cond_init(&bq->not_full, NULL)) goto fail_lock;
+    if (pthread_cond_init(&bq->not_empty, NULL)) goto fail_full;
+    bq->waiting_producers = 0;
+    bq->waiting_consumers = 0;
+    bq->count = 0;
+    bq->closed = 0;
+    return rv;
+
+fail_full:
+    pthread_cond_destroy(&bq->not_full);
+fail_lock:
+    pthread_mutex_destroy(&bq->lock);
+fail_queue:
+    queue_cleanup(&bq->q);
+    return QUEUE_FAILURE;
+}
+
+int bqueue_push(bqueue* bq, void* payload) {
+    if (payload == NULL) return QUEUE_FAILURE;
+    pthread_mutex_lock(&bq->lock);
+    while (queue_is_full(&bq->q) && !bq->closed) {
+        bq->waiting_producers++;
+        pthread_cond_wait(&bq->not_full, &bq->lock);
+        bq->waiting_producers--;
+    }
+    if (bq->closed) {
+        pthread_mutex_unlock(&bq->lock);
+        return QUEUE_FAILURE;
+    }
+    queue_push(&bq->q, payload);
+    bq->count++;
+    // Only one item was added, so only one consumer needs to wake up.
+    // Skip the signal entirely when nobody sleeps, it is a syscall otherwise.
+    if (bq->waiting_consumers) pthread_cond_signal(&bq->not_empty);
+    pthread_mutex_unlock(&bq->lock);
+    return QUEUE_SUCCESS;
+}
+
+void* bqueue_pop(bqueue* bq) {
+    void* payload;
+    pthread_mutex_lock(&bq->lock);
+    while (queue_is_empty(&bq->q) && !bq->closed) {
+        bq->waiting_consumers++;
+        pthread_cond_wait(&bq->not_empty, &bq->lock);
+        bq->waiting_consumers--;
+    }
+    // Still drains after close, NULL only when closed and empty
+    payload = queue_pop(&bq->q);
+    if (payload != NULL) bq->count--;
+    if (payload != NULL && bq->waiting_producers) pthread_cond_signal(&bq->not_full);
+    pthread_mutex_unlock(&bq->lock);
+    return payload;
+}
+
+void* bqueue_trypop(bqueue* bq, int* closed) {
+    void* payload;
+    pthread_mutex_lock(&bq->lock);
+    payload = queue_pop(&bq->q);
+    if (payload != NULL) bq->count--;
+    if (payload != NULL && bq->waiting_producers) pthread_cond_signal(&bq->not_full);
+    *closed = (payload == NULL && bq->closed);
+    pthread_mutex_unlock(&bq->lock);
+    return payload;
+}
+
+// Wake up to n sleepers on cond, one per item (or free slot) made available
+static void wake(pthread_cond_t* cond, int sleepers, int n) {
+    if (n >= sleepers) {
+        if (sleepers) pthread_cond_broadcast(cond);
+        return;
+    }
+    while (n-- > 0) pthread_cond_signal(cond);
+}
+
+int bqueue_push_batch(bqueue* bq, void** payloads, int n) {
+    int i, done = 0;
+    for (i = 0; i < n; ++i) {
+        if (payloads[i] == NULL) return 0;
+    }
+    pthread_mutex_lock(&bq->lock);
+    while (done < n) {
+        while (queue_is_full(&bq->q) && !bq->closed) {
+            bq->waiting_producers++;
+            pthread_cond_wait(&bq->not_full, &bq->lock);
+            bq->waiting_producers--;
+        }
+        if (bq->closed) break;
+        // Fill whatever room there is, then sleep for more if needed
+        int added = queue_push_batch(&bq->q, payloads + done, n - done);
+        bq->count += added;
+        done += added;
+        wake(&bq->not_empty, bq->waiting_consumers, added);
+    }
+    pthread_mutex_unlock(&bq->lock);
+    return done;
+}
+
+int bqueue_pop_batch(bqueue* bq, void** payloads, int max) {
+    int take;
+    pthread_mutex_lock(&bq->lock);
+    while (bq->count == 0 && !bq->closed) {
+        bq->waiting_consumers++;
+        pthread_cond_wait(&bq->not_empty, &bq->lock);
+        bq->waiting_consumers--;
+    }
+    // Split what is queued evenly with the consumers still asleep (which
+    // includes any just signalled that haven't run yet)
+    take = (bq->count + bq->waiting_consumers) / (bq->waiting_consumers + 1);
+    if (take > max) take = max;
+    take = queue_pop_batch(&bq->q, payloads, take);
+    bq->count -= take;
+    wake(&bq->not_full, bq->waiting_producers, take);
+    pthread_mutex_unlock(&bq->lock);
+    return take;
+}
+
+int bqueue_depth(bqueue* bq) {
+    int count;
+    pthread_mutex_lock(&bq->lock);
+    count = bq->count;
+    pthread_mutex_unlock(&bq->lock);
+    return count;
+}
+
+void bqueue_close(bqueue* bq) {
+    pthread_mutex_lock(&bq->lock);
+    bq->closed = 1;
+    pthread_cond_broadcast(&bq->not_full);
+    pthread_cond_broadcast(&bq->not_empty);
+    pthread_mutex_unlock(&bq->lock);
+}
+
+void bqueue_cleanup(bqueue* bq) {
+    pthread_cond_destroy(&bq->not_empty);
+    pthread_cond_destroy(&bq->not_full);
+    pthread_mutex_destroy(&bq->lock);
+    queue_cleanup(&bq->q);
+}
@@ -0,0 +1,78 @@
+/* bqueue.h
+ * Akira Youngblood, 2026-10-17
+ * Blocking bounded FIFO queue, built on top of queue.c/.h
+ *
+ * Producers sleep on "not full" and consumers sleep on "not empty" instead of
+ * spinning on queue_is_full()/queue_is_empty(). Once the queue is closed,
+ * pushes fail and pops drain whatever is left before returning NULL.
+ *
+ * The _batch calls move many payloads per lock acquisition. A batched pop
+ * leaves a fair share for the consumers already asleep, so a burst of names
+ * still spreads across idle resolvers instead of landing on one of them.
+ */
+
+#ifndef BQUEUE_H
+#define BQUEUE_H
+
+#include <pthread.h>
+
+#include "queue.h"
+
+typedef struct bqueue_s {
+    queue q;
+    pthread_mutex_t lock;
+    pthread_cond_t not_full;
+    pthread_cond_t not_empty;
+    int waiting_producers;
+    int waiting_consumers;
+    int count; // payloads in q
+    int closed;
+} bqueue;
+
+/* Initialize a blocking queue holding up to size payloads
+ * On success, returns queue size
+ * On failure, returns QUEUE_FAILURE
+ */
+int bqueue_init(bqueue* bq, int size);
+
+/* Add payload to the end of the queue, sleeping while the queue is full
+ * Payload must not be NULL (NULL marks an empty slot in queue.c)
+ * Returns QUEUE_SUCCESS, or QUEUE_FAILURE if the queue has been closed
+ */
+int bqueue_push(bqueue* bq, void* payload);
+
+/* Add n payloads (none NULL) to the end of the queue under as few lock
+ * acquisitions as possible, sleeping whenever the queue is full
+ * Returns the number added: n, or fewer if the queue was closed
+ */
+int bqueue_push_batch(bqueue* bq, void** payloads, int n);
+
+/* Remove the payload at the front of the queue, sleeping while it is empty
+ * Returns NULL only once the queue is closed and fully drained
+ */
+void* bqueue_pop(bqueue* bq);
+
+/* Remove up to max payloads from the front of the queue, sleeping while it
+ * is empty. Takes fewer than max when other consumers are waiting.
+ * Returns the number removed, 0 only once the queue is closed and drained
+ */
+int bqueue_pop_batch(bqueue* bq, void** payloads, int max);
+
+/* Remove the payload at the front of the queue without sleeping
+ * Returns NULL if the queue is empty, and sets *closed to 1 if it is also
+ * closed (so nothing will ever arrive)
+ */
+void* bqueue_trypop(bqueue* bq, int* closed);
+
+/* Number of payloads queued right now (for monitoring) */
+int bqueue_depth(bqueue* bq);
+
+/* Close the queue: no more pushes are accepted, and every sleeping
+ * producer and consumer is woken up
+ */
+void bqueue_close(bqueue* bq);
+
+/* Free queue memory, must not be called while threads are still using it */
+void bqueue_cleanup(bqueue* bq);
+
+#endif
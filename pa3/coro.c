@@ -0,0 +1,415 @@
+/* coro.c
+ * Akira Youngblood, 2026-10-17
+ * Stackful coroutines for multi-lookup's resolver tasks (-k)
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE // sched_setaffinity(), CPU_SET()
+#endif
+
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "coro.h"
+
+#ifdef __linux__
+#define HAVE_CORO 1
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#endif
+
+enum { CORO_READY, CORO_RUNNING, CORO_IO, CORO_SLEEP, CORO_COND, CORO_DONE };
+
+struct coro_s {
+#ifdef HAVE_CORO
+    ucontext_t ctx;
+#endif
+    coro_sched* sched;
+    coro_fn fn;
+    void* arg;
+    int state;
+    int fd;                     // CORO_IO: waiting on this one
+    int ready;                  // CORO_IO: woken by the fd, not the timer
+    int timer;                  // index in the timer heap, -1: none
+    void* stack;                // mapping, guard page first
+    size_t stack_size;
+    coro* next;                 // run queue or coro_cond
+};
+
+// The scheduler the calling thread is running, NULL on a plain thread
+static _Thread_local coro_sched* running;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void nap_ns(uint64_t ns) {
+    struct timespec nap = { (time_t)(ns / 1000000000u), (long)(ns % 1000000000u) };
+    while (nanosleep(&nap, &nap) && errno == EINTR);
+}
+
+int coro_active(void) {
+    return running != NULL && running->current != NULL;
+}
+
+int coro_busy(void) {
+    if (!coro_active()) return 0;
+    return running->run_head != NULL || running->io_waiting > 0 || running->sleeping > 0;
+}
+
+int coro_runnable(void) {
+    return coro_active() && running->run_head != NULL;
+}
+
+void coro_cond_init(coro_cond* cv) {
+    cv->head = cv->tail = NULL;
+}
+
+#ifdef HAVE_CORO
+
+static void make_ready(coro_sched* s, coro* c) {
+    c->state = CORO_READY;
+    c->next = NULL;
+    if (s->run_tail) s->run_tail->next = c;
+    else s->run_head = c;
+    s->run_tail = c;
+}
+
+// Switch from the running coroutine back to the scheduler; it comes back
+// here once something made it ready again
+static void park(coro_sched* s) {
+    coro* c = s->current;
+    swapcontext(&c->ctx, (ucontext_t*)s->main_ctx);
+}
+
+static void count_waiting(coro_sched* s) {
+    if (s->io_waiting + s->sleeping > s->peak_waiting) s->peak_waiting = s->io_waiting + s->sleeping;
+}
+
+// Timer heap: each entry's coroutine knows where it is, so a wait that
+// ends early (the socket was ready) takes its timer out right away
+static void timer_set(coro_sched* s, int i, coro_timer t) {
+    s->timers[i] = t;
+    t.c->timer = i;
+}
+
+static void timer_sift(coro_sched* s, int i) {
+    coro_timer t = s->timers[i];
+    while (i > 0 && s->timers[(i - 1) / 2].at > t.at) {
+        timer_set(s, i, s->timers[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, m = l;
+        if (l >= s->ntimers) break;
+        if (r < s->ntimers && s->timers[r].at < s->timers[l].at) m = r;
+        if (s->timers[m].at >= t.at) break;
+        timer_set(s, i, s->timers[m]);
+        i = m;
+    }
+    timer_set(s, i, t);
+}
+
+static int timer_add(coro_sched* s, uint64_t at, coro* c) {
+    if (s->ntimers == s->captimers) {
+        int cap = s->captimers ? s->captimers * 2 : 64;
+        coro_timer* t = realloc(s->timers, cap * sizeof(*t));
+        if (t == NULL) return -1;
+        s->timers = t;
+        s->captimers = cap;
+    }
+    timer_set(s, s->ntimers, (coro_timer){ at, c });
+    timer_sift(s, s->ntimers++);
+    return 0;
+}
+
+static void timer_remove(coro_sched* s, coro* c) {
+    int i = c->timer;
+    if (i < 0) return;
+    c->timer = -1;
+    if (i == --s->ntimers) return;
+    timer_set(s, i, s->timers[s->ntimers]);
+    timer_sift(s, i);
+}
+
+// Wake the coroutines whose timers are due
+static void expire_timers(coro_sched* s) {
+    uint64_t now = now_ns();
+    while (s->ntimers > 0 && s->timers[0].at <= now) {
+        coro* c = s->timers[0].c;
+        timer_remove(s, c);
+        if (c->state == CORO_IO) {
+            epoll_ctl(s->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+            s->io_waiting--;
+            c->ready = 0;
+        } else {
+            s->sleeping--;
+        }
+        make_ready(s, c);
+    }
+}
+
+int coro_sched_init(coro_sched* s) {
+    memset(s, 0, sizeof(*s));
+    s->main_ctx = malloc(sizeof(ucontext_t));
+    if (s->main_ctx == NULL) return -1;
+    s->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (s->epfd < 0) {
+        free(s->main_ctx);
+        return -1;
+    }
+    return 0;
+}
+
+// First function on every coroutine's stack. makecontext() only passes
+// ints, so it finds its coroutine through the scheduler instead.
+static void trampoline(void) {
+    coro* c = running->current;
+    c->fn(c->arg);
+    c->state = CORO_DONE;
+    // Returning resumes uc_link, the scheduler
+}
+
+int coro_spawn(coro_sched* s, coro_fn fn, void* arg) {
+    long page = sysconf(_SC_PAGESIZE);
+    coro* c = calloc(1, sizeof(coro));
+    if (c == NULL) return -1;
+    c->sched = s;
+    c->fn = fn;
+    c->arg = arg;
+    c->timer = -1;
+    c->stack_size = CORO_STACK_SIZE + page;
+    c->stack = mmap(NULL, c->stack_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (c->stack == MAP_FAILED || mprotect(c->stack, page, PROT_NONE) || getcontext(&c->ctx)) {
+        if (c->stack != MAP_FAILED) munmap(c->stack, c->stack_size);
+        free(c);
+        return -1;
+    }
+    c->ctx.uc_stack.ss_sp = (char*)c->stack + page;
+    c->ctx.uc_stack.ss_size = CORO_STACK_SIZE;
+    c->ctx.uc_link = (ucontext_t*)s->main_ctx;
+    makecontext(&c->ctx, trampoline, 0);
+    s->live++;
+    s->spawned++;
+    make_ready(s, c);
+    return 0;
+}
+
+int coro_sched_run(coro_sched* s) {
+    struct epoll_event events[CORO_EVENTS];
+    coro_sched* outer = running;
+    int i, n, rv = 0;
+    running = s;
+    while (s->live > 0) {
+        // Run everything runnable once. What they make ready meanwhile waits
+        // for the next round, after the sockets and timers have been looked
+        // at: a coroutine that keeps yielding can't starve the parked ones.
+        coro* round = s->run_head;
+        s->run_head = s->run_tail = NULL;
+        while (round) {
+            coro* c = round;
+            round = c->next;
+            c->state = CORO_RUNNING;
+            s->current = c;
+            s->switches++;
+            swapcontext((ucontext_t*)s->main_ctx, &c->ctx);
+            s->current = NULL;
+            if (c->state == CORO_DONE) {
+                munmap(c->stack, c->stack_size);
+                free(c);
+                s->live--;
+            }
+        }
+        if (s->live == 0) break;
+        if (s->run_head == NULL && s->io_waiting == 0 && s->sleeping == 0) {
+            // Everyone left is on a coro_cond, nothing can wake them
+            rv = -1;
+            break;
+        }
+        // Sleep until a socket is ready or the next timer is due (rounded
+        // up, waking early would only spin), just look if there is more to run
+        int wait_ms = -1;
+        if (s->run_head) {
+            wait_ms = 0;
+        } else if (s->ntimers > 0) {
+            uint64_t now = now_ns();
+            wait_ms = s->timers[0].at > now ? (int)((s->timers[0].at - now + 999999) / 1000000) : 0;
+        }
+        s->wakeups++;
+        n = epoll_wait(s->epfd, events, CORO_EVENTS, wait_ms);
+        for (i = 0; i < n; ++i) {
+            coro* c = events[i].data.ptr;
+            // Registered one-shot, so each wait fires at most once
+            if (c->state != CORO_IO) continue;
+            s->io_waiting--;
+            c->ready = 1;
+            timer_remove(s, c);
+            make_ready(s, c);
+        }
+        expire_timers(s);
+    }
+    running = outer;
+    return rv;
+}
+
+void coro_sched_cleanup(coro_sched* s) {
+    close(s->epfd);
+    free(s->timers);
+    free(s->main_ctx);
+}
+
+int coro_pin_thread(int cpu) {
+    cpu_set_t set;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < 1) return -1;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % ncpu, &set);
+    // pid 0 is the calling thread, not the process
+    return sched_setaffinity(0, sizeof(set), &set) ? -1 : 0;
+}
+
+int coro_poll(int fd, short events, int timeout_ms) {
+    coro_sched* s = running;
+    coro* c;
+    struct epoll_event ev;
+    if (!coro_active()) {
+        struct pollfd pfd = { fd, events, 0 };
+        int n = poll(&pfd, 1, timeout_ms);
+        return n < 0 ? (errno == EINTR ? 0 : -1) : n > 0;
+    }
+    c = s->current;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLONESHOT | (events & POLLIN ? EPOLLIN : 0) | (events & POLLOUT ? EPOLLOUT : 0);
+    ev.data.ptr = c;
+    // A one-shot that fired stays in the set, disarmed, until the fd is
+    // closed: waiting on the same fd again re-arms it
+    if (epoll_ctl(s->epfd, EPOLL_CTL_ADD, fd, &ev) &&
+        (errno != EEXIST || epoll_ctl(s->epfd, EPOLL_CTL_MOD, fd, &ev))) {
+        return -1;
+    }
+    if (timeout_ms >= 0 && timer_add(s, now_ns() + (uint64_t)timeout_ms * 1000000u, c)) {
+        epoll_ctl(s->epfd, EPOLL_CTL_DEL, fd, NULL);
+        return -1;
+    }
+    c->state = CORO_IO;
+    c->fd = fd;
+    c->ready = 0;
+    s->polls++;
+    s->io_waiting++;
+    count_waiting(s);
+    park(s);
+    return c->ready;
+}
+
+void coro_sleep_ns(uint64_t ns) {
+    coro_sched* s = running;
+    coro* c;
+    if (!coro_active()) {
+        nap_ns(ns);
+        return;
+    }
+    c = s->current;
+    if (timer_add(s, now_ns() + ns, c)) {
+        nap_ns(ns); // out of memory: hold up the whole thread rather than fail
+        return;
+    }
+    c->state = CORO_SLEEP;
+    s->sleeps++;
+    s->sleeping++;
+    count_waiting(s);
+    park(s);
+}
+
+void coro_yield(void) {
+    coro_sched* s = running;
+    if (!coro_active()) return;
+    make_ready(s, s->current);
+    park(s);
+}
+
+void coro_cond_wait(coro_cond* cv) {
+    coro_sched* s = running;
+    coro* c;
+    if (!coro_active()) return;
+    c = s->current;
+    c->state = CORO_COND;
+    c->next = NULL;
+    if (cv->tail) cv->tail->next = c;
+    else cv->head = c;
+    cv->tail = c;
+    park(s);
+}
+
+void coro_cond_signal(coro_cond* cv) {
+    coro* c = cv->head;
+    if (c == NULL) return;
+    cv->head = c->next;
+    if (cv->head == NULL) cv->tail = NULL;
+    make_ready(c->sched, c);
+}
+
+void coro_cond_broadcast(coro_cond* cv) {
+    while (cv->head) coro_cond_signal(cv);
+}
+
+#else // !HAVE_CORO: no coroutines, the blocking fallbacks only
+
+int coro_sched_init(coro_sched* s) {
+    memset(s, 0, sizeof(*s));
+    return -1;
+}
+
+int coro_spawn(coro_sched* s, coro_fn fn, void* arg) {
+    (void)s; (void)fn; (void)arg;
+    return -1;
+}
+
+int coro_sched_run(coro_sched* s) {
+    (void)s;
+    return -1;
+}
+
+void coro_sched_cleanup(coro_sched* s) {
+    (void)s;
+}
+
+int coro_pin_thread(int cpu) {
+    (void)cpu;
+    return -1;
+}
+
+int coro_poll(int fd, short events, int timeout_ms) {
+    struct pollfd pfd = { fd, events, 0 };
+    int n = poll(&pfd, 1, timeout_ms);
+    return n < 0 ? (errno == EINTR ? 0 : -1) : n > 0;
+}
+
+void coro_sleep_ns(uint64_t ns) {
+    nap_ns(ns);
+}
+
+void coro_yield(void) {
+}
+
+void coro_cond_wait(coro_cond* cv) {
+    (void)cv;
+}
+
+void coro_cond_signal(coro_cond* cv) {
+    (void)cv;
+}
+
+void coro_cond_broadcast(coro_cond* cv) {
+    (void)cv;
+}
+
+#endif
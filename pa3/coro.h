@@ -0,0 +1,137 @@
+/* coro.h
+ * Akira Youngblood, 2026-10-17
+ * Stackful coroutines for multi-lookup's resolver tasks (-k)
+ *
+ * A blocking lookup ties up a whole thread while it waits on the network:
+ * an 8 MB stack reservation, a kernel task, and a context switch through
+ * the kernel on every wakeup. Here a lookup is a coroutine instead: a few
+ * tens of KB of stack of its own, switched to and from in user space with
+ * swapcontext(). Each scheduler thread runs many of them:
+ *
+ *   - a coroutine that would block calls coro_poll() or coro_sleep_ns(),
+ *     which park it on the thread's epoll set or timer heap and switch to
+ *     the next runnable one;
+ *   - with nothing runnable, the thread sleeps in epoll_wait() until a
+ *     socket is ready or the earliest timer is due;
+ *   - coroutines never move between threads, so a scheduler's run queue,
+ *     timers and coro_cond wait lists are its own and take no locks.
+ *
+ * coro_poll() and coro_sleep_ns() fall back to poll() and nanosleep() when
+ * not called from a coroutine, so code below dnslookup() (dnsbackend.c,
+ * ratelimit.c, dnscache.c) calls them unconditionally and works the same
+ * on a plain thread.
+ *
+ * Stacks are mmap()ed with MAP_NORESERVE and a guard page below, so only the
+ * pages a coroutine actually touches take memory, and an overflow faults
+ * instead of corrupting a neighbour.
+ *
+ * Linux only (epoll); elsewhere coro_sched_init() fails.
+ */
+
+#ifndef CORO_H
+#define CORO_H
+
+#include <poll.h>
+#include <stdint.h>
+
+#define CORO_STACK_SIZE (64 * 1024) // per coroutine, reserved not committed
+#define CORO_EVENTS 256             // epoll events taken per wakeup
+
+typedef struct coro_s coro;
+typedef void (*coro_fn)(void* arg);
+
+// Coroutines waiting on one condition, on one scheduler
+typedef struct coro_cond_s {
+    coro* head;
+    coro* tail;
+} coro_cond;
+
+typedef struct coro_timer_s {
+    uint64_t at;                // due, CLOCK_MONOTONIC ns
+    coro* c;
+} coro_timer;
+
+typedef struct coro_sched_s {
+    int epfd;
+    void* main_ctx;             // ucontext_t of the thread running the scheduler
+    coro* current;              // NULL: in the scheduler itself
+    coro* run_head;             // runnable, in order
+    coro* run_tail;
+    coro_timer* timers;         // min-heap on at
+    int ntimers;
+    int captimers;
+    int live;                   // spawned and not finished
+    int io_waiting;             // parked in coro_poll()
+    int sleeping;               // ... in coro_sleep_ns()
+    // Counters
+    unsigned long spawned;
+    unsigned long switches;     // into a coroutine
+    unsigned long polls;        // coro_poll() calls that had to park
+    unsigned long sleeps;       // coro_sleep_ns() calls
+    unsigned long wakeups;      // epoll_wait() calls
+    int peak_waiting;           // most parked in either at once
+} coro_sched;
+
+/* Set up a scheduler, to be run by one thread
+ * Returns 0 on success, -1 on failure (no epoll, not Linux)
+ */
+int coro_sched_init(coro_sched* s);
+
+/* Start fn(arg) as a new coroutine on s; it first runs once s is run
+ * (or, from a coroutine on s, once that one parks or yields)
+ * Returns 0 on success, -1 if out of memory
+ */
+int coro_spawn(coro_sched* s, coro_fn fn, void* arg);
+
+/* Run s on the calling thread until every coroutine on it has returned
+ * Returns 0, or -1 if the rest are all parked on coro_conds that nobody
+ * can signal anymore (they are left unfinished)
+ */
+int coro_sched_run(coro_sched* s);
+
+/* Free s; its coroutines must have finished */
+void coro_sched_cleanup(coro_sched* s);
+
+/* Pin the calling thread to one CPU, cpu modulo the CPUs online
+ * Returns 0 on success, -1 if it can't be done here (best effort)
+ */
+int coro_pin_thread(int cpu);
+
+/* Whether the caller is a coroutine (and so may park) */
+int coro_active(void);
+
+/* Whether the calling coroutine's scheduler has anything else to do: other
+ * coroutines runnable, waiting on a socket or sleeping. 0 from a plain
+ * thread.
+ */
+int coro_busy(void);
+
+/* Whether other coroutines on the caller's scheduler are ready to run right
+ * now (not parked). 0 from a plain thread.
+ */
+int coro_runnable(void);
+
+/* Wait up to timeout_ms (-1: no limit) for events (POLLIN, POLLOUT) on fd,
+ * parking the coroutine meanwhile, or with poll() off a coroutine
+ * Returns 1 if fd is ready, 0 on timeout, -1 on failure
+ */
+int coro_poll(int fd, short events, int timeout_ms);
+
+/* Sleep for ns, parking the coroutine meanwhile, or with nanosleep() off a
+ * coroutine */
+void coro_sleep_ns(uint64_t ns);
+
+/* Let the other runnable coroutines on this scheduler run first (a no-op
+ * off a coroutine) */
+void coro_yield(void);
+
+/* Park the calling coroutine on cv until coro_cond_signal() or
+ * coro_cond_broadcast() from a coroutine of the same scheduler; there is no
+ * lock, a scheduler only switches at these calls
+ */
+void coro_cond_init(coro_cond* cv);
+void coro_cond_wait(coro_cond* cv);
+void coro_cond_signal(coro_cond* cv);
+void coro_cond_broadcast(coro_cond* cv);
+
+#endif
@@ -0,0 +1,164 @@
+/* dedup.c
+ * Akira Youngblood, 2026-10-17
+ * Hostname deduplication stage for multi-lookup (-d)
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dedup.h"
+#include "dnscache.h" // dnscache_normalize()
+
+#define INITIAL_BUCKETS 64 // per shard, power of two
+
+static dedup_shard* shard_for(dedup_set* d, uint64_t hash) {
+    return &d->shards[hash & (DEDUP_SHARDS - 1)];
+}
+
+// Bucket index uses the bits above the ones that picked the shard
+static int bucket_for(dedup_shard* s, uint64_t hash) {
+    return (int)((hash >> 6) & s->mask);
+}
+
+static dedup_entry* find(dedup_shard* s, uint64_t hash, const char* name) {
+    dedup_entry* e;
+    for (e = s->buckets[bucket_for(s, hash)]; e; e = e->next) {
+        if (e->hash == hash && strcmp(e->name, name) == 0) return e;
+    }
+    return NULL;
+}
+
+// Double the bucket array once the shard averages more than one entry per
+// bucket. Called with the shard locked; on malloc failure just stay small.
+static void grow(dedup_shard* s) {
+    int i, newmask = s->mask * 2 + 1;
+    dedup_entry** buckets = calloc(newmask + 1, sizeof(dedup_entry*));
+    if (!buckets) return;
+    for (i = 0; i <= s->mask; ++i) {
+        dedup_entry* e = s->buckets[i];
+        while (e) {
+            dedup_entry* next = e->next;
+            int b = (int)((e->hash >> 6) & newmask);
+            e->next = buckets[b];
+            buckets[b] = e;
+            e = next;
+        }
+    }
+    free(s->buckets);
+    s->buckets = buckets;
+    s->mask = newmask;
+}
+
+// Take e out of its shard and free it. Called with the shard locked.
+static void unlink_entry(dedup_shard* s, dedup_entry* e) {
+    dedup_entry** p = &s->buckets[bucket_for(s, e->hash)];
+    while (*p != e) p = &(*p)->next;
+    *p = e->next;
+    s->count--;
+    free(e->name);
+    free(e);
+}
+
+int dedup_init(dedup_set* d) {
+    int i;
+    atomic_init(&d->total, 0);
+    atomic_init(&d->unique, 0);
+    for (i = 0; i < DEDUP_SHARDS; ++i) {
+        dedup_shard* s = &d->shards[i];
+        s->buckets = calloc(INITIAL_BUCKETS, sizeof(dedup_entry*));
+        s->mask = INITIAL_BUCKETS - 1;
+        s->count = 0;
+        if (!s->buckets || pthread_mutex_init(&s->lock, NULL)) {
+            perror("Error initializing dedup set");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int dedup_add(dedup_set* d, const char* hostname, void* payload, char* result, int size) {
+    char name[1025];
+    uint64_t hash = dnscache_normalize(hostname, name, sizeof(name));
+    dedup_shard* s = shard_for(d, hash);
+    int rv = DEDUP_NEW;
+
+    atomic_fetch_add_explicit(&d->total, 1, memory_order_relaxed);
+    pthread_mutex_lock(&s->lock);
+    dedup_entry* e = find(s, hash, name);
+    if (e == NULL) {
+        // First occurrence, the caller resolves it
+        e = malloc(sizeof(dedup_entry));
+        if (e && (e->name = strdup(name)) != NULL) {
+            if (s->count > s->mask) grow(s);
+            e->hash = hash;
+            e->state = DEDUP_WAITING;
+            e->result = NULL;
+            e->waiters = NULL;
+            int b = bucket_for(s, hash);
+            e->next = s->buckets[b];
+            s->buckets[b] = e;
+            s->count++;
+        } else {
+            free(e);
+        }
+        atomic_fetch_add_explicit(&d->unique, 1, memory_order_relaxed);
+    } else if (e->state == DEDUP_WAITING) {
+        dedup_waiter* w = malloc(sizeof(dedup_waiter));
+        if (w) {
+            w->payload = payload;
+            w->next = e->waiters;
+            e->waiters = w;
+            rv = DEDUP_WAITING;
+        }
+    } else {
+        if (e->state == DEDUP_HIT) {
+            strncpy(result, e->result, size);
+            result[size-1] = '\0';
+        }
+        rv = e->state;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return rv;
+}
+
+dedup_waiter* dedup_complete(dedup_set* d, const char* hostname, const char* result) {
+    char name[1025];
+    uint64_t hash = dnscache_normalize(hostname, name, sizeof(name));
+    dedup_shard* s = shard_for(d, hash);
+    dedup_waiter* waiters = NULL;
+
+    pthread_mutex_lock(&s->lock);
+    dedup_entry* e = find(s, hash, name);
+    if (e && e->state == DEDUP_WAITING) {
+        e->result = result ? strdup(result) : NULL;
+        e->state = result ? DEDUP_HIT : DEDUP_NEGATIVE;
+        waiters = e->waiters;
+        e->waiters = NULL;
+        if (result && e->result == NULL) {
+            // Out of memory for the copy: forget the name, so the next
+            // occurrence is looked up again instead of waiting forever
+            unlink_entry(s, e);
+        }
+    }
+    pthread_mutex_unlock(&s->lock);
+    return waiters;
+}
+
+void dedup_cleanup(dedup_set* d) {
+    int i, b;
+    for (i = 0; i < DEDUP_SHARDS; ++i) {
+        dedup_shard* s = &d->shards[i];
+        for (b = 0; b <= s->mask; ++b) {
+            dedup_entry* e = s->buckets[b];
+            while (e) {
+                dedup_entry* next = e->next;
+                free(e->name);
+                free(e->result);
+                free(e);
+                e = next;
+            }
+        }
+        free(s->buckets);
+        pthread_mutex_destroy(&s->lock);
+    }
+}
@@ -0,0 +1,77 @@
+/* dedup.h
+ * Akira Youngblood, 2026-10-17
+ * Hostname deduplication stage for multi-lookup (-d)
+ *
+ * A concurrent hash set, sharded like dnscache.c and keyed the same way
+ * (lowercase, no trailing dot), that requesters check before queueing a
+ * name. Only the first occurrence of a name is queued and resolved. Later
+ * occurrences are either answered on the spot (the result is already in)
+ * or attached to the entry as waiters, which the resolver that completes
+ * the lookup takes back and writes lines for. Every occurrence still gets
+ * its own output line, under its own spelling.
+ *
+ * Unlike dnscache, nothing expires: a name is resolved once per run.
+ */
+
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define DEDUP_SHARDS 64 // power of two
+
+// dedup_add() results
+#define DEDUP_NEW 0      // first occurrence: resolve it, then dedup_complete()
+#define DEDUP_WAITING 1  // attached to the lookup in progress, payload kept
+#define DEDUP_HIT 2      // already resolved, result filled in
+#define DEDUP_NEGATIVE 3 // already resolved, the lookup failed
+
+// An occurrence waiting for its name's lookup
+typedef struct dedup_waiter_s {
+    struct dedup_waiter_s* next;
+    void* payload; // what the caller passed to dedup_add()
+} dedup_waiter;
+
+typedef struct dedup_entry_s {
+    uint64_t hash;
+    char* name;
+    int state;              // DEDUP_WAITING until completed, then HIT/NEGATIVE
+    char* result;           // HIT: the address(es)
+    dedup_waiter* waiters;
+    struct dedup_entry_s* next;
+} dedup_entry;
+
+typedef struct dedup_shard_s {
+    pthread_mutex_t lock;
+    dedup_entry** buckets;
+    int mask;
+    int count;
+} dedup_shard;
+
+typedef struct dedup_set_s {
+    dedup_shard shards[DEDUP_SHARDS];
+    atomic_ulong total;  // names added
+    atomic_ulong unique; // of which first occurrences
+} dedup_set;
+
+/* Returns 0 on success, -1 on failure */
+int dedup_init(dedup_set* d);
+
+/* Add an occurrence of hostname. On DEDUP_WAITING, payload is kept until
+ * dedup_complete() hands it back; otherwise the caller keeps it.
+ * On DEDUP_HIT the result is copied to result (size bytes).
+ * If memory runs out, returns DEDUP_NEW (the name is just resolved again).
+ */
+int dedup_add(dedup_set* d, const char* hostname, void* payload, char* result, int size);
+
+/* Store the result for a DEDUP_NEW name (NULL: lookup failed)
+ * Returns the occurrences that were waiting for it, for the caller to
+ * answer and free(), or NULL
+ */
+dedup_waiter* dedup_complete(dedup_set* d, const char* hostname, const char* result);
+
+void dedup_cleanup(dedup_set* d);
+
+#endif
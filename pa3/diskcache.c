@@ -0,0 +1,153 @@
+/* diskcache.c
+ * Akira Youngblood, 2026-10-17
+ * Persistent, memory-mapped DNS result cache
+ */
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "diskcache.h"
+#include "dnscache.h" // dnscache_normalize(), so both caches agree on keys
+
+_Static_assert(sizeof(diskcache_slot) == 64, "cache file slots are 64 bytes");
+_Static_assert(sizeof(diskcache_header) == 64, "cache file header is 64 bytes");
+
+static uint64_t key_of(const char* hostname) {
+    char name[1025];
+    uint64_t hash = dnscache_normalize(hostname, name, sizeof(name));
+    return hash ? hash : 1; // 0 means empty slot
+}
+
+uint32_t diskcache_home(uint64_t hash, uint32_t mask) {
+    // Fold the high bits in, FNV's low bits alone cluster on similar names
+    return (uint32_t)(hash ^ (hash >> 32)) & mask;
+}
+
+int diskcache_open(diskcache* dc, const char* path, int nslots) {
+    struct stat st;
+    uint32_t cap = 1;
+
+    dc->header = NULL;
+    dc->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (dc->fd < 0) {
+        perror("Error opening cache file");
+        return -1;
+    }
+    if (flock(dc->fd, LOCK_EX | LOCK_NB) < 0) {
+        fprintf(stderr, "Cache file %s is in use by another run\n", path);
+        goto fail;
+    }
+    if (fstat(dc->fd, &st) < 0) {
+        perror("Error on cache file fstat");
+        goto fail;
+    }
+
+    int fresh = (st.st_size == 0);
+    if (fresh) {
+        // New file: size it, the slots stay sparse until written
+        if (nslots <= 0) nslots = DISKCACHE_DEFAULT_SLOTS;
+        while (cap < (uint32_t)nslots) cap <<= 1;
+        dc->size = sizeof(diskcache_header) + (size_t)cap * sizeof(diskcache_slot);
+        if (ftruncate(dc->fd, dc->size) < 0) {
+            perror("Error sizing cache file");
+            goto fail;
+        }
+    } else {
+        dc->size = st.st_size;
+        if (dc->size < sizeof(diskcache_header)) goto bad;
+    }
+
+    dc->header = mmap(NULL, dc->size, PROT_READ | PROT_WRITE, MAP_SHARED, dc->fd, 0);
+    if (dc->header == MAP_FAILED) {
+        dc->header = NULL;
+        perror("Error mapping cache file");
+        goto fail;
+    }
+    if (fresh) {
+        dc->header->magic = DISKCACHE_MAGIC;
+        dc->header->version = DISKCACHE_VERSION;
+        dc->header->slot_size = sizeof(diskcache_slot);
+        dc->header->nslots = cap;
+    }
+    // Trust nothing about an existing file until the header checks out
+    cap = dc->header->nslots;
+    if (dc->header->magic != DISKCACHE_MAGIC || dc->header->version != DISKCACHE_VERSION ||
+        dc->header->slot_size != sizeof(diskcache_slot) || cap == 0 || (cap & (cap - 1)) ||
+        dc->size != sizeof(diskcache_header) + (size_t)cap * sizeof(diskcache_slot)) {
+        goto bad;
+    }
+    dc->slots = (diskcache_slot*)(dc->header + 1);
+    dc->mask = cap - 1;
+    atomic_init(&dc->hits, 0);
+    atomic_init(&dc->stores, 0);
+    if (pthread_mutex_init(&dc->lock, NULL)) goto fail;
+    return 0;
+
+bad:
+    fprintf(stderr, "%s is not a multi-lookup cache file\n", path);
+fail:
+    if (dc->header) munmap(dc->header, dc->size);
+    close(dc->fd);
+    return -1;
+}
+
+int diskcache_get(diskcache* dc, const char* hostname, char* ipstr, int size, uint32_t* ttl) {
+    uint64_t hash = key_of(hostname);
+    uint32_t i, home = diskcache_home(hash, dc->mask);
+    int64_t now = time(NULL);
+    int rv = DISKCACHE_EMPTY;
+
+    pthread_mutex_lock(&dc->lock);
+    for (i = 0; i < DISKCACHE_PROBES; ++i) {
+        diskcache_slot* slot = &dc->slots[(home + i) & dc->mask];
+        // Slots are never emptied, so an empty one ends the probe sequence
+        if (slot->hash == 0) break;
+        if (slot->hash != hash) continue;
+        if (slot->expires > now) {
+            rv = slot->state;
+            *ttl = (uint32_t)(slot->expires - now);
+            if (rv == DISKCACHE_POSITIVE) {
+                strncpy(ipstr, slot->addr, size);
+                ipstr[size-1] = '\0';
+            }
+        }
+        break;
+    }
+    pthread_mutex_unlock(&dc->lock);
+    if (rv != DISKCACHE_EMPTY) atomic_fetch_add(&dc->hits, 1);
+    return rv;
+}
+
+void diskcache_put(diskcache* dc, const char* hostname, const char* ipstr, uint32_t ttl) {
+    uint64_t hash = key_of(hostname);
+    uint32_t i, home = diskcache_home(hash, dc->mask);
+    diskcache_slot* victim = NULL;
+
+    pthread_mutex_lock(&dc->lock);
+    for (i = 0; i < DISKCACHE_PROBES; ++i) {
+        diskcache_slot* slot = &dc->slots[(home + i) & dc->mask];
+        if (slot->hash == hash || slot->hash == 0) {
+            victim = slot;
+            break;
+        }
+        // Table is crowded here: evict whatever expires first
+        if (victim == NULL || slot->expires < victim->expires) victim = slot;
+    }
+    victim->expires = (int64_t)time(NULL) + ttl;
+    victim->state = ipstr ? DISKCACHE_POSITIVE : DISKCACHE_NEGATIVE;
+    strncpy(victim->addr, ipstr ? ipstr : "", sizeof(victim->addr));
+    victim->addr[sizeof(victim->addr)-1] = '\0';
+    victim->hash = hash;
+    pthread_mutex_unlock(&dc->lock);
+    atomic_fetch_add(&dc->stores, 1);
+}
+
+void diskcache_close(diskcache* dc) {
+    munmap(dc->header, dc->size);
+    close(dc->fd); // also drops the flock
+    pthread_mutex_destroy(&dc->lock);
+}
@@ -0,0 +1,86 @@
+/* diskcache.h
+ * Akira Youngblood, 2026-10-17
+ * Persistent, memory-mapped DNS result cache shared across multi-lookup runs
+ *
+ * The file is a fixed-size open-addressing table: a 64 byte header followed
+ * by 64 byte slots of (hostname hash, expiry, address). It is mapped with
+ * MAP_SHARED and used in place, so loading it costs nothing up front and
+ * every store lands in the file. Expiry times are wall-clock (time(NULL))
+ * so they survive across runs. Only the 64-bit hash of the normalized name is
+ * kept, not the name itself.
+ *
+ * One process at a time: diskcache_open() takes an exclusive flock() and
+ * fails if another run holds the file. Inside a process, calls are
+ * serialized by a mutex (they are a handful of loads and stores).
+ * tools/cache-tool drops expired entries and resizes the table.
+ */
+
+#ifndef DISKCACHE_H
+#define DISKCACHE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "util.h"
+
+#define DISKCACHE_MAGIC 0x4D4C4443u // "MLDC"
+#define DISKCACHE_VERSION 1
+#define DISKCACHE_DEFAULT_SLOTS (1 << 18) // 16 MB file, sparse until used
+#define DISKCACHE_PROBES 32 // slots searched before evicting
+
+// Slot states
+#define DISKCACHE_EMPTY 0
+#define DISKCACHE_POSITIVE 1
+#define DISKCACHE_NEGATIVE 2
+
+typedef struct diskcache_header_s {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_size;
+    uint32_t nslots; // power of two
+    char reserved[48];
+} diskcache_header;
+
+typedef struct diskcache_slot_s {
+    uint64_t hash;   // 0 marks an empty slot
+    int64_t expires; // seconds since the epoch
+    uint8_t state;
+    char addr[INET6_ADDRSTRLEN];
+    char pad[64 - 17 - INET6_ADDRSTRLEN];
+} diskcache_slot;
+
+typedef struct diskcache_s {
+    int fd;
+    size_t size;
+    diskcache_header* header;
+    diskcache_slot* slots;
+    uint32_t mask;
+    pthread_mutex_t lock;
+    atomic_ulong hits;
+    atomic_ulong stores;
+} diskcache;
+
+/* Map a cache file, creating it with nslots slots (rounded up to a power of
+ * two, DISKCACHE_DEFAULT_SLOTS if <= 0) if it doesn't exist
+ * Returns 0 on success, -1 on failure (including: locked by another run)
+ */
+int diskcache_open(diskcache* dc, const char* path, int nslots);
+
+/* Look up hostname, fills ipstr for a positive entry and sets *ttl to the
+ * seconds it has left
+ * Returns DISKCACHE_POSITIVE, DISKCACHE_NEGATIVE, or DISKCACHE_EMPTY if there
+ * is no unexpired entry
+ */
+int diskcache_get(diskcache* dc, const char* hostname, char* ipstr, int size, uint32_t* ttl);
+
+/* Store a result (ipstr NULL for a failed lookup) valid for ttl seconds */
+void diskcache_put(diskcache* dc, const char* hostname, const char* ipstr, uint32_t ttl);
+
+/* Slot index for a hash in a table of mask+1 slots, shared with cache-tool */
+uint32_t diskcache_home(uint64_t hash, uint32_t mask);
+
+/* Unmap and close (changes are already in the file) */
+void diskcache_close(diskcache* dc);
+
+#endif
@@ -0,0 +1,339 @@
+/* dnsasync.c
+ * Akira Youngblood, 2026-10-17
+ * Event-driven, non-blocking DNS resolver (Linux, epoll)
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dnsasync.h"
+
+#ifdef __linux__
+#define HAVE_EPOLL 1
+#include <sys/epoll.h>
+#endif
+
+#define RESOLV_CONF "/etc/resolv.conf"
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static long long now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// xorshift32, only needs to make IDs hard to guess from outside
+static uint16_t next_id(dnsasync* e) {
+    uint32_t x = e->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    e->rng = x;
+    return (uint16_t)(x >> 8);
+}
+
+// Deadline list: queries are appended when (re)sent and all share one
+// timeout, so the list stays sorted by deadline without any searching
+static void list_append(dnsasync* e, dnsasync_query* q) {
+    q->next = NULL;
+    q->prev = e->newest;
+    if (e->newest) e->newest->next = q;
+    else e->oldest = q;
+    e->newest = q;
+}
+
+static void send_query(dnsasync* e, dnsasync_query* q) {
+    // A failed send (e.g. EAGAIN) just looks like a lost packet to us
+    send(e->socks[q->sock], q->packet, q->len, 0);
+    q->deadline = now_ms() + e->timeout_ms;
+    q->tries++;
+    e->sent++;
+    list_append(e, q);
+}
+
+// Everything below that takes queries out of flight runs from dnsasync_run()
+#ifdef HAVE_EPOLL
+
+static void list_remove(dnsasync* e, dnsasync_query* q) {
+    if (q->prev) q->prev->next = q->next;
+    else e->oldest = q->next;
+    if (q->next) q->next->prev = q->prev;
+    else e->newest = q->prev;
+    q->prev = q->next = NULL;
+}
+
+// Take q out of flight, fire its callback, and return it to the pool
+static void finish(dnsasync* e, dnsasync_query* q, int status, const char* ipstr, uint32_t ttl) {
+    list_remove(e, q);
+    e->by_id[q->id] = NULL;
+    e->inflight--;
+    q->cb(q->arg, q->name, status, ipstr, ttl, now_us() - q->submitted);
+    q->next = e->free_list;
+    e->free_list = q;
+}
+
+static int handle_packet(dnsasync* e, int sock, const unsigned char* buf, int len) {
+    dns_answer ans;
+    char ipstr[INET6_ADDRSTRLEN];
+    uint16_t id;
+    dnsasync_query* q;
+
+    if (dns_packet_id(buf, len, &id) == DNS_FAILURE) return 0;
+    q = e->by_id[id];
+    // Stray, late or spoofed answers are dropped and the query keeps waiting
+    if (q == NULL || q->sock != sock) return 0;
+    if (dns_parse_response(buf, len, q->name, DNS_TYPE_A, &ans) == DNS_FAILURE) return 0;
+
+    if (ans.rcode == DNS_RCODE_NXDOMAIN) {
+        finish(e, q, DNSASYNC_NXDOMAIN, "", 0);
+    } else if (ans.rcode != DNS_RCODE_NOERROR || ans.family == 0 ||
+               !inet_ntop(ans.family, ans.addr, ipstr, sizeof(ipstr))) {
+        finish(e, q, DNSASYNC_SERVFAIL, "", 0);
+    } else {
+        finish(e, q, DNSASYNC_OK, ipstr, ans.ttl);
+    }
+    return 1;
+}
+
+#endif
+
+int dnsasync_parse_server(const char* spec, struct sockaddr_storage* addr, socklen_t* addrlen) {
+    char host[256], line[512];
+    const char* port = "53";
+    struct addrinfo hints, *res = NULL;
+
+    if (strcmp(spec, "system") == 0) {
+        // First "nameserver" line of resolv.conf
+        FILE* fp = fopen(RESOLV_CONF, "r");
+        host[0] = '\0';
+        if (fp) {
+            while (fgets(line, sizeof(line), fp)) {
+                if (sscanf(line, " nameserver %255s", host) == 1) break;
+                host[0] = '\0';
+            }
+            fclose(fp);
+        }
+        if (host[0] == '\0') {
+            fprintf(stderr, "No nameserver found in %s\n", RESOLV_CONF);
+            return DNS_FAILURE;
+        }
+    } else if (spec[0] == '[') {
+        // [v6addr] or [v6addr]:port
+        const char* close = strchr(spec, ']');
+        if (!close || close - spec - 1 >= (long)sizeof(host)) return DNS_FAILURE;
+        memcpy(host, spec + 1, close - spec - 1);
+        host[close - spec - 1] = '\0';
+        if (close[1] == ':') port = close + 2;
+    } else {
+        const char* colon = strchr(spec, ':');
+        if (strlen(spec) >= sizeof(host)) return DNS_FAILURE;
+        strcpy(host, spec);
+        // Exactly one colon means host:port, more means a bare IPv6 address
+        if (colon && !strchr(colon + 1, ':')) {
+            host[colon - spec] = '\0';
+            port = colon + 1;
+        }
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+    if (getaddrinfo(host, port, &hints, &res) || res == NULL) {
+        fprintf(stderr, "Invalid nameserver address: %s\n", spec);
+        return DNS_FAILURE;
+    }
+    memcpy(addr, res->ai_addr, res->ai_addrlen);
+    *addrlen = res->ai_addrlen;
+    freeaddrinfo(res);
+    return DNS_SUCCESS;
+}
+
+#ifdef HAVE_EPOLL
+
+int dnsasync_init(dnsasync* e, const struct sockaddr* server, socklen_t addrlen,
+                  int max_inflight, int timeout_ms, int retries) {
+    int i;
+    memset(e, 0, sizeof(*e));
+    for (i = 0; i < DNSASYNC_SOCKETS; ++i) e->socks[i] = -1;
+    if (max_inflight <= 0 || max_inflight > DNSASYNC_MAX_INFLIGHT) max_inflight = DNSASYNC_MAX_INFLIGHT;
+    e->max_inflight = max_inflight;
+    e->timeout_ms = timeout_ms;
+    e->retries = retries;
+    e->rng = (uint32_t)now_ms() ^ ((uint32_t)getpid() << 16) ^ 0x9E3779B9u;
+    if (e->rng == 0) e->rng = 1;
+
+    e->epfd = epoll_create1(0);
+    e->pool = calloc(max_inflight, sizeof(dnsasync_query));
+    e->by_id = calloc(65536, sizeof(dnsasync_query*));
+    if (e->epfd < 0 || !e->pool || !e->by_id) {
+        perror("Error setting up async resolver");
+        goto fail;
+    }
+    for (i = 0; i < max_inflight; ++i) {
+        e->pool[i].next = e->free_list;
+        e->free_list = &e->pool[i];
+    }
+
+    // A few connected, non-blocking sockets: the kernel filters replies from
+    // other addresses, and each socket gets its own random source port
+    for (i = 0; i < DNSASYNC_SOCKETS; ++i) {
+        int fd = socket(server->sa_family, SOCK_DGRAM, 0);
+        int rcvbuf = 1 << 20; // bursts of thousands of answers
+        struct epoll_event ev;
+        if (fd < 0) {
+            perror("Error creating resolver socket");
+            goto fail;
+        }
+        e->socks[i] = fd;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0 ||
+            connect(fd, server, addrlen) < 0) {
+            perror("Error connecting resolver socket");
+            goto fail;
+        }
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        if (epoll_ctl(e->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            perror("Error on epoll_ctl");
+            goto fail;
+        }
+    }
+    return DNS_SUCCESS;
+
+fail:
+    dnsasync_cleanup(e);
+    return DNS_FAILURE;
+}
+
+#else
+
+// No epoll in this build: the engine never starts, so -a is refused
+int dnsasync_init(dnsasync* e, const struct sockaddr* server, socklen_t addrlen,
+                  int max_inflight, int timeout_ms, int retries) {
+    int i;
+    (void)server; (void)addrlen; (void)max_inflight; (void)timeout_ms; (void)retries;
+    memset(e, 0, sizeof(*e));
+    for (i = 0; i < DNSASYNC_SOCKETS; ++i) e->socks[i] = -1;
+    e->epfd = -1;
+    fprintf(stderr,"Async resolver unsupported: it needs epoll (Linux)\n");
+    return DNS_FAILURE;
+}
+
+#endif
+
+int dnsasync_submit(dnsasync* e, const char* hostname, dnsasync_callback cb, void* arg) {
+    dnsasync_query* q = e->free_list;
+    uint16_t id;
+    if (q == NULL) return DNSASYNC_FULL;
+    if (strlen(hostname) > DNS_MAX_NAME + 1) return DNSASYNC_BADNAME;
+
+    // Pick an unused ID, at most half of them are taken
+    do {
+        id = next_id(e);
+    } while (e->by_id[id] != NULL);
+
+    q->len = dns_build_query(q->packet, sizeof(q->packet), id, hostname, DNS_TYPE_A);
+    if (q->len < 0) return DNSASYNC_BADNAME;
+    e->free_list = q->next;
+    strcpy(q->name, hostname);
+    q->id = id;
+    q->sock = e->next_sock;
+    e->next_sock = (e->next_sock + 1) % DNSASYNC_SOCKETS;
+    q->tries = 0;
+    q->submitted = now_us();
+    q->cb = cb;
+    q->arg = arg;
+    e->by_id[id] = q;
+    e->inflight++;
+    send_query(e, q);
+    return DNSASYNC_QUEUED;
+}
+
+int dnsasync_inflight(dnsasync* e) {
+    return e->inflight;
+}
+
+#ifdef HAVE_EPOLL
+
+int dnsasync_run(dnsasync* e, int wait_ms) {
+    struct epoll_event events[DNSASYNC_SOCKETS];
+    unsigned char buf[DNS_MAX_PACKET];
+    int i, n, completed = 0;
+    long long now = now_ms();
+
+    // Don't sleep past the next retransmit
+    if (e->oldest) {
+        long long until = e->oldest->deadline - now;
+        if (until < 0) until = 0;
+        if (wait_ms < 0 || until < wait_ms) wait_ms = (int)until;
+    }
+
+    n = epoll_wait(e->epfd, events, DNSASYNC_SOCKETS, wait_ms);
+    if (n < 0 && errno != EINTR) {
+        perror("Error on epoll_wait");
+        return -1;
+    }
+    for (i = 0; i < n; ++i) {
+        int sock = events[i].data.u32;
+        ssize_t len;
+        // Drain the socket before going back to epoll_wait
+        while ((len = recv(e->socks[sock], buf, sizeof(buf), 0)) >= 0 || errno == ECONNREFUSED) {
+            // ECONNREFUSED: ICMP port unreachable for an earlier send,
+            // treated like a lost packet
+            if (len >= 0) completed += handle_packet(e, sock, buf, (int)len);
+        }
+    }
+
+    // Retransmit or give up on everything past its deadline
+    now = now_ms();
+    while (e->oldest && e->oldest->deadline <= now) {
+        dnsasync_query* q = e->oldest;
+        if (q->tries > e->retries) {
+            e->timeouts++;
+            finish(e, q, DNSASYNC_TIMEOUT, "", 0);
+            completed++;
+        } else {
+            list_remove(e, q);
+            e->retransmits++;
+            send_query(e, q);
+        }
+    }
+    return completed;
+}
+
+#else
+
+int dnsasync_run(dnsasync* e, int wait_ms) {
+    (void)e; (void)wait_ms;
+    return -1;
+}
+
+#endif
+
+void dnsasync_cleanup(dnsasync* e) {
+    int i;
+    for (i = 0; i < DNSASYNC_SOCKETS; ++i) {
+        if (e->socks[i] >= 0) close(e->socks[i]);
+        e->socks[i] = -1;
+    }
+    if (e->epfd >= 0) close(e->epfd);
+    e->epfd = -1;
+    free(e->pool);
+    free(e->by_id);
+    e->pool = NULL;
+    e->by_id = NULL;
+}
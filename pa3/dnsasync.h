@@ -0,0 +1,110 @@
+/* dnsasync.h
+ * Akira Youngblood, 2026-10-17
+ * Event-driven, non-blocking DNS resolver (Linux, epoll)
+ *
+ * Instead of one blocking getaddrinfo() per thread, queries are built by hand
+ * (dnsproto.c), sent over a few non-blocking UDP sockets to one nameserver
+ * and matched back up by query ID, so a single thread can keep thousands of
+ * lookups in flight. Lost queries are retransmitted after a timeout.
+ *
+ * Usage: dnsasync_submit() while dnsasync_inflight() < the max, then call
+ * dnsasync_run() to wait for answers; completion callbacks fire from inside
+ * dnsasync_run(). An engine must only be used by one thread.
+ */
+
+#ifndef DNSASYNC_H
+#define DNSASYNC_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "dnsproto.h"
+
+#define DNSASYNC_SOCKETS 4
+#define DNSASYNC_MAX_INFLIGHT 32768 // half the ID space, keeps ID picks cheap
+
+// Submit results
+#define DNSASYNC_QUEUED 0
+#define DNSASYNC_BADNAME -1
+#define DNSASYNC_FULL -2
+
+// Completion statuses
+#define DNSASYNC_OK 0
+#define DNSASYNC_NXDOMAIN 1
+#define DNSASYNC_SERVFAIL 2 // any other error rcode, or no address in the answer
+#define DNSASYNC_TIMEOUT 3
+
+/* Called once per submitted lookup
+ * ipstr is the first address found ("" unless status is DNSASYNC_OK), ttl
+ * its TTL in seconds, latency_us the time since dnsasync_submit(). hostname
+ * and ipstr are only valid during the call.
+ */
+typedef void (*dnsasync_callback)(void* arg, const char* hostname, int status,
+                                  const char* ipstr, uint32_t ttl, long long latency_us);
+
+typedef struct dnsasync_query_s {
+    char name[DNS_MAX_NAME + 2];
+    unsigned char packet[DNS_MAX_PACKET];
+    int len;
+    uint16_t id;
+    int sock;
+    int tries;
+    long long deadline; // ms, CLOCK_MONOTONIC
+    long long submitted; // us, CLOCK_MONOTONIC
+    dnsasync_callback cb;
+    void* arg;
+    // Deadline list (oldest first) while in flight, free list otherwise
+    struct dnsasync_query_s* prev;
+    struct dnsasync_query_s* next;
+} dnsasync_query;
+
+typedef struct dnsasync_s {
+    int epfd;
+    int socks[DNSASYNC_SOCKETS];
+    int next_sock;
+    dnsasync_query* pool;
+    dnsasync_query* free_list;
+    dnsasync_query** by_id;  // 65536 entries, in-flight query per ID
+    dnsasync_query* oldest;
+    dnsasync_query* newest;
+    int max_inflight;
+    int inflight;
+    int timeout_ms;
+    int retries;
+    uint32_t rng;
+    // Counters
+    unsigned long sent;
+    unsigned long retransmits;
+    unsigned long timeouts;
+} dnsasync;
+
+/* Parse a nameserver spec: "host", "host:port", "[v6addr]:port", or
+ * "system" for the first nameserver in /etc/resolv.conf
+ * Returns DNS_SUCCESS or DNS_FAILURE
+ */
+int dnsasync_parse_server(const char* spec, struct sockaddr_storage* addr, socklen_t* addrlen);
+
+/* Set up sockets and the query pool
+ * Returns DNS_SUCCESS or DNS_FAILURE
+ */
+int dnsasync_init(dnsasync* e, const struct sockaddr* server, socklen_t addrlen,
+                  int max_inflight, int timeout_ms, int retries);
+
+/* Start an A lookup for hostname, cb(arg, ...) is called on completion
+ * Returns DNSASYNC_QUEUED, DNSASYNC_BADNAME (cb is not called), or
+ * DNSASYNC_FULL if max_inflight lookups are already outstanding
+ */
+int dnsasync_submit(dnsasync* e, const char* hostname, dnsasync_callback cb, void* arg);
+
+/* Number of lookups currently in flight */
+int dnsasync_inflight(dnsasync* e);
+
+/* Wait up to wait_ms for answers (-1: until something happens), fire
+ * callbacks for completed and timed-out lookups, retransmit expired ones
+ * Returns the number of lookups completed, or -1 on error
+ */
+int dnsasync_run(dnsasync* e, int wait_ms);
+
+void dnsasync_cleanup(dnsasync* e);
+
+#endif
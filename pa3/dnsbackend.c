@@ -0,0 +1,588 @@
+/* dnsbackend.c
+ * Akira Youngblood, 2026-10-17
+ * Resolver backends for dnslookup()/dnslookup_all(): getaddrinfo(), raw UDP,
+ * an in-memory hosts/zone table and made-up answers
+ */
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "coro.h"      // coro_poll(), coro_sleep_ns(): parks a -k task instead
+#include "dnsasync.h"  // dnsasync_parse_server()
+#include "dnsbackend.h"
+#include "dnscache.h"  // dnscache_normalize()
+
+#define MAX_SPEC 1024
+#define MAX_TOKENS 32 // per hosts/zone file line
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Split "what,key=value,key=value" at the first comma: what is copied to
+// out, *options points at the rest ("" if none)
+static int split_spec(const char* spec, char* out, int size, const char** options) {
+    const char* comma = strchr(spec, ',');
+    size_t len = comma ? (size_t)(comma - spec) : strlen(spec);
+    if (len == 0 || len >= (size_t)size) return -1;
+    memcpy(out, spec, len);
+    out[len] = '\0';
+    *options = comma ? comma + 1 : "";
+    return 0;
+}
+
+// Next "key=value" from an option list, advancing *options
+// Returns 1 with key (size bytes) and *value set, 0 at the end, -1 if malformed
+static int next_option(const char** options, char* key, int size, double* value) {
+    const char* p = *options;
+    const char* eq;
+    char* end;
+    if (*p == '\0') return 0;
+    eq = strchr(p, '=');
+    if (eq == NULL || eq == p || eq - p >= size) return -1;
+    memcpy(key, p, eq - p);
+    key[eq - p] = '\0';
+    *value = strtod(eq + 1, &end);
+    if (end == eq + 1 || (*end != ',' && *end != '\0') || *value < 0) return -1;
+    *options = *end ? end + 1 : end;
+    return 1;
+}
+
+// udp: one blocking query at a time, straight to a nameserver
+
+typedef struct udp_state_s {
+    struct sockaddr_storage server;
+    socklen_t serverlen;
+    int timeout_ms;
+    int retries;
+    atomic_uint next_id;
+} udp_state;
+
+// Ask the server for hostname/qtype, retransmitting on timeouts
+// A fresh connected socket per query keeps threads apart, and the kernel
+// drops datagrams from anyone but the server
+// Returns DNS_SUCCESS with ans filled in, or DNS_FAILURE if no answer came
+static int udp_query(udp_state* u, const char* hostname, uint16_t qtype, dns_answer* ans) {
+    unsigned char packet[DNS_MAX_PACKET], reply[DNS_MAX_PACKET];
+    // Spread consecutive IDs over the whole range
+    uint16_t id = (uint16_t)(atomic_fetch_add(&u->next_id, 1) * 40503u);
+    int len = dns_build_query(packet, sizeof(packet), id, hostname, qtype);
+    int fd, tries, rv = DNS_FAILURE, refused = 0;
+    if (len == DNS_FAILURE) return DNS_FAILURE;
+    fd = socket(u->server.ss_family, SOCK_DGRAM, 0);
+    if (fd < 0) return DNS_FAILURE;
+    if (connect(fd, (struct sockaddr*)&u->server, u->serverlen)) {
+        close(fd);
+        return DNS_FAILURE;
+    }
+    for (tries = 0; tries <= u->retries && rv == DNS_FAILURE && !refused; ++tries) {
+        long long deadline = now_ms() + u->timeout_ms;
+        if (send(fd, packet, len, 0) != len) break;
+        for (;;) {
+            long long wait = deadline - now_ms();
+            uint16_t rid;
+            int n;
+            if (wait <= 0) break;
+            n = coro_poll(fd, POLLIN, (int)wait);
+            if (n < 0) break;
+            if (n == 0) continue; // timed out (or EINTR), see wait
+            n = recv(fd, reply, sizeof(reply), 0);
+            if (n < 0) {
+                // Nobody listening (ICMP port unreachable): no point retrying
+                refused = (errno == ECONNREFUSED);
+                break;
+            }
+            if (dns_packet_id(reply, n, &rid) == DNS_SUCCESS && rid == id &&
+                dns_parse_response(reply, n, hostname, qtype, ans) == DNS_SUCCESS) {
+                rv = DNS_SUCCESS;
+                break;
+            }
+        }
+    }
+    close(fd);
+    return rv;
+}
+
+// Query one record type and format its first address
+// Returns 1 with an address, 0 if the name has none of this type, -1 if
+// the name doesn't exist or the server didn't answer
+static int udp_address(udp_state* u, const char* hostname, uint16_t qtype, dnsaddr* addr) {
+    dns_answer ans;
+    if (udp_query(u, hostname, qtype, &ans) == DNS_FAILURE) return -1;
+    if (ans.rcode != DNS_RCODE_NOERROR) return -1;
+    if (ans.family == 0) return 0;
+    addr->family = ans.family;
+    if (!inet_ntop(ans.family, ans.addr, addr->str, sizeof(addr->str))) return -1;
+    return 1;
+}
+
+// The first address: A, or AAAA if the name has no A record
+static int udp_lookup(void* state, const char* hostname, char* firstIPstr, int maxSize) {
+    dnsaddr addr;
+    int rv = udp_address(state, hostname, DNS_TYPE_A, &addr);
+    if (rv == 0) rv = udp_address(state, hostname, DNS_TYPE_AAAA, &addr);
+    if (rv <= 0) return UTIL_FAILURE;
+    strncpy(firstIPstr, addr.str, maxSize);
+    firstIPstr[maxSize-1] = '\0';
+    return UTIL_SUCCESS;
+}
+
+// The first A and the first AAAA record (dnsproto.c keeps one per answer)
+static int udp_lookup_all(void* state, const char* hostname, dnsaddr* addrs, int maxAddrs, int* count) {
+    int rv;
+    *count = 0;
+    if (maxAddrs <= 0) return UTIL_FAILURE;
+    rv = udp_address(state, hostname, DNS_TYPE_A, &addrs[0]);
+    if (rv < 0) return UTIL_FAILURE;
+    *count += rv;
+    if (*count < maxAddrs && udp_address(state, hostname, DNS_TYPE_AAAA, &addrs[*count]) > 0) {
+        (*count)++;
+    }
+    return *count > 0 ? UTIL_SUCCESS : UTIL_FAILURE;
+}
+
+static int udp_open(dnsbackend* b, const char* spec) {
+    char server[MAX_SPEC], key[32];
+    const char* options;
+    double value;
+    int rv;
+    udp_state* u = calloc(1, sizeof(udp_state));
+    if (u == NULL) return -1;
+    u->timeout_ms = DNSBACKEND_UDP_TIMEOUT_MS;
+    u->retries = DNSBACKEND_UDP_RETRIES;
+    atomic_init(&u->next_id, (unsigned)getpid());
+    if (split_spec(spec, server, sizeof(server), &options) ||
+        dnsasync_parse_server(server, &u->server, &u->serverlen) == DNS_FAILURE) {
+        free(u);
+        return -1;
+    }
+    while ((rv = next_option(&options, key, sizeof(key), &value)) > 0) {
+        if (strcmp(key, "timeout") == 0 && value >= 1) {
+            u->timeout_ms = (int)value;
+        } else if (strcmp(key, "retries") == 0) {
+            u->retries = (int)value;
+        } else {
+            rv = -1;
+            break;
+        }
+    }
+    if (rv < 0) {
+        fprintf(stderr, "Bad udp backend option in %s\n", spec);
+        free(u);
+        return -1;
+    }
+    b->name = "udp";
+    b->lookup = udp_lookup;
+    b->lookup_all = udp_lookup_all;
+    b->cleanup = free;
+    b->state = u;
+    return 0;
+}
+
+// Synthetic behaviour shared by hosts: and synth:, worked out from a hash
+// of each name
+
+typedef struct sim_params_s {
+    double latency_ms;
+    double jitter_ms;      // spread evenly around the latency
+    double tail_pct;       // share of lookups that take tail_ms instead
+    double tail_ms;
+    double fail_pct;
+    uint64_t seed;
+} sim_params;
+
+// splitmix64 finalizer: turns a name hash and the seed into well spread bits
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// Take key=value if it is one of the shared options
+// Returns 1 if it was, 0 if not (or out of range)
+static int sim_option(sim_params* s, const char* key, double value) {
+    if (strcmp(key, "latency") == 0) {
+        s->latency_ms = value;
+    } else if (strcmp(key, "jitter") == 0) {
+        s->jitter_ms = value;
+    } else if (strcmp(key, "tail") == 0 && value <= 100) {
+        s->tail_pct = value;
+    } else if (strcmp(key, "tail_latency") == 0) {
+        s->tail_ms = value;
+    } else if (strcmp(key, "fail") == 0 && value <= 100) {
+        s->fail_pct = value;
+    } else if (strcmp(key, "seed") == 0) {
+        s->seed = (uint64_t)value;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+// Sleep for the name's synthetic latency and decide whether it fails, both
+// from the name alone so every run behaves the same
+// Returns 0, or -1 if the lookup fails
+static int sim_lookup(const sim_params* s, uint64_t hash) {
+    uint64_t r = mix(hash ^ s->seed);
+    double ms = s->latency_ms;
+    // Tail lookups from bits of their own, apart from spread and failure
+    if (s->tail_pct > 0 && mix(r) % 10000 < s->tail_pct * 100) ms = s->tail_ms;
+    if (ms > 0 || s->jitter_ms > 0) {
+        // Uniform in latency +- jitter, in microseconds
+        double spread = ((double)(r >> 11 & 0xFFFF) / 0xFFFF) * 2 - 1;
+        double us = (ms + s->jitter_ms * spread) * 1000;
+        if (us > 0) coro_sleep_ns((uint64_t)(us * 1000));
+    }
+    if (s->fail_pct > 0 && (r >> 32) % 10000 < s->fail_pct * 100) return -1;
+    return 0;
+}
+
+// hosts: a read-only table in memory, with synthetic latency
+
+typedef struct hosts_entry_s {
+    uint64_t hash;
+    char* name;
+    dnsaddr* addrs;
+    int count;
+    struct hosts_entry_s* next;
+} hosts_entry;
+
+typedef struct hosts_state_s {
+    hosts_entry** buckets;
+    int mask;
+    int names;
+    int addrs;
+    sim_params sim;
+} hosts_state;
+
+static hosts_entry* hosts_find(hosts_state* h, uint64_t hash, const char* name) {
+    hosts_entry* e;
+    for (e = h->buckets[hash & h->mask]; e; e = e->next) {
+        if (e->hash == hash && strcmp(e->name, name) == 0) return e;
+    }
+    return NULL;
+}
+
+// Double the buckets once there are more names than buckets
+static int hosts_grow(hosts_state* h) {
+    int i, newmask = h->mask * 2 + 1;
+    hosts_entry** buckets = calloc(newmask + 1, sizeof(hosts_entry*));
+    if (buckets == NULL) return -1;
+    for (i = 0; i <= h->mask; ++i) {
+        hosts_entry* e = h->buckets[i];
+        while (e) {
+            hosts_entry* next = e->next;
+            e->next = buckets[e->hash & newmask];
+            buckets[e->hash & newmask] = e;
+            e = next;
+        }
+    }
+    free(h->buckets);
+    h->buckets = buckets;
+    h->mask = newmask;
+    return 0;
+}
+
+// Add an address for a name, once; past UTIL_MAX_ADDRS they are dropped
+static int hosts_add(hosts_state* h, const char* hostname, int family, const char* addrstr) {
+    char name[DNS_MAX_NAME + 2];
+    unsigned char bin[16];
+    uint64_t hash;
+    hosts_entry* e;
+    int i;
+    if (strlen(hostname) > DNS_MAX_NAME + 1 || inet_pton(family, addrstr, bin) != 1) return 0;
+    hash = dnscache_normalize(hostname, name, sizeof(name));
+    if ((e = hosts_find(h, hash, name)) == NULL) {
+        if (h->names > h->mask && hosts_grow(h)) return -1;
+        e = calloc(1, sizeof(hosts_entry));
+        if (e == NULL || (e->name = strdup(name)) == NULL) {
+            free(e);
+            return -1;
+        }
+        e->hash = hash;
+        e->next = h->buckets[hash & h->mask];
+        h->buckets[hash & h->mask] = e;
+        h->names++;
+    }
+    if (e->count == UTIL_MAX_ADDRS) return 0;
+    // Always the same text for the same address, however it was written
+    dnsaddr a;
+    a.family = family;
+    inet_ntop(family, bin, a.str, sizeof(a.str));
+    for (i = 0; i < e->count; ++i) {
+        if (strcmp(e->addrs[i].str, a.str) == 0) return 0;
+    }
+    // Most names have one or two addresses, grow one at a time
+    dnsaddr* addrs = realloc(e->addrs, sizeof(dnsaddr) * (e->count + 1));
+    if (addrs == NULL) return -1;
+    e->addrs = addrs;
+    e->addrs[e->count++] = a;
+    h->addrs++;
+    return 0;
+}
+
+// Family of an address literal, 0 if it isn't one
+static int address_family(const char* s) {
+    unsigned char bin[16];
+    if (inet_pton(AF_INET, s, bin) == 1) return AF_INET;
+    if (inet_pton(AF_INET6, s, bin) == 1) return AF_INET6;
+    return 0;
+}
+
+// A zone file owner name made absolute: "@" is the origin, names without a
+// trailing dot are relative to it
+static void zone_name(const char* owner, const char* origin, char* out, int size) {
+    size_t len = strlen(owner);
+    if (strcmp(owner, "@") == 0) {
+        snprintf(out, size, "%s", origin);
+    } else if (len > 0 && owner[len-1] == '.') {
+        snprintf(out, size, "%.*s", (int)len - 1, owner);
+    } else if (*origin) {
+        snprintf(out, size, "%s.%s", owner, origin);
+    } else {
+        snprintf(out, size, "%s", owner);
+    }
+}
+
+// Load a hosts file or a zone file, telling lines apart by their first
+// field (an address starts a hosts line). Only A and AAAA records are kept;
+// parenthesized records (SOA) are skipped.
+static int hosts_load(hosts_state* h, const char* path) {
+    char line[4096], origin[DNS_MAX_NAME + 2] = "", owner[DNS_MAX_NAME + 2] = "";
+    char* tok[MAX_TOKENS];
+    int ntok, i, inparen = 0, rv = 0;
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL) {
+        perror("Error opening hosts file");
+        return -1;
+    }
+    while (rv == 0 && fgets(line, sizeof(line), fp)) {
+        int continued = isspace((unsigned char)line[0]);
+        char* save = NULL;
+        line[strcspn(line, "#;\r\n")] = '\0';
+        for (ntok = 0; ntok < MAX_TOKENS; ++ntok) {
+            if ((tok[ntok] = strtok_r(ntok ? NULL : line, " \t", &save)) == NULL) break;
+        }
+        if (inparen) {
+            for (i = 0; i < ntok; ++i) if (strchr(tok[i], ')')) inparen = 0;
+            continue;
+        }
+        if (ntok == 0) continue;
+        if (tok[0][0] == '$') {
+            if (strcasecmp(tok[0], "$ORIGIN") == 0 && ntok > 1) zone_name(tok[1], "", origin, sizeof(origin));
+            continue;
+        }
+        int family = address_family(tok[0]);
+        if (family && !continued) {
+            // hosts: addr name alias...
+            for (i = 1; i < ntok && rv == 0; ++i) rv = hosts_add(h, tok[i], family, tok[0]);
+            continue;
+        }
+        // zone: [owner] [ttl] [class] type rdata (a blank owner repeats the last)
+        i = 0;
+        if (!continued) zone_name(tok[i++], origin, owner, sizeof(owner));
+        while (i < ntok && (isdigit((unsigned char)tok[i][0]) || strcasecmp(tok[i], "IN") == 0)) i++;
+        for (int j = i; j < ntok; ++j) {
+            if (strchr(tok[j], '(')) inparen = 1;
+            if (strchr(tok[j], ')')) inparen = 0;
+        }
+        if (inparen || i + 1 >= ntok || owner[0] == '\0') continue;
+        if (strcasecmp(tok[i], "A") == 0) {
+            rv = hosts_add(h, owner, AF_INET, tok[i+1]);
+        } else if (strcasecmp(tok[i], "AAAA") == 0) {
+            rv = hosts_add(h, owner, AF_INET6, tok[i+1]);
+        }
+    }
+    fclose(fp);
+    if (rv) fprintf(stderr, "Out of memory loading %s\n", path);
+    return rv;
+}
+
+// Returns the entry to answer from, or NULL if the lookup fails
+static hosts_entry* hosts_resolve(hosts_state* h, const char* hostname) {
+    char name[DNS_MAX_NAME + 2];
+    uint64_t hash = dnscache_normalize(hostname, name, sizeof(name));
+    if (sim_lookup(&h->sim, hash)) return NULL;
+    return hosts_find(h, hash, name);
+}
+
+static int hosts_lookup(void* state, const char* hostname, char* firstIPstr, int maxSize) {
+    hosts_entry* e = hosts_resolve(state, hostname);
+    if (e == NULL || e->count == 0) return UTIL_FAILURE;
+    strncpy(firstIPstr, e->addrs[0].str, maxSize);
+    firstIPstr[maxSize-1] = '\0';
+    return UTIL_SUCCESS;
+}
+
+static int hosts_lookup_all(void* state, const char* hostname, dnsaddr* addrs, int maxAddrs, int* count) {
+    hosts_entry* e = hosts_resolve(state, hostname);
+    *count = 0;
+    if (e == NULL || e->count == 0) return UTIL_FAILURE;
+    *count = e->count < maxAddrs ? e->count : maxAddrs;
+    memcpy(addrs, e->addrs, sizeof(dnsaddr) * *count);
+    return *count > 0 ? UTIL_SUCCESS : UTIL_FAILURE;
+}
+
+static void hosts_cleanup(void* state) {
+    hosts_state* h = state;
+    int i;
+    for (i = 0; i <= h->mask; ++i) {
+        hosts_entry* e = h->buckets[i];
+        while (e) {
+            hosts_entry* next = e->next;
+            free(e->name);
+            free(e->addrs);
+            free(e);
+            e = next;
+        }
+    }
+    free(h->buckets);
+    free(h);
+}
+
+static int hosts_open(dnsbackend* b, const char* spec) {
+    char path[MAX_SPEC], key[32];
+    const char* options;
+    double value;
+    int rv;
+    hosts_state* h = calloc(1, sizeof(hosts_state));
+    if (h == NULL) return -1;
+    h->mask = 1023;
+    if ((h->buckets = calloc(h->mask + 1, sizeof(hosts_entry*))) == NULL) {
+        free(h);
+        return -1;
+    }
+    if (split_spec(spec, path, sizeof(path), &options)) {
+        hosts_cleanup(h);
+        return -1;
+    }
+    while ((rv = next_option(&options, key, sizeof(key), &value)) > 0) {
+        if (!sim_option(&h->sim, key, value)) {
+            rv = -1;
+            break;
+        }
+    }
+    if (rv < 0) {
+        fprintf(stderr, "Bad hosts backend option in %s\n", spec);
+        hosts_cleanup(h);
+        return -1;
+    }
+    if (hosts_load(h, path)) {
+        hosts_cleanup(h);
+        return -1;
+    }
+    fprintf(stderr, "Loaded %d names (%d addresses) from %s\n", h->names, h->addrs, path);
+    b->name = "hosts";
+    b->lookup = hosts_lookup;
+    b->lookup_all = hosts_lookup_all;
+    b->cleanup = hosts_cleanup;
+    b->state = h;
+    return 0;
+}
+
+// synth: no table at all, every name resolves to addresses made from its hash
+
+typedef struct synth_state_s {
+    sim_params sim;
+} synth_state;
+
+// 10.x.y.z and fd00::/8 with the rest of the bits, from the name alone (not
+// the seed), so a name keeps its addresses across runs. Names the cache
+// would treat as the same get the same ones.
+// Returns the addresses written to addrs (at most 2), 0 if the lookup fails
+static int synth_resolve(synth_state* s, const char* hostname, dnsaddr* addrs, int maxAddrs) {
+    char name[DNS_MAX_NAME + 2];
+    uint64_t hash = dnscache_normalize(hostname, name, sizeof(name));
+    uint64_t a = mix(hash);
+    unsigned char v6[16];
+    int i;
+    if (sim_lookup(&s->sim, hash)) return 0;
+    if (maxAddrs < 1) return 0;
+    addrs[0].family = AF_INET;
+    snprintf(addrs[0].str, sizeof(addrs[0].str), "10.%u.%u.%u",
+             (unsigned)(a >> 16 & 0xFF), (unsigned)(a >> 8 & 0xFF), (unsigned)(a & 0xFF));
+    if (maxAddrs < 2) return 1;
+    v6[0] = 0xfd;
+    for (i = 1; i < 8; ++i) v6[i] = (unsigned char)(a >> (8 * i));
+    a = mix(a);
+    for (i = 8; i < 16; ++i) v6[i] = (unsigned char)(a >> (8 * (i - 8)));
+    addrs[1].family = AF_INET6;
+    inet_ntop(AF_INET6, v6, addrs[1].str, sizeof(addrs[1].str));
+    return 2;
+}
+
+static int synth_lookup(void* state, const char* hostname, char* firstIPstr, int maxSize) {
+    dnsaddr addr;
+    if (synth_resolve(state, hostname, &addr, 1) == 0) return UTIL_FAILURE;
+    strncpy(firstIPstr, addr.str, maxSize);
+    firstIPstr[maxSize-1] = '\0';
+    return UTIL_SUCCESS;
+}
+
+static int synth_lookup_all(void* state, const char* hostname, dnsaddr* addrs, int maxAddrs, int* count) {
+    *count = synth_resolve(state, hostname, addrs, maxAddrs);
+    return *count > 0 ? UTIL_SUCCESS : UTIL_FAILURE;
+}
+
+static void synth_cleanup(void* state) {
+    free(state);
+}
+
+static int synth_open(dnsbackend* b, const char* spec) {
+    const char* options = spec;
+    char key[32];
+    double value;
+    int rv;
+    synth_state* s = calloc(1, sizeof(synth_state));
+    if (s == NULL) return -1;
+    while ((rv = next_option(&options, key, sizeof(key), &value)) > 0) {
+        if (!sim_option(&s->sim, key, value)) {
+            rv = -1;
+            break;
+        }
+    }
+    if (rv < 0) {
+        fprintf(stderr, "Bad synth backend option in %s\n", spec);
+        free(s);
+        return -1;
+    }
+    b->name = "synth";
+    b->lookup = synth_lookup;
+    b->lookup_all = synth_lookup_all;
+    b->cleanup = synth_cleanup;
+    b->state = s;
+    return 0;
+}
+
+int dnsbackend_open(dnsbackend* b, const char* spec) {
+    memset(b, 0, sizeof(*b));
+    if (strcmp(spec, "getaddrinfo") == 0) {
+        b->name = "getaddrinfo";
+        return 0;
+    }
+    if (strncmp(spec, "udp:", 4) == 0) return udp_open(b, spec + 4);
+    if (strncmp(spec, "hosts:", 6) == 0) return hosts_open(b, spec + 6);
+    if (strcmp(spec, "synth") == 0) return synth_open(b, "");
+    if (strncmp(spec, "synth:", 6) == 0) return synth_open(b, spec + 6);
+    fprintf(stderr, "Unknown resolver backend: %s\n", spec);
+    return -1;
+}
+
+void dnsbackend_close(dnsbackend* b) {
+    if (b->cleanup) b->cleanup(b->state);
+    memset(b, 0, sizeof(*b));
+}
@@ -0,0 +1,51 @@
+/* dnsbackend.h
+ * Akira Youngblood, 2026-10-17
+ * Resolver backends for dnslookup()/dnslookup_all() (see util.h)
+ *
+ * A backend is picked from a spec string (multi-lookup's -r):
+ *
+ *   getaddrinfo              the system resolver (the default)
+ *   udp:server[:port]        blocking raw UDP queries straight to one
+ *                            nameserver, server as for -a ("system" works)
+ *   hosts:file[,options]     an in-memory table loaded from a hosts-style
+ *                            file ("addr name alias...") or a zone file
+ *                            ("name [ttl] [IN] A|AAAA addr", with $ORIGIN),
+ *                            no network at all
+ *   synth[:options]          no table either: every name resolves to an
+ *                            IPv4 address in 10/8 and an IPv6 one in fd00::/8
+ *                            made from a hash of the name, so what is left
+ *                            to time is the rest of the program
+ *
+ * Options for udp: timeout=ms per try, retries=n.
+ * Options for hosts and synth: latency=ms to sleep per lookup, jitter=ms
+ * spread around it, tail=percent of lookups that take tail_latency=ms
+ * instead (a slow upstream now and then), fail=percent of names that fail
+ * as if the server did, and seed=n to change which names fail and how long
+ * each one takes. All of it is worked out from a hash of the name, so a run
+ * is the same every time no matter how threads interleave: good for timing
+ * the threading layer without a network.
+ *
+ * udp:, hosts: and synth wait through coro_poll() and coro_sleep_ns(), so a
+ * lookup made by one of multi-lookup's -k tasks parks that task rather than
+ * its thread. getaddrinfo can't be waited on like that.
+ */
+
+#ifndef DNSBACKEND_H
+#define DNSBACKEND_H
+
+#include <stdint.h>
+
+#include "util.h"
+
+#define DNSBACKEND_UDP_TIMEOUT_MS 1000
+#define DNSBACKEND_UDP_RETRIES 2
+
+/* Set up the backend described by spec into b
+ * Returns 0 on success, -1 on a bad spec or unreadable file (reported on
+ * stderr)
+ */
+int dnsbackend_open(dnsbackend* b, const char* spec);
+
+void dnsbackend_close(dnsbackend* b);
+
+#endif
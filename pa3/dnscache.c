@@ -0,0 +1,288 @@
+/* dnscache.c
+ * Akira Youngblood, 2026-10-17
+ * In-process DNS result cache for multi-lookup
+ */
+
+#include <ctype.h>
+#include <limits.h>
+#include <time.h>
+
+#include "coro.h"
+#include "dnscache.h"
+
+#define INITIAL_BUCKETS 64 // per shard, power of two
+#define PENDING_POLL_NS 1000000 // -k tasks check on a pending lookup this often
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+uint64_t dnscache_normalize(const char* hostname, char* out, int size) {
+    uint64_t h = 14695981039346656037ULL;
+    int n = 0;
+    for (; *hostname && n < size - 1; ++hostname) {
+        out[n] = (char)tolower((unsigned char)*hostname);
+        n++;
+    }
+    if (n > 0 && out[n-1] == '.') n--;
+    out[n] = '\0';
+    for (int i = 0; i < n; ++i) {
+        h ^= (unsigned char)out[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static dnscache_shard* shard_for(dnscache* c, uint64_t hash) {
+    return &c->shards[hash & (DNSCACHE_SHARDS - 1)];
+}
+
+// Bucket index uses the bits above the ones that picked the shard
+static int bucket_for(dnscache_shard* s, uint64_t hash) {
+    return (int)((hash >> 6) & s->mask);
+}
+
+static dnscache_entry* find(dnscache_shard* s, uint64_t hash, const char* name) {
+    dnscache_entry* e;
+    for (e = s->buckets[bucket_for(s, hash)]; e; e = e->next) {
+        if (e->hash == hash && strcmp(e->name, name) == 0) return e;
+    }
+    return NULL;
+}
+
+// Double the bucket array once the shard averages more than one entry per
+// bucket. Called with the shard locked; on malloc failure just stay small.
+static void grow(dnscache_shard* s) {
+    int i, newmask = s->mask * 2 + 1;
+    dnscache_entry** buckets = calloc(newmask + 1, sizeof(dnscache_entry*));
+    if (!buckets) return;
+    for (i = 0; i <= s->mask; ++i) {
+        dnscache_entry* e = s->buckets[i];
+        while (e) {
+            dnscache_entry* next = e->next;
+            int b = (int)((e->hash >> 6) & newmask);
+            e->next = buckets[b];
+            buckets[b] = e;
+            e = next;
+        }
+    }
+    free(s->buckets);
+    s->buckets = buckets;
+    s->mask = newmask;
+}
+
+// Make room for one more entry in a full shard: advance the hand over the
+// buckets, giving entries that were hit since the last pass a second chance,
+// and drop the first one that wasn't. Pending entries have threads waiting
+// on them and are skipped. Called with the shard locked.
+static int evict(dnscache_shard* s) {
+    int steps;
+    // Two full turns: the first may only clear used bits
+    for (steps = 0; steps <= 2 * s->mask + 1; ++steps) {
+        dnscache_entry** p = &s->buckets[s->hand];
+        for (; *p; p = &(*p)->next) {
+            dnscache_entry* e = *p;
+            if (e->state == DNSCACHE_PENDING) continue;
+            if (e->used) {
+                e->used = 0;
+                continue;
+            }
+            *p = e->next;
+            s->count--;
+            free(e->name);
+            free(e->longaddr);
+            free(e);
+            return 1;
+        }
+        s->hand = (s->hand + 1) & s->mask;
+    }
+    return 0;
+}
+
+static dnscache_entry* insert(dnscache_shard* s, uint64_t hash, const char* name) {
+    dnscache_entry* e = malloc(sizeof(dnscache_entry));
+    if (!e) return NULL;
+    e->name = strdup(name);
+    if (!e->name) {
+        free(e);
+        return NULL;
+    }
+    if (s->count > s->mask) grow(s);
+    e->hash = hash;
+    e->addr[0] = '\0';
+    e->longaddr = NULL;
+    e->state = DNSCACHE_PENDING;
+    e->used = 0;
+    e->expires = 0;
+    int b = bucket_for(s, hash);
+    e->next = s->buckets[b];
+    s->buckets[b] = e;
+    s->count++;
+    return e;
+}
+
+static int result_of(dnscache_entry* e, char* ipstr, int size) {
+    if (e->state == DNSCACHE_HIT) {
+        strncpy(ipstr, e->longaddr ? e->longaddr : e->addr, size);
+        ipstr[size-1] = '\0';
+    }
+    return e->state;
+}
+
+int dnscache_init(dnscache* c, int ttl, int negative_ttl) {
+    int i;
+    c->ttl = ttl;
+    c->negative_ttl = negative_ttl;
+    c->shard_max = 0;
+    atomic_init(&c->hits, 0);
+    atomic_init(&c->misses, 0);
+    atomic_init(&c->coalesced, 0);
+    atomic_init(&c->evictions, 0);
+    for (i = 0; i < DNSCACHE_SHARDS; ++i) {
+        dnscache_shard* s = &c->shards[i];
+        s->buckets = calloc(INITIAL_BUCKETS, sizeof(dnscache_entry*));
+        s->mask = INITIAL_BUCKETS - 1;
+        s->count = 0;
+        s->hand = 0;
+        if (!s->buckets || pthread_mutex_init(&s->lock, NULL) || pthread_cond_init(&s->ready, NULL)) {
+            perror("Error initializing DNS cache");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void dnscache_limit(dnscache* c, long max_entries) {
+    long per_shard = (max_entries + DNSCACHE_SHARDS - 1) / DNSCACHE_SHARDS;
+    c->shard_max = max_entries <= 0 ? 0 : per_shard > INT_MAX ? INT_MAX : (int)per_shard;
+}
+
+int dnscache_begin(dnscache* c, const char* hostname, char* ipstr, int size, int wait) {
+    char name[1025];
+    int waited = 0;
+    uint64_t hash = dnscache_normalize(hostname, name, sizeof(name));
+    dnscache_shard* s = shard_for(c, hash);
+
+    pthread_mutex_lock(&s->lock);
+    dnscache_entry* e = find(s, hash, name);
+    while (e && e->state == DNSCACHE_PENDING) {
+        if (!waited) atomic_fetch_add(&c->coalesced, 1);
+        if (!wait) {
+            pthread_mutex_unlock(&s->lock);
+            return DNSCACHE_PENDING;
+        }
+        waited = 1;
+        pthread_cond_wait(&s->ready, &s->lock);
+        // Once completed the entry can be evicted before we get the lock
+        // back, so look it up again rather than trust e
+        e = find(s, hash, name);
+    }
+    // A result we waited for is used even if its TTL is already up
+    if (e && (waited || e->expires > now_ms())) {
+        if (!waited) atomic_fetch_add(&c->hits, 1);
+        e->used = 1;
+        int rv = result_of(e, ipstr, size);
+        pthread_mutex_unlock(&s->lock);
+        return rv;
+    }
+    // Missing or expired: the caller resolves it
+    atomic_fetch_add(&c->misses, 1);
+    if (!e && c->shard_max && s->count >= c->shard_max && evict(s)) {
+        atomic_fetch_add(&c->evictions, 1);
+    }
+    if (!e) e = insert(s, hash, name);
+    if (e) e->state = DNSCACHE_PENDING;
+    pthread_mutex_unlock(&s->lock);
+    return DNSCACHE_MISS;
+}
+
+int dnscache_peek(dnscache* c, const char* hostname, char* ipstr, int size) {
+    char name[1025];
+    int rv = DNSCACHE_MISS;
+    uint64_t hash = dnscache_normalize(hostname, name, sizeof(name));
+    dnscache_shard* s = shard_for(c, hash);
+
+    pthread_mutex_lock(&s->lock);
+    dnscache_entry* e = find(s, hash, name);
+    if (e && (e->state == DNSCACHE_PENDING || e->expires > now_ms())) {
+        rv = result_of(e, ipstr, size);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return rv;
+}
+
+void dnscache_complete(dnscache* c, const char* hostname, int success, const char* ipstr, uint32_t ttl) {
+    char name[1025];
+    uint64_t hash = dnscache_normalize(hostname, name, sizeof(name));
+    dnscache_shard* s = shard_for(c, hash);
+
+    pthread_mutex_lock(&s->lock);
+    dnscache_entry* e = find(s, hash, name);
+    if (e) {
+        if (success) {
+            e->state = DNSCACHE_HIT;
+            strncpy(e->addr, ipstr, sizeof(e->addr));
+            e->addr[sizeof(e->addr)-1] = '\0';
+            free(e->longaddr);
+            e->longaddr = NULL;
+            if (strlen(ipstr) >= sizeof(e->addr)) {
+                // Doesn't fit inline, keep all of it on the heap. If that
+                // fails, keep the addresses that fit whole.
+                e->longaddr = strdup(ipstr);
+                char* comma = strrchr(e->addr, ',');
+                if (!e->longaddr && comma) *comma = '\0';
+            }
+            e->expires = now_ms() + 1000LL * (ttl ? (long long)ttl : c->ttl);
+        } else {
+            e->state = DNSCACHE_NEGATIVE;
+            e->expires = now_ms() + 1000LL * c->negative_ttl;
+        }
+        pthread_cond_broadcast(&s->ready);
+    }
+    pthread_mutex_unlock(&s->lock);
+}
+
+int dnscache_lookup(dnscache* c, const char* hostname, char* ipstr, int size, dnscache_resolver fn) {
+    uint32_t ttl = 0;
+    // A coroutine can't sleep on the shard's condition variable: the
+    // lookup it waits for may belong to another task on the same thread.
+    // It parks and looks again instead.
+    int status = dnscache_begin(c, hostname, ipstr, size, !coro_active());
+    while (status == DNSCACHE_PENDING) {
+        coro_sleep_ns(PENDING_POLL_NS);
+        status = dnscache_peek(c, hostname, ipstr, size);
+        // Gone again already (TTL 0, evicted): claim it
+        if (status == DNSCACHE_MISS) status = dnscache_begin(c, hostname, ipstr, size, 0);
+    }
+    switch (status) {
+        case DNSCACHE_HIT:
+            return UTIL_SUCCESS;
+        case DNSCACHE_NEGATIVE:
+            return UTIL_FAILURE;
+    }
+    int rv = fn(hostname, ipstr, size, &ttl);
+    dnscache_complete(c, hostname, rv == UTIL_SUCCESS, ipstr, ttl);
+    return rv;
+}
+
+void dnscache_cleanup(dnscache* c) {
+    int i, b;
+    for (i = 0; i < DNSCACHE_SHARDS; ++i) {
+        dnscache_shard* s = &c->shards[i];
+        for (b = 0; b <= s->mask; ++b) {
+            dnscache_entry* e = s->buckets[b];
+            while (e) {
+                dnscache_entry* next = e->next;
+                free(e->name);
+                free(e->longaddr);
+                free(e);
+                e = next;
+            }
+        }
+        free(s->buckets);
+        pthread_mutex_destroy(&s->lock);
+        pthread_cond_destroy(&s->ready);
+    }
+}
@@ -0,0 +1,107 @@
+/* dnscache.h
+ * Akira Youngblood, 2026-10-17
+ * In-process DNS result cache for multi-lookup
+ *
+ * Sharded hash table keyed by the normalized hostname (lowercase, no
+ * trailing dot). Each entry holds the first address (or with -A, the whole
+ * comma-separated address list) and an expiry time;
+ * failed lookups are cached too (negative entries) with their own TTL.
+ * While one thread is resolving a name the entry is PENDING, and other
+ * threads asking for the same name wait for that answer instead of sending
+ * their own query (coalescing). Expired entries are refreshed in place.
+ * By default entries are never evicted, so memory grows with the number of
+ * unique names; dnscache_limit() caps it, evicting with the CLOCK
+ * algorithm (an entry that was hit since the hand last passed it gets a
+ * second chance).
+ */
+
+#ifndef DNSCACHE_H
+#define DNSCACHE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "util.h"
+
+#define DNSCACHE_SHARDS 64 // power of two
+
+// dnscache_begin()/dnscache_peek() results
+#define DNSCACHE_MISS 0     // caller now owns the lookup, must dnscache_complete()
+#define DNSCACHE_HIT 1      // ipstr filled in
+#define DNSCACHE_NEGATIVE 2 // cached failure
+#define DNSCACHE_PENDING 3  // someone else is resolving it (non-waiting calls only)
+
+/* Resolver used by dnscache_lookup()
+ * Fills ipstr and sets *ttl (0: use the cache's default TTL)
+ * Returns UTIL_SUCCESS or UTIL_FAILURE, like dnslookup()
+ */
+typedef int (*dnscache_resolver)(const char* hostname, char* ipstr, int size, uint32_t* ttl);
+
+typedef struct dnscache_entry_s {
+    uint64_t hash;
+    char* name;
+    char addr[INET6_ADDRSTRLEN]; // results that fit, i.e. a single address
+    char* longaddr;              // longer ones (address lists) on the heap
+    int state;
+    int used;          // hit since the eviction hand last passed
+    long long expires; // ms, CLOCK_MONOTONIC
+    struct dnscache_entry_s* next;
+} dnscache_entry;
+
+typedef struct dnscache_shard_s {
+    pthread_mutex_t lock;
+    pthread_cond_t ready; // broadcast whenever a pending entry completes
+    dnscache_entry** buckets;
+    int mask;
+    int count;
+    int hand; // bucket the eviction hand points at
+} dnscache_shard;
+
+typedef struct dnscache_s {
+    dnscache_shard shards[DNSCACHE_SHARDS];
+    int ttl;           // seconds, for answers that don't carry one
+    int negative_ttl;  // seconds, for failed lookups
+    int shard_max;     // entries per shard, 0: unlimited
+    atomic_ulong hits;
+    atomic_ulong misses;
+    atomic_ulong coalesced;
+    atomic_ulong evictions;
+} dnscache;
+
+/* Lowercase hostname and drop a trailing dot into out, so "Google.com." and
+ * "google.com" share an entry
+ * Returns the 64-bit FNV-1a hash of the normalized name
+ */
+uint64_t dnscache_normalize(const char* hostname, char* out, int size);
+
+/* Returns 0 on success, -1 on failure */
+int dnscache_init(dnscache* c, int ttl, int negative_ttl);
+
+/* Keep at most about max_entries names (0: no limit), evicting to make
+ * room for new ones. Call before any lookups.
+ */
+void dnscache_limit(dnscache* c, long max_entries);
+
+/* Cached dnslookup(): answer from the cache, wait for a pending lookup of the
+ * same name (a coroutine, coro.h, parks and polls for it), or resolve with
+ * fn and cache the result
+ * Returns UTIL_SUCCESS or UTIL_FAILURE
+ */
+int dnscache_lookup(dnscache* c, const char* hostname, char* ipstr, int size, dnscache_resolver fn);
+
+/* Lower-level calls for resolvers that can't block (the async resolver)
+ * dnscache_begin() counts a hit, miss or coalesced lookup, and on a miss
+ * marks the name PENDING, owned by the caller. With wait set it sleeps
+ * through PENDING, otherwise it returns DNSCACHE_PENDING.
+ * dnscache_peek() only looks (no counters, no claiming).
+ * dnscache_complete() stores the owner's result and wakes waiters; ttl 0
+ * means the default TTL.
+ */
+int dnscache_begin(dnscache* c, const char* hostname, char* ipstr, int size, int wait);
+int dnscache_peek(dnscache* c, const char* hostname, char* ipstr, int size);
+void dnscache_complete(dnscache* c, const char* hostname, int success, const char* ipstr, uint32_t ttl);
+
+void dnscache_cleanup(dnscache* c);
+
+#endif
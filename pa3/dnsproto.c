@@ -0,0 +1,157 @@
+/* dnsproto.c
+ * Akira Youngblood, 2026-10-17
+ * Minimal DNS wire format helpers (RFC 1035)
+ */
+
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+
+#include "dnsproto.h"
+
+static uint16_t get16(const unsigned char* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t get32(const unsigned char* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void put16(unsigned char* p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v & 0xFF;
+}
+
+// Decode a (possibly compressed) name starting at off into out
+// Returns the offset just past the name as it appears at off, or -1
+static int read_name(const unsigned char* buf, int len, int off, char* out, int size) {
+    int end = -1, hops = 0, n = 0;
+    for (;;) {
+        if (off >= len) return -1;
+        int label = buf[off];
+        if (label == 0) {
+            off++;
+            break;
+        }
+        if ((label & 0xC0) == 0xC0) {
+            // Compression pointer, only the first one decides where we end
+            if (off + 1 >= len || ++hops > 16) return -1;
+            if (end < 0) end = off + 2;
+            off = ((label & 0x3F) << 8) | buf[off+1];
+            continue;
+        }
+        if (label > DNS_MAX_LABEL || off + 1 + label > len) return -1;
+        if (n + label + 2 > size) return -1;
+        if (n > 0) out[n++] = '.';
+        memcpy(out + n, buf + off + 1, label);
+        n += label;
+        off += 1 + label;
+    }
+    out[n] = '\0';
+    return (end < 0) ? off : end;
+}
+
+// Compare names case-insensitively, ignoring a trailing dot on either one
+static int same_name(const char* a, const char* b) {
+    size_t la = strlen(a), lb = strlen(b);
+    if (la > 0 && a[la-1] == '.') la--;
+    if (lb > 0 && b[lb-1] == '.') lb--;
+    return la == lb && strncasecmp(a, b, la) == 0;
+}
+
+int dns_build_query(unsigned char* buf, int size, uint16_t id,
+                    const char* name, uint16_t qtype) {
+    size_t namelen = strlen(name);
+    if (namelen > 0 && name[namelen-1] == '.') namelen--;
+    if (namelen == 0 || namelen > DNS_MAX_NAME) return DNS_FAILURE;
+    // header + length-prefixed labels + root label + qtype + qclass
+    if (size < DNS_HEADER_SIZE + (int)namelen + 2 + 4) return DNS_FAILURE;
+
+    memset(buf, 0, DNS_HEADER_SIZE);
+    put16(buf, id);
+    buf[2] = 0x01;      // RD: ask for recursion
+    put16(buf + 4, 1);  // QDCOUNT
+
+    int off = DNS_HEADER_SIZE;
+    const char* label = name;
+    const char* end = name + namelen;
+    while (label < end) {
+        const char* dot = memchr(label, '.', end - label);
+        size_t n = dot ? (size_t)(dot - label) : (size_t)(end - label);
+        if (n == 0 || n > DNS_MAX_LABEL) return DNS_FAILURE;
+        buf[off++] = (unsigned char)n;
+        memcpy(buf + off, label, n);
+        off += n;
+        label += n + (dot ? 1 : 0);
+    }
+    buf[off++] = 0;
+    put16(buf + off, qtype);
+    put16(buf + off + 2, DNS_CLASS_IN);
+    return off + 4;
+}
+
+int dns_packet_id(const unsigned char* buf, int len, uint16_t* id) {
+    if (len < DNS_HEADER_SIZE) return DNS_FAILURE;
+    *id = get16(buf);
+    return DNS_SUCCESS;
+}
+
+int dns_parse_response(const unsigned char* buf, int len,
+                       const char* name, uint16_t qtype, dns_answer* ans) {
+    char qname[DNS_MAX_NAME + 2];
+    int i, off;
+
+    if (len < DNS_HEADER_SIZE) return DNS_FAILURE;
+    if (!(buf[2] & 0x80)) return DNS_FAILURE;         // QR: not a response
+    if (get16(buf + 4) != 1) return DNS_FAILURE;      // we only ever ask one question
+
+    memset(ans, 0, sizeof(*ans));
+    ans->id = get16(buf);
+    ans->rcode = buf[3] & 0x0F;
+
+    // The question must be the one we asked
+    off = read_name(buf, len, DNS_HEADER_SIZE, qname, sizeof(qname));
+    if (off < 0 || off + 4 > len) return DNS_FAILURE;
+    if (!same_name(qname, name) || get16(buf + off) != qtype) return DNS_FAILURE;
+    off += 4;
+
+    // Walk the answers (CNAMEs come first) and keep the first address
+    int ancount = get16(buf + 6);
+    for (i = 0; i < ancount; ++i) {
+        off = read_name(buf, len, off, qname, sizeof(qname));
+        if (off < 0 || off + 10 > len) return DNS_FAILURE;
+        uint16_t type = get16(buf + off);
+        uint16_t klass = get16(buf + off + 2);
+        uint32_t ttl = get32(buf + off + 4);
+        uint16_t rdlen = get16(buf + off + 8);
+        off += 10;
+        if (off + rdlen > len) return DNS_FAILURE;
+        if (klass == DNS_CLASS_IN && type == qtype) {
+            if (type == DNS_TYPE_A && rdlen == 4) {
+                ans->family = AF_INET;
+            } else if (type == DNS_TYPE_AAAA && rdlen == 16) {
+                ans->family = AF_INET6;
+            }
+            if (ans->family) {
+                memcpy(ans->addr, buf + off, rdlen);
+                ans->ttl = ttl;
+                break;
+            }
+        }
+        off += rdlen;
+    }
+    return DNS_SUCCESS;
+}
+
+int dns_parse_question(const unsigned char* buf, int len, uint16_t* id,
+                       char* name, int size, uint16_t* qtype, int* qend) {
+    if (len < DNS_HEADER_SIZE) return DNS_FAILURE;
+    if (buf[2] & 0x80) return DNS_FAILURE;            // not a query
+    if (get16(buf + 4) != 1) return DNS_FAILURE;
+    *id = get16(buf);
+    int off = read_name(buf, len, DNS_HEADER_SIZE, name, size);
+    if (off < 0 || off + 4 > len) return DNS_FAILURE;
+    *qtype = get16(buf + off);
+    *qend = off + 4;
+    return DNS_SUCCESS;
+}
@@ -0,0 +1,71 @@
+/* dnsproto.h
+ * Akira Youngblood, 2026-10-17
+ * Minimal DNS wire format helpers (RFC 1035): build a single-question query
+ * and pull the first address out of a response
+ *
+ * Used by the async resolver engine (dnsasync.c) and the stub DNS server in
+ * tools/, so both sides agree on the format.
+ */
+
+#ifndef DNSPROTO_H
+#define DNSPROTO_H
+
+#include <stdint.h>
+
+#define DNS_FAILURE -1
+#define DNS_SUCCESS 0
+
+#define DNS_PORT 53
+#define DNS_HEADER_SIZE 12
+#define DNS_MAX_NAME 253     // presentation format, without trailing dot
+#define DNS_MAX_LABEL 63
+#define DNS_MAX_PACKET 512   // plain UDP, no EDNS0
+
+#define DNS_TYPE_A 1
+#define DNS_TYPE_CNAME 5
+#define DNS_TYPE_AAAA 28
+#define DNS_CLASS_IN 1
+
+#define DNS_RCODE_NOERROR 0
+#define DNS_RCODE_SERVFAIL 2
+#define DNS_RCODE_NXDOMAIN 3
+
+typedef struct dns_answer_s {
+    uint16_t id;
+    int rcode;
+    int family;              // AF_INET or AF_INET6, 0 if no address in the answer
+    unsigned char addr[16];  // network byte order, 4 bytes used for AF_INET
+    uint32_t ttl;            // TTL of the returned address record
+} dns_answer;
+
+/* Build a recursive (RD) query for name/qtype into buf
+ * A trailing dot on name is accepted
+ * Returns the packet length, or DNS_FAILURE if name can't be encoded
+ */
+int dns_build_query(unsigned char* buf, int size, uint16_t id,
+                    const char* name, uint16_t qtype);
+
+/* Read the ID from the header of a packet
+ * Returns DNS_FAILURE if the packet is too short
+ */
+int dns_packet_id(const unsigned char* buf, int len, uint16_t* id);
+
+/* Parse a response to a query for name/qtype
+ * Checks that it is a response and that its question matches (so stray or
+ * spoofed packets that reuse an ID are rejected), then fills ans with the
+ * rcode and the first record of type qtype in the answer section
+ * Returns DNS_SUCCESS if the packet is a well-formed matching response
+ * (which may still carry an error rcode or no address)
+ */
+int dns_parse_response(const unsigned char* buf, int len,
+                       const char* name, uint16_t qtype, dns_answer* ans);
+
+/* Parse the question of a query, for servers
+ * name receives the presentation-format name, qend the offset just past the
+ * question section
+ * Returns DNS_SUCCESS or DNS_FAILURE
+ */
+int dns_parse_question(const unsigned char* buf, int len, uint16_t* id,
+                       char* name, int size, uint16_t* qtype, int* qend);
+
+#endif
@@ -0,0 +1,283 @@
+/* handoff.c
+ * Akira Youngblood, 2026-10-17
+ * Requester -> resolver handoff for multi-lookup
+ */
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "handoff.h"
+
+static const char* kind_names[] = { "blocking", "lockfree", "mesh" };
+
+// Meshes made so far, for handoff_mesh.id
+static atomic_ulong mesh_count;
+
+// The calling thread's place in a mesh, claimed on its first push or pop
+static _Thread_local struct {
+    unsigned long mesh;    // handoff_mesh.id these are for, 0 for none yet
+    int producer;          // -1 until claimed
+    int consumer;
+    int push_next;         // consumer whose ring gets the next batch
+    int pop_next;          // producer whose ring is polled next
+} self;
+
+// Wait strategy for the lock-free queue: yield for a while, then sleep in
+// short naps so idle resolvers don't eat a core while lookups are in flight
+static void backoff(int* spins) {
+    if (*spins < 64) {
+        sched_yield();
+    } else {
+        struct timespec nap = { 0, 50000 }; // 50 us
+        nanosleep(&nap, NULL);
+    }
+    (*spins)++;
+}
+
+int handoff_parse_kind(const char* name, handoff_kind* kind) {
+    int i;
+    for (i = 0; i < (int)(sizeof(kind_names)/sizeof(kind_names[0])); ++i) {
+        if (strcmp(name, kind_names[i]) == 0) {
+            *kind = (handoff_kind)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char* handoff_kind_name(handoff_kind kind) {
+    return kind_names[kind];
+}
+
+int handoff_init(handoff* h, handoff_kind kind, int size) {
+    h->kind = kind;
+    atomic_init(&h->producers, 0);
+    if (kind == HANDOFF_MESH) return QUEUE_FAILURE; // needs handoff_init_mesh()
+    if (kind == HANDOFF_LOCKFREE) return lfqueue_init(&h->u.lfq, size);
+    return bqueue_init(&h->u.bq, size);
+}
+
+int handoff_init_mesh(handoff* h, int size, int producers, int consumers) {
+    handoff_mesh* m = &h->u.mesh;
+    int i, n, slots = 0;
+    h->kind = HANDOFF_MESH;
+    atomic_init(&h->producers, 0);
+    if (producers <= 0 || consumers <= 0) return QUEUE_FAILURE;
+    n = producers * consumers;
+    m->rings = malloc(sizeof(spsc_ring) * n);
+    if (m->rings == NULL) {
+        perror("Error on mesh malloc");
+        return QUEUE_FAILURE;
+    }
+    for (i = 0; i < n; ++i) {
+        int cap = spsc_init(&m->rings[i], size);
+        if (cap == QUEUE_FAILURE) {
+            while (i-- > 0) spsc_cleanup(&m->rings[i]);
+            free(m->rings);
+            return QUEUE_FAILURE;
+        }
+        slots += cap;
+    }
+    m->producers = producers;
+    m->consumers = consumers;
+    atomic_init(&m->next_producer, 0);
+    atomic_init(&m->next_consumer, 0);
+    atomic_init(&m->closed, 0);
+    m->id = atomic_fetch_add(&mesh_count, 1) + 1;
+    return slots;
+}
+
+// Forget claims on any earlier mesh (a thread may outlive one)
+static void mesh_self(handoff_mesh* m) {
+    if (self.mesh == m->id) return;
+    self.mesh = m->id;
+    self.producer = -1;
+    self.consumer = -1;
+}
+
+static int mesh_producer(handoff_mesh* m) {
+    mesh_self(m);
+    if (self.producer < 0) {
+        self.producer = atomic_fetch_add(&m->next_producer, 1);
+        if (self.producer >= m->producers) {
+            fprintf(stderr, "Error: more producers than the mesh was made for\n");
+            return -1;
+        }
+        // Start each producer on a different consumer
+        self.push_next = self.producer % m->consumers;
+    }
+    return self.producer < m->producers ? self.producer : -1;
+}
+
+static int mesh_consumer(handoff_mesh* m) {
+    mesh_self(m);
+    if (self.consumer < 0) {
+        self.consumer = atomic_fetch_add(&m->next_consumer, 1);
+        if (self.consumer >= m->consumers) {
+            fprintf(stderr, "Error: more consumers than the mesh was made for\n");
+            return -1;
+        }
+        self.pop_next = self.consumer % m->producers;
+    }
+    return self.consumer < m->consumers ? self.consumer : -1;
+}
+
+// Each batch goes whole (as far as it fits) to the next consumer's ring
+static int mesh_push_batch(handoff_mesh* m, void** payloads, int n) {
+    int p = mesh_producer(m), done = 0, full = 0, spins = 0;
+    if (p < 0) return 0;
+    spsc_ring* row = m->rings + (size_t)p * m->consumers;
+    while (done < n) {
+        int pushed = spsc_push_batch(&row[self.push_next], payloads + done, n - done);
+        if (++self.push_next == m->consumers) self.push_next = 0;
+        done += pushed;
+        if (pushed > 0) {
+            full = 0;
+        } else if (++full == m->consumers) {
+            // Every ring of ours is full
+            if (atomic_load(&m->closed)) break;
+            backoff(&spins);
+            full = 0;
+        }
+    }
+    return done;
+}
+
+// Poll our rings round-robin, starting after the last one that had any
+static int mesh_pop_batch(handoff_mesh* m, void** payloads, int max, int wait, int* closed) {
+    int c = mesh_consumer(m), i, n, spins = 0;
+    *closed = 0;
+    if (c < 0) {
+        *closed = 1;
+        return 0;
+    }
+    for (;;) {
+        // Same closed-before-pop ordering as handoff_pop()
+        int was_closed = atomic_load(&m->closed);
+        for (i = 0; i < m->producers; ++i) {
+            spsc_ring* r = &m->rings[(size_t)self.pop_next * m->consumers + c];
+            if (++self.pop_next == m->producers) self.pop_next = 0;
+            if ((n = spsc_pop_batch(r, payloads, max)) > 0) return n;
+        }
+        if (was_closed) {
+            *closed = 1;
+            return 0;
+        }
+        if (!wait) return 0;
+        backoff(&spins);
+    }
+}
+
+int handoff_push(handoff* h, void* payload) {
+    int spins = 0;
+    if (h->kind == HANDOFF_BLOCKING) return bqueue_push(&h->u.bq, payload);
+    if (payload == NULL) return QUEUE_FAILURE;
+    if (h->kind == HANDOFF_MESH) {
+        return mesh_push_batch(&h->u.mesh, &payload, 1) ? QUEUE_SUCCESS : QUEUE_FAILURE;
+    }
+    while (lfqueue_push(&h->u.lfq, payload) == QUEUE_FAILURE) {
+        if (lfqueue_is_closed(&h->u.lfq)) return QUEUE_FAILURE;
+        backoff(&spins);
+    }
+    return QUEUE_SUCCESS;
+}
+
+void* handoff_pop(handoff* h) {
+    int spins = 0, drained;
+    void* payload;
+    if (h->kind == HANDOFF_BLOCKING) return bqueue_pop(&h->u.bq);
+    if (h->kind == HANDOFF_MESH) {
+        return mesh_pop_batch(&h->u.mesh, &payload, 1, 1, &drained) ? payload : NULL;
+    }
+    for (;;) {
+        // Check closed before popping: if it was already closed and the pop
+        // still comes back empty, every push has been drained
+        int closed = lfqueue_is_closed(&h->u.lfq);
+        if ((payload = lfqueue_pop(&h->u.lfq)) != NULL) return payload;
+        if (closed) return NULL;
+        backoff(&spins);
+    }
+}
+
+int handoff_push_batch(handoff* h, void** payloads, int n) {
+    int i;
+    if (h->kind == HANDOFF_BLOCKING) return bqueue_push_batch(&h->u.bq, payloads, n);
+    if (h->kind == HANDOFF_MESH) return mesh_push_batch(&h->u.mesh, payloads, n);
+    // No lock to amortize, each payload is one CAS either way
+    for (i = 0; i < n; ++i) {
+        if (handoff_push(h, payloads[i]) == QUEUE_FAILURE) break;
+    }
+    return i;
+}
+
+int handoff_pop_batch(handoff* h, void** payloads, int max) {
+    int n = 0, drained;
+    if (h->kind == HANDOFF_BLOCKING) return bqueue_pop_batch(&h->u.bq, payloads, max);
+    if (max <= 0) return 0;
+    if (h->kind == HANDOFF_MESH) return mesh_pop_batch(&h->u.mesh, payloads, max, 1, &drained);
+    // Wait for the first payload, then take whatever else is already there
+    if ((payloads[n++] = handoff_pop(h)) == NULL) return 0;
+    while (n < max && (payloads[n] = lfqueue_pop(&h->u.lfq)) != NULL) n++;
+    return n;
+}
+
+void* handoff_trypop(handoff* h, int* closed) {
+    void* payload;
+    if (h->kind == HANDOFF_BLOCKING) return bqueue_trypop(&h->u.bq, closed);
+    if (h->kind == HANDOFF_MESH) {
+        return mesh_pop_batch(&h->u.mesh, &payload, 1, 0, closed) ? payload : NULL;
+    }
+    // Same closed-before-pop ordering as handoff_pop()
+    int was_closed = lfqueue_is_closed(&h->u.lfq);
+    payload = lfqueue_pop(&h->u.lfq);
+    *closed = (payload == NULL && was_closed);
+    return payload;
+}
+
+int handoff_depth(handoff* h) {
+    int i, n = 0;
+    if (h->kind == HANDOFF_MESH) {
+        for (i = 0; i < h->u.mesh.producers * h->u.mesh.consumers; ++i) {
+            n += spsc_depth(&h->u.mesh.rings[i]);
+        }
+        return n;
+    }
+    if (h->kind == HANDOFF_LOCKFREE) return lfqueue_depth(&h->u.lfq);
+    return bqueue_depth(&h->u.bq);
+}
+
+void handoff_add_producers(handoff* h, int n) {
+    atomic_fetch_add(&h->producers, n);
+}
+
+void handoff_producer_done(handoff* h) {
+    // fetch_sub returns the old count, so 1 means we were the last producer
+    if (atomic_fetch_sub(&h->producers, 1) == 1) handoff_close(h);
+}
+
+void handoff_close(handoff* h) {
+    if (h->kind == HANDOFF_MESH) {
+        atomic_store(&h->u.mesh.closed, 1);
+    } else if (h->kind == HANDOFF_LOCKFREE) {
+        lfqueue_close(&h->u.lfq);
+    } else {
+        bqueue_close(&h->u.bq);
+    }
+}
+
+void handoff_cleanup(handoff* h) {
+    int i;
+    if (h->kind == HANDOFF_MESH) {
+        for (i = 0; i < h->u.mesh.producers * h->u.mesh.consumers; ++i) {
+            spsc_cleanup(&h->u.mesh.rings[i]);
+        }
+        free(h->u.mesh.rings);
+    } else if (h->kind == HANDOFF_LOCKFREE) {
+        lfqueue_cleanup(&h->u.lfq);
+    } else {
+        bqueue_cleanup(&h->u.bq);
+    }
+}
@@ -0,0 +1,128 @@
+/* handoff.h
+ * Akira Youngblood, 2026-10-17
+ * Requester -> resolver handoff for multi-lookup
+ *
+ * Puts one interface in front of the queue implementations so multi-lookup
+ * can pick one on the command line:
+ *   blocking: bqueue.c, mutex + condition variables
+ *   lockfree: lfqueue.c, lock-free ring, waits with yield/sleep backoff
+ *   mesh:     spsc.c, a single-producer/single-consumer ring for every
+ *             producer/consumer pair, same backoff
+ *
+ * With the first two every push and pop writes the same head or tail, one
+ * cache line passed around all the threads. A mesh has no index written by
+ * more than one thread: producer p pushes each batch to ring (p, c) of the
+ * next consumer c in turn, moving on past full ones, and consumer c polls
+ * rings (0..P-1, c) round-robin. Threads claim their producer or consumer
+ * number on their first push or pop, so the rings have to be laid out for
+ * the exact number of each (handoff_init_mesh()), and a name sits in its
+ * consumer's ring until that consumer takes it: each consumer must keep
+ * popping until it sees the end.
+ *
+ * End of input is explicit: every producer is registered up front with
+ * handoff_add_producers() and reports handoff_producer_done() when it stops,
+ * however it stops. When the last one is done the queue is closed, and only
+ * then do consumers see NULL from handoff_pop(). An empty queue on its own
+ * never means "finished".
+ */
+
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include <stdatomic.h>
+
+#include "bqueue.h"
+#include "lfqueue.h"
+#include "spsc.h"
+
+typedef enum {
+    HANDOFF_BLOCKING,
+    HANDOFF_LOCKFREE,
+    HANDOFF_MESH
+} handoff_kind;
+
+typedef struct handoff_mesh_s {
+    spsc_ring* rings;          // [producer * consumers + consumer]
+    int producers;
+    int consumers;
+    atomic_int next_producer;  // numbers claimed so far
+    atomic_int next_consumer;
+    atomic_int closed;
+    unsigned long id;          // tells threads' claims on an earlier mesh apart
+} handoff_mesh;
+
+typedef struct handoff_s {
+    handoff_kind kind;
+    atomic_int producers; // live producers, closes the queue when it hits 0
+    union {
+        bqueue bq;
+        lfqueue lfq;
+        handoff_mesh mesh;
+    } u;
+} handoff;
+
+/* Parse an implementation name ("blocking", "lockfree" or "mesh")
+ * Returns 0 on success, -1 if the name is unknown
+ */
+int handoff_parse_kind(const char* name, handoff_kind* kind);
+const char* handoff_kind_name(handoff_kind kind);
+
+/* Initialize the handoff queue (not a mesh, see below)
+ * Returns queue size on success, QUEUE_FAILURE on failure
+ */
+int handoff_init(handoff* h, handoff_kind kind, int size);
+
+/* Initialize a mesh for exactly this many producer and consumer threads,
+ * with rings of size slots each
+ * Returns the slots in all rings on success, QUEUE_FAILURE on failure
+ */
+int handoff_init_mesh(handoff* h, int size, int producers, int consumers);
+
+/* Hand a payload (non-NULL) to the consumers, waiting while the queue is full
+ * Returns QUEUE_SUCCESS, or QUEUE_FAILURE once the handoff is closed
+ */
+int handoff_push(handoff* h, void* payload);
+
+/* Hand n payloads (none NULL) to the consumers in one go, waiting while the
+ * queue is full. The blocking queue takes its lock once per batch rather than
+ * once per payload.
+ * Returns the number handed off: n, or fewer once the handoff is closed
+ */
+int handoff_push_batch(handoff* h, void** payloads, int n);
+
+/* Take the next payload, waiting while the queue is empty
+ * Returns NULL once the handoff is closed and drained
+ */
+void* handoff_pop(handoff* h);
+
+/* Take up to max payloads, waiting while the queue is empty
+ * Returns the number taken, 0 once the handoff is closed and drained
+ */
+int handoff_pop_batch(handoff* h, void** payloads, int max);
+
+/* Take the next payload without waiting, for callers that have other work
+ * (e.g. the async resolver's event loop)
+ * Returns NULL if the queue is empty, and sets *closed to 1 if it is also
+ * closed and drained
+ */
+void* handoff_trypop(handoff* h, int* closed);
+
+/* Number of payloads queued right now, for monitoring only */
+int handoff_depth(handoff* h);
+
+/* Register n producers, must happen before any of them can finish */
+void handoff_add_producers(handoff* h, int n);
+
+/* Called once by each registered producer when it will push no more
+ * The last one closes the handoff
+ */
+void handoff_producer_done(handoff* h);
+
+/* No more pushes will be made, consumers drain and then get NULL
+ * Normally called by the last handoff_producer_done()
+ */
+void handoff_close(handoff* h);
+
+void handoff_cleanup(handoff* h);
+
+#endif
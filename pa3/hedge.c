@@ -0,0 +1,333 @@
+/* hedge.c
+ * Akira Youngblood, 2026-10-17
+ * Deadlines, retries and hedged requests around a resolver backend
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "hedge.h"
+
+#define NEVER UINT64_MAX
+
+// One lookup, shared by the resolver waiting on it and its attempts
+typedef struct hedge_call_s {
+    pthread_mutex_t lock;
+    pthread_cond_t answered;
+    atomic_int refs;           // the resolver, plus attempts not yet finished
+    int all;                   // dnslookup_all() rather than dnslookup()
+    int max;                   // all: addresses wanted
+    int done;                  // an attempt has answered, or the lookup gave up
+    int gave_up;
+    int winner;                // attempt that answered
+    int rv;
+    char result[UTIL_ADDRS_STRLEN];
+    dnsaddr addrs[UTIL_MAX_ADDRS];
+    int count;
+    char name[];
+} hedge_call;
+
+struct hedge_job_s {
+    hedge_call* call;
+    int attempt;
+    hedge_job* next;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// Wait on cond until the monotonic time deadline. Condition variables time
+// out on the wall clock (settable clocks aren't portable), so convert.
+static void wait_until(pthread_cond_t* cond, pthread_mutex_t* lock, uint64_t deadline) {
+    uint64_t now = now_ns(), wait = deadline > now ? deadline - now : 0;
+    struct timeval tv;
+    struct timespec ts;
+    gettimeofday(&tv, NULL);
+    uint64_t ns = (uint64_t)tv.tv_usec * 1000 + wait;
+    ts.tv_sec = tv.tv_sec + ns / 1000000000u;
+    ts.tv_nsec = ns % 1000000000u;
+    pthread_cond_timedwait(cond, lock, &ts);
+}
+
+static void call_release(hedge_call* c) {
+    if (atomic_fetch_sub(&c->refs, 1) == 1) {
+        pthread_mutex_destroy(&c->lock);
+        pthread_cond_destroy(&c->answered);
+        free(c);
+    }
+}
+
+// Time one attempt, and every so often move the hedge delay to the p95 of
+// the current window
+static void record_latency(hedge* h, uint64_t ns) {
+    pthread_mutex_lock(&h->stats_lock);
+    metrics_hist_record(h->window, ns);
+    uint64_t n = h->window->total;
+    if (n >= HEDGE_MIN_SAMPLES && n % HEDGE_MIN_SAMPLES == 0) {
+        uint64_t p95 = metrics_hist_percentile(h->window, 95);
+        if (p95 < HEDGE_MIN_DELAY_US * 1000u) p95 = HEDGE_MIN_DELAY_US * 1000u;
+        atomic_store(&h->hedge_ns, p95);
+        // Start a fresh window, so the delay follows the latency around
+        if (n >= HEDGE_WINDOW) memset(h->window, 0, sizeof(*h->window));
+    }
+    pthread_mutex_unlock(&h->stats_lock);
+}
+
+// Make one attempt at a lookup through the inner backend
+static void run_attempt(hedge* h, hedge_job* job) {
+    hedge_call* c = job->call;
+    char result[UTIL_ADDRS_STRLEN];
+    dnsaddr addrs[UTIL_MAX_ADDRS];
+    int rv, count = 0;
+    uint64_t start = now_ns();
+    if (c->all) {
+        rv = h->inner.lookup_all ? h->inner.lookup_all(h->inner.state, c->name, addrs, c->max, &count)
+                                 : dnslookup_all_system(c->name, addrs, c->max, &count);
+    } else {
+        rv = h->inner.lookup ? h->inner.lookup(h->inner.state, c->name, result, sizeof(result))
+                             : dnslookup_system(c->name, result, sizeof(result));
+    }
+    record_latency(h, now_ns() - start);
+    pthread_mutex_lock(&c->lock);
+    if (!c->done) {
+        c->done = 1;
+        c->winner = job->attempt;
+        c->rv = rv;
+        if (c->all) {
+            memcpy(c->addrs, addrs, count * sizeof(dnsaddr));
+            c->count = count;
+        } else if (rv == UTIL_SUCCESS) {
+            strcpy(c->result, result);
+        }
+        pthread_cond_signal(&c->answered);
+    } else if (c->gave_up) {
+        atomic_fetch_add(&h->late, 1);
+    }
+    pthread_mutex_unlock(&c->lock);
+    call_release(c);
+    free(job);
+}
+
+static void* helper_main(void* arg) {
+    hedge* h = arg;
+    pthread_mutex_lock(&h->lock);
+    for (;;) {
+        while (h->head == NULL && !h->stopping) {
+            h->idle++;
+            pthread_cond_wait(&h->work, &h->lock);
+            h->idle--;
+        }
+        hedge_job* job = h->head;
+        if (job == NULL) break;
+        h->head = job->next;
+        if (h->head == NULL) h->tail = NULL;
+        pthread_mutex_unlock(&h->lock);
+        run_attempt(h, job);
+        pthread_mutex_lock(&h->lock);
+    }
+    h->helpers--;
+    pthread_cond_broadcast(&h->gone);
+    pthread_mutex_unlock(&h->lock);
+    return NULL;
+}
+
+// Queue an attempt for a helper, starting one if none is idle
+// Returns 0 on success, -1 if it couldn't be queued
+static int start_attempt(hedge* h, hedge_call* c, int attempt) {
+    hedge_job* job = malloc(sizeof(hedge_job));
+    if (job == NULL) return -1;
+    job->call = c;
+    job->attempt = attempt;
+    job->next = NULL;
+    atomic_fetch_add(&c->refs, 1);
+    atomic_fetch_add(&h->attempts, 1);
+    pthread_mutex_lock(&h->lock);
+    if (h->tail) h->tail->next = job;
+    else h->head = job;
+    h->tail = job;
+    if (h->idle > 0) {
+        pthread_cond_signal(&h->work);
+    } else if (h->helpers < HEDGE_MAX_HELPERS) {
+        pthread_t thread;
+        pthread_attr_t attr;
+        // Detached: a helper stuck in getaddrinfo() mustn't hold up the exit
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&thread, &attr, helper_main, h) == 0) h->helpers++;
+        pthread_attr_destroy(&attr);
+        // No helper at all: nobody would ever take the job
+        if (h->helpers == 0) {
+            h->head = h->tail = NULL;
+            pthread_mutex_unlock(&h->lock);
+            atomic_fetch_sub(&c->refs, 1);
+            free(job);
+            return -1;
+        }
+    }
+    pthread_mutex_unlock(&h->lock);
+    return 0;
+}
+
+// Run a lookup as attempts with a deadline, retries and a hedge, and wait
+// for the first answer. Returns with c done and c->rv set.
+static void run_call(hedge* h, hedge_call* c) {
+    uint64_t now = now_ns(), hedge_ns = atomic_load(&h->hedge_ns);
+    uint64_t deadline = h->timeout_ms ? now + h->timeout_ms * 1000000ull : NEVER;
+    uint64_t hedge_at = h->hedging && hedge_ns ? now + hedge_ns : NEVER;
+    uint64_t retry_at = NEVER, backoff = HEDGE_BACKOFF_MS * 1000000ull;
+    int attempts = 1, retries = 0, hedged = -1;
+    atomic_fetch_add(&h->lookups, 1);
+    c->rv = UTIL_FAILURE;
+    if (start_attempt(h, c, 0)) return;
+    pthread_mutex_lock(&c->lock);
+    while (!c->done) {
+        uint64_t next = deadline < hedge_at ? deadline : hedge_at;
+        if (retry_at < next) next = retry_at;
+        if (next == NEVER) {
+            pthread_cond_wait(&c->answered, &c->lock);
+            continue;
+        }
+        now = now_ns();
+        if (now < next) {
+            wait_until(&c->answered, &c->lock, next);
+            continue;
+        }
+        if (now >= hedge_at) {
+            // One hedge per lookup, running alongside the attempt it hedges
+            hedge_at = NEVER;
+            pthread_mutex_unlock(&c->lock);
+            if (start_attempt(h, c, attempts) == 0) {
+                hedged = attempts++;
+                atomic_fetch_add(&h->hedges, 1);
+            }
+            pthread_mutex_lock(&c->lock);
+        } else if (now >= retry_at) {
+            retry_at = NEVER;
+            deadline = now + h->timeout_ms * 1000000ull;
+            pthread_mutex_unlock(&c->lock);
+            if (start_attempt(h, c, attempts) == 0) {
+                attempts++;
+                atomic_fetch_add(&h->retries_sent, 1);
+            }
+            pthread_mutex_lock(&c->lock);
+        } else {
+            // Deadline: earlier attempts stay out and may still answer
+            // while we back off
+            atomic_fetch_add(&h->deadlines, 1);
+            deadline = NEVER;
+            hedge_at = NEVER;
+            if (retries == h->retries) {
+                c->done = c->gave_up = 1;
+                atomic_fetch_add(&h->timeouts, 1);
+                break;
+            }
+            retry_at = now + (backoff << retries++);
+        }
+    }
+    if (!c->gave_up && c->winner == hedged) atomic_fetch_add(&h->hedge_wins, 1);
+    pthread_mutex_unlock(&c->lock);
+}
+
+static hedge_call* new_call(const char* hostname) {
+    size_t len = strlen(hostname);
+    hedge_call* c = malloc(sizeof(hedge_call) + len + 1);
+    if (c == NULL) return NULL;
+    if (pthread_mutex_init(&c->lock, NULL)) {
+        free(c);
+        return NULL;
+    }
+    if (pthread_cond_init(&c->answered, NULL)) {
+        pthread_mutex_destroy(&c->lock);
+        free(c);
+        return NULL;
+    }
+    atomic_init(&c->refs, 1);
+    c->all = c->max = c->done = c->gave_up = c->count = 0;
+    c->winner = -1;
+    memcpy(c->name, hostname, len + 1);
+    return c;
+}
+
+static int hedge_lookup(void* state, const char* hostname, char* firstIPstr, int maxSize) {
+    hedge_call* c = new_call(hostname);
+    int rv;
+    if (c == NULL) return UTIL_FAILURE;
+    run_call(state, c);
+    rv = c->rv;
+    if (rv == UTIL_SUCCESS) {
+        strncpy(firstIPstr, c->result, maxSize);
+        firstIPstr[maxSize-1] = '\0';
+    }
+    call_release(c);
+    return rv;
+}
+
+static int hedge_lookup_all(void* state, const char* hostname, dnsaddr* addrs, int maxAddrs, int* count) {
+    hedge_call* c = new_call(hostname);
+    int rv;
+    *count = 0;
+    if (c == NULL) return UTIL_FAILURE;
+    c->all = 1;
+    c->max = maxAddrs < UTIL_MAX_ADDRS ? maxAddrs : UTIL_MAX_ADDRS;
+    run_call(state, c);
+    rv = c->rv;
+    if (c->done && !c->gave_up) {
+        memcpy(addrs, c->addrs, c->count * sizeof(dnsaddr));
+        *count = c->count;
+    }
+    call_release(c);
+    return rv;
+}
+
+int hedge_init(hedge* h, const dnsbackend* inner, int timeout_ms, int retries, int hedging,
+               dnsbackend* out) {
+    memset(h, 0, sizeof(*h));
+    if (inner) h->inner = *inner;
+    h->timeout_ms = timeout_ms;
+    h->retries = timeout_ms ? retries : 0; // only timeouts are retried
+    h->hedging = hedging;
+    atomic_init(&h->hedge_ns, 0);
+    atomic_init(&h->lookups, 0);
+    atomic_init(&h->attempts, 0);
+    atomic_init(&h->deadlines, 0);
+    atomic_init(&h->timeouts, 0);
+    atomic_init(&h->retries_sent, 0);
+    atomic_init(&h->hedges, 0);
+    atomic_init(&h->hedge_wins, 0);
+    atomic_init(&h->late, 0);
+    h->window = calloc(1, sizeof(metrics_hist));
+    if (h->window == NULL || pthread_mutex_init(&h->lock, NULL) ||
+        pthread_mutex_init(&h->stats_lock, NULL) || pthread_cond_init(&h->work, NULL) ||
+        pthread_cond_init(&h->gone, NULL)) {
+        free(h->window);
+        return -1;
+    }
+    memset(out, 0, sizeof(*out));
+    out->name = inner && inner->name ? inner->name : "getaddrinfo";
+    out->lookup = hedge_lookup;
+    out->lookup_all = hedge_lookup_all;
+    out->state = h;
+    return 0;
+}
+
+int hedge_cleanup(hedge* h) {
+    pthread_mutex_lock(&h->lock);
+    h->stopping = 1;
+    pthread_cond_broadcast(&h->work);
+    // Idle helpers exit right away; busy ones finish their attempt first
+    while (h->idle > 0) pthread_cond_wait(&h->gone, &h->lock);
+    int busy = h->helpers;
+    pthread_mutex_unlock(&h->lock);
+    if (busy > 0) return busy; // they still use the locks, and h lives on
+    pthread_mutex_destroy(&h->lock);
+    pthread_mutex_destroy(&h->stats_lock);
+    pthread_cond_destroy(&h->work);
+    pthread_cond_destroy(&h->gone);
+    free(h->window);
+    return 0;
+}
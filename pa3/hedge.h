@@ -0,0 +1,94 @@
+/* hedge.h
+ * Akira Youngblood, 2026-10-17
+ * Deadlines, retries and hedged requests around a resolver backend
+ * (multi-lookup's -T, -R and -H)
+ *
+ * A blocking lookup can't be cancelled: a name the system resolver gets no
+ * answer for holds its thread for the resolver's own timeout, several
+ * seconds, and a handful of those set the tail of a whole run. So each
+ * lookup is made on a helper thread instead (an attempt), and the resolver
+ * thread waits for it with a deadline:
+ *
+ *   - deadline (-T ms): an attempt that hasn't answered by then is given up
+ *     on. It keeps running on its helper and can still win, but the
+ *     resolver moves on: to a retry, or to a failed lookup.
+ *   - retries (-R n): after a deadline, wait a backoff (HEDGE_BACKOFF_MS,
+ *     doubling) and start another attempt, up to n times. Only timeouts are
+ *     retried; a failed lookup is an answer (the name doesn't exist).
+ *   - hedging (-H): once an attempt has been out for the p95 latency of
+ *     recent attempts, start a second one and take whichever answers first.
+ *     Costs about 5% more queries and cuts off the slowest 5%.
+ *
+ * The first answer from any attempt wins; later ones are dropped. Helper
+ * threads are started as attempts need them and kept for reuse, up to
+ * HEDGE_MAX_HELPERS (past that, attempts wait for one to come free).
+ *
+ * hedge_init() wraps an existing backend into a new one to hand to
+ * dnslookup_set_backend(), so everything that calls dnslookup() gets it.
+ */
+
+#ifndef HEDGE_H
+#define HEDGE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "metrics.h"
+#include "util.h"
+
+#define HEDGE_BACKOFF_MS 50     // before the first retry, doubling
+#define HEDGE_MAX_HELPERS 2048
+#define HEDGE_MIN_SAMPLES 64    // attempts timed before hedging starts
+#define HEDGE_WINDOW 4096       // attempts per p95 window
+#define HEDGE_MIN_DELAY_US 1000 // never hedge sooner than this
+
+typedef struct hedge_job_s hedge_job;
+
+typedef struct hedge_s {
+    dnsbackend inner;           // lookup NULL: getaddrinfo()
+    int timeout_ms;             // 0: no deadline
+    int retries;
+    int hedging;
+    // Attempts waiting for a helper, and the helpers, under lock
+    pthread_mutex_t lock;
+    pthread_cond_t work;        // an attempt is queued, or stopping
+    pthread_cond_t gone;        // a helper exited
+    hedge_job* head;
+    hedge_job* tail;
+    int helpers;
+    int idle;
+    int stopping;
+    // Attempt latency, for the hedge delay, under stats_lock
+    pthread_mutex_t stats_lock;
+    metrics_hist* window;
+    atomic_ullong hedge_ns;     // current hedge delay, 0 until known
+    // Counters
+    atomic_ulong lookups;
+    atomic_ulong attempts;
+    atomic_ulong deadlines;     // attempts that missed their deadline
+    atomic_ulong timeouts;      // lookups that failed for it
+    atomic_ulong retries_sent;
+    atomic_ulong hedges;
+    atomic_ulong hedge_wins;    // lookups answered by the hedge first
+    atomic_ulong late;          // answers that came after the lookup gave up
+} hedge;
+
+/* Wrap inner (NULL: getaddrinfo()) into out, a backend that applies a
+ * deadline of timeout_ms per attempt (0: none), up to retries retries after
+ * a deadline, and hedging if hedging is set. inner stays owned by the
+ * caller and must outlive the helpers (see hedge_cleanup()).
+ * Returns 0 on success, -1 on failure
+ */
+int hedge_init(hedge* h, const dnsbackend* inner, int timeout_ms, int retries, int hedging,
+               dnsbackend* out);
+
+/* Stop the helpers. Attempts still running (given up on, stuck in the
+ * inner backend) aren't waited for: the exit shouldn't take as long as the
+ * timeouts they were cut short to avoid.
+ * Returns how many are still running; while any are, h and inner must not
+ * be freed (at exit, just leave them)
+ */
+int hedge_cleanup(hedge* h);
+
+#endif
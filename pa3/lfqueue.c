@@ -0,0 +1,110 @@
+/* lfqueue.c
+ * Akira Youngblood, 2026-10-17
+ * Lock-free MPMC bounded queue (sequence-numbered ring, after Dmitry Vyukov's
+ * bounded MPMC queue)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "lfqueue.h"
+
+int lfqueue_init(lfqueue* q, int size) {
+    size_t i, cap = 1;
+    if (size <= 0) size = QUEUEMAXSIZE;
+    // Round up to a power of two so positions wrap with a mask
+    while (cap < (size_t)size) cap <<= 1;
+
+    q->slots = malloc(sizeof(lfqueue_slot) * cap);
+    if (!q->slots) {
+        perror("Error on lfqueue malloc");
+        return QUEUE_FAILURE;
+    }
+    // Slot i is free for the push at position i
+    for (i = 0; i < cap; ++i) {
+        atomic_init(&q->slots[i].seq, i);
+        q->slots[i].payload = NULL;
+    }
+    q->mask = cap - 1;
+    q->maxSize = (int)cap;
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    atomic_init(&q->closed, 0);
+    return q->maxSize;
+}
+
+int lfqueue_push(lfqueue* q, void* payload) {
+    lfqueue_slot* slot;
+    size_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    for (;;) {
+        slot = &q->slots[pos & q->mask];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+        if (dif == 0) {
+            // Slot is free for this lap, try to claim it
+            if (atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (dif < 0) {
+            // Slot still holds last lap's payload: full
+            return QUEUE_FAILURE;
+        } else {
+            // Another producer got here first
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+        }
+    }
+    slot->payload = payload;
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    return QUEUE_SUCCESS;
+}
+
+void* lfqueue_pop(lfqueue* q) {
+    lfqueue_slot* slot;
+    void* payload;
+    size_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    for (;;) {
+        slot = &q->slots[pos & q->mask];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (dif == 0) {
+            // Slot was filled for this lap, try to claim it
+            if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (dif < 0) {
+            // Nothing pushed here yet: empty
+            return NULL;
+        } else {
+            // Another consumer got here first
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+        }
+    }
+    payload = slot->payload;
+    // Free the slot for the push one lap later
+    atomic_store_explicit(&slot->seq, pos + q->mask + 1, memory_order_release);
+    return payload;
+}
+
+int lfqueue_depth(lfqueue* q) {
+    // Either end can move between the two loads, so clamp to [0, maxSize]
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    if (tail < head) return 0;
+    return tail - head > (size_t)q->maxSize ? q->maxSize : (int)(tail - head);
+}
+
+void lfqueue_close(lfqueue* q) {
+    atomic_store_explicit(&q->closed, 1, memory_order_release);
+}
+
+int lfqueue_is_closed(lfqueue* q) {
+    return atomic_load_explicit(&q->closed, memory_order_acquire);
+}
+
+void lfqueue_cleanup(lfqueue* q) {
+    free(q->slots);
+    q->slots = NULL;
+}
@@ -0,0 +1,68 @@
+/* lfqueue.h
+ * Akira Youngblood, 2026-10-17
+ * Lock-free multi-producer/multi-consumer bounded FIFO queue
+ *
+ * Same push/pop semantics as queue.c (push fails when full, pop returns NULL
+ * when empty) but safe to call from any number of threads without a lock.
+ * Each slot carries a sequence number that tells producers and consumers
+ * whether it is free or filled for the current lap around the ring, so
+ * NULL payloads are never needed to tell full from empty. Head and tail sit
+ * on their own cache lines so producers and consumers don't false-share.
+ */
+
+#ifndef LFQUEUE_H
+#define LFQUEUE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "queue.h" // QUEUE_SUCCESS, QUEUE_FAILURE
+
+#define LFQUEUE_CACHE_LINE 64
+
+typedef struct lfqueue_slot_s {
+    atomic_size_t seq;
+    void* payload;
+} lfqueue_slot;
+
+typedef struct lfqueue_s {
+    _Alignas(LFQUEUE_CACHE_LINE) atomic_size_t head; // next slot to pop
+    _Alignas(LFQUEUE_CACHE_LINE) atomic_size_t tail; // next slot to push
+    _Alignas(LFQUEUE_CACHE_LINE) lfqueue_slot* slots;
+    size_t mask;
+    int maxSize;
+    atomic_int closed;
+} lfqueue;
+
+/* Initialize a queue with room for at least size payloads
+ * (rounded up to a power of two, QUEUEMAXSIZE if size <= 0)
+ * On success, returns queue size
+ * On failure, returns QUEUE_FAILURE
+ */
+int lfqueue_init(lfqueue* q, int size);
+
+/* Add payload to the end of the queue without blocking
+ * Returns QUEUE_SUCCESS, or QUEUE_FAILURE if the queue is full
+ */
+int lfqueue_push(lfqueue* q, void* payload);
+
+/* Remove the payload at the front of the queue without blocking
+ * Returns NULL if the queue is empty
+ */
+void* lfqueue_pop(lfqueue* q);
+
+/* Approximate number of payloads queued (for monitoring), a snapshot that
+ * may be off by the pushes and pops in progress
+ */
+int lfqueue_depth(lfqueue* q);
+
+/* Mark the queue closed, no more pushes will be made
+ * Consumers that see lfqueue_is_closed() before an empty pop are done
+ */
+void lfqueue_close(lfqueue* q);
+int lfqueue_is_closed(lfqueue* q);
+
+/* Free queue memory */
+void lfqueue_cleanup(lfqueue* q);
+
+#endif
@@ -0,0 +1,293 @@
+/* lookupd.c
+ * Akira Youngblood, 2026-10-17
+ * Resolver daemon front end for multi-lookup (-U)
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "lookupd.h"
+
+// A whole frame of the largest size always fits, plus room to read ahead
+#define READ_BUF (2 * (2 + 65535))
+
+static uint16_t get16(const unsigned char* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t get32(const unsigned char* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void put16(unsigned char* p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v & 0xFF;
+}
+
+static void put32(unsigned char* p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = (v >> 16) & 0xFF;
+    p[2] = (v >> 8) & 0xFF;
+    p[3] = v & 0xFF;
+}
+
+// Drop a reference, the last one closes and frees the connection
+static void conn_release(lookupd_conn* c) {
+    if (atomic_fetch_sub(&c->refs, 1) == 1) {
+        close(c->fd);
+        pthread_mutex_destroy(&c->lock);
+        free(c);
+    }
+}
+
+// Write one response frame, unless the connection is already broken
+static void conn_send(lookupd_conn* c, uint32_t id, int status, const char* result) {
+    unsigned char frame[2 + 5 + LOOKUPD_MAX_RESULT];
+    size_t len = strlen(result), off = 0;
+    if (len > LOOKUPD_MAX_RESULT) len = LOOKUPD_MAX_RESULT;
+    put16(frame, (uint16_t)(5 + len));
+    put32(frame + 2, id);
+    frame[6] = (unsigned char)status;
+    memcpy(frame + 7, result, len);
+    len += 7;
+    pthread_mutex_lock(&c->lock);
+    while (!c->broken && off < len) {
+        // MSG_NOSIGNAL: a client that went away is no reason to die of SIGPIPE
+        ssize_t n = send(c->fd, frame + off, len - off, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            c->broken = 1;
+            break;
+        }
+        off += n;
+    }
+    if (c->broken) atomic_fetch_add(&c->d->dropped, 1);
+    pthread_mutex_unlock(&c->lock);
+}
+
+void lookupd_respond(lookupd_request* req, int status, const char* result) {
+    lookupd_conn* c = req->conn;
+    conn_send(c, req->id, status, status == LOOKUPD_OK ? result : "");
+    free(req);
+    conn_release(c);
+}
+
+// Queue the requests read so far; ones the resolvers won't take any more
+// are answered right here
+static void submit_batch(lookupd_conn* c, lookupd_request** batch, int n) {
+    int i, taken = c->d->submit(c->d->submit_arg, batch, n);
+    for (i = taken; i < n; ++i) lookupd_respond(batch[i], LOOKUPD_SHUTDOWN, "");
+}
+
+// Per connection: parse request frames and queue them, a batch at a time.
+// A partial batch is queued before every read that might block, so a
+// client sending one request at a time isn't kept waiting.
+static void* reader(void* arg) {
+    lookupd_conn* c = arg;
+    lookupd* d = c->d;
+    unsigned char* buf = malloc(READ_BUF);
+    lookupd_request* batch[LOOKUPD_BATCH];
+    size_t len = 0, off;
+    int n = 0;
+    while (buf) {
+        ssize_t got = read(c->fd, buf + len, READ_BUF - len);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) break;
+        len += got;
+        for (off = 0; len - off >= 2 && len - off >= 2u + get16(buf + off); off += 2 + get16(buf + off)) {
+            const unsigned char* frame = buf + off + 2;
+            size_t flen = get16(buf + off);
+            uint32_t id = flen >= 4 ? get32(frame) : 0;
+            atomic_fetch_add(&d->requests, 1);
+            if (flen <= 4 || flen - 4 > LOOKUPD_MAX_NAME) {
+                atomic_fetch_add(&d->bad_requests, 1);
+                conn_send(c, id, LOOKUPD_BADREQUEST, "");
+                continue;
+            }
+            // Stopping: what is still buffered gets a quick no rather than
+            // holding the shutdown up behind a queue full of lookups
+            if (atomic_load(&d->stopping)) {
+                conn_send(c, id, LOOKUPD_SHUTDOWN, "");
+                continue;
+            }
+            lookupd_request* req = malloc(sizeof(lookupd_request) + flen - 4 + 1);
+            if (req == NULL) {
+                conn_send(c, id, LOOKUPD_NOTFOUND, "");
+                continue;
+            }
+            req->conn = c;
+            req->id = id;
+            memcpy(req->name, frame + 4, flen - 4);
+            req->name[flen - 4] = '\0';
+            atomic_fetch_add(&c->refs, 1);
+            batch[n++] = req;
+            if (n == LOOKUPD_BATCH) {
+                submit_batch(c, batch, n);
+                n = 0;
+            }
+        }
+        memmove(buf, buf + off, len - off);
+        len -= off;
+        if (n > 0) {
+            submit_batch(c, batch, n);
+            n = 0;
+        }
+    }
+    free(buf);
+    // Done reading; responses still to come keep the connection open
+    pthread_mutex_lock(&d->lock);
+    lookupd_conn** p = &d->conns;
+    while (*p != c) p = &(*p)->next;
+    *p = c->next;
+    d->readers--;
+    pthread_cond_broadcast(&d->idle);
+    pthread_mutex_unlock(&d->lock);
+    conn_release(c);
+    return NULL;
+}
+
+int lookupd_listen(lookupd* d, const char* path, lookupd_submit submit, void* arg) {
+    struct sockaddr_un addr;
+    struct stat st;
+    memset(d, 0, sizeof(*d));
+    d->listen_fd = d->wake[0] = d->wake[1] = -1;
+    d->path = path;
+    d->submit = submit;
+    d->submit_arg = arg;
+    atomic_init(&d->stopping, 0);
+    atomic_init(&d->connections, 0);
+    atomic_init(&d->requests, 0);
+    atomic_init(&d->bad_requests, 0);
+    atomic_init(&d->dropped, 0);
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (pthread_mutex_init(&d->lock, NULL) || pthread_cond_init(&d->idle, NULL) || pipe(d->wake)) {
+        perror("Error setting up the daemon");
+        return -1;
+    }
+    d->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (d->listen_fd < 0) {
+        perror("Error creating socket");
+        return -1;
+    }
+    // Never replace anything but a socket (connect() to a regular file is
+    // refused too)
+    if (lstat(path, &st) == 0 && !S_ISSOCK(st.st_mode)) {
+        fprintf(stderr, "%s exists and is not a socket\n", path);
+        return -1;
+    }
+    // A socket file nobody answers on is left over from a daemon that died
+    if (connect(d->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+        fprintf(stderr, "A daemon is already listening on %s\n", path);
+        return -1;
+    }
+    if (errno == ECONNREFUSED) unlink(path);
+    close(d->listen_fd);
+    d->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (d->listen_fd < 0 || bind(d->listen_fd, (struct sockaddr*)&addr, sizeof(addr))) {
+        perror("Error listening on socket");
+        return -1;
+    }
+    // Remember which file is ours, for lookupd_cleanup()
+    if (lstat(path, &st) == 0) {
+        d->bound = 1;
+        d->sock_dev = st.st_dev;
+        d->sock_ino = st.st_ino;
+    }
+    if (listen(d->listen_fd, LOOKUPD_BACKLOG)) {
+        perror("Error listening on socket");
+        return -1;
+    }
+    return 0;
+}
+
+int lookupd_run(lookupd* d) {
+    struct pollfd fds[2] = { { d->listen_fd, POLLIN, 0 }, { d->wake[0], POLLIN, 0 } };
+    struct timeval timeout = { LOOKUPD_SEND_TIMEOUT_S, 0 };
+    int rv = 0;
+    while (!atomic_load(&d->stopping)) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("Error waiting for connections");
+            rv = -1;
+            break;
+        }
+        if (!(fds[0].revents & POLLIN)) continue;
+        int fd = accept(d->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            // Out of descriptors and the like: refuse this one, keep going
+            if (errno != EINTR && errno != ECONNABORTED) perror("Error accepting connection");
+            continue;
+        }
+        // A client that stops reading can't hold a resolver forever
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        lookupd_conn* c = calloc(1, sizeof(lookupd_conn));
+        pthread_t thread;
+        if (c == NULL || pthread_mutex_init(&c->lock, NULL)) {
+            free(c);
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->d = d;
+        atomic_init(&c->refs, 1);
+        pthread_mutex_lock(&d->lock);
+        c->next = d->conns;
+        d->conns = c;
+        d->readers++;
+        if (pthread_create(&thread, NULL, reader, c)) {
+            d->conns = c->next;
+            d->readers--;
+            pthread_mutex_unlock(&d->lock);
+            conn_release(c);
+            continue;
+        }
+        pthread_mutex_unlock(&d->lock);
+        pthread_detach(thread);
+        atomic_fetch_add(&d->connections, 1);
+    }
+    // Stop reading from everyone: readers answer what the socket still
+    // holds with LOOKUPD_SHUTDOWN, see end of file and exit
+    pthread_mutex_lock(&d->lock);
+    for (lookupd_conn* c = d->conns; c; c = c->next) shutdown(c->fd, SHUT_RD);
+    while (d->readers > 0) pthread_cond_wait(&d->idle, &d->lock);
+    pthread_mutex_unlock(&d->lock);
+    return rv;
+}
+
+void lookupd_stop(lookupd* d) {
+    char byte = 1;
+    atomic_store(&d->stopping, 1);
+    if (write(d->wake[1], &byte, 1) < 0) {
+        // The pipe is full, so a wakeup is already pending
+    }
+}
+
+void lookupd_cleanup(lookupd* d) {
+    struct stat st;
+    if (d->listen_fd >= 0) close(d->listen_fd);
+    // Only the socket we bound: not a live daemon's we found, nor whatever
+    // has replaced ours since
+    if (d->bound && lstat(d->path, &st) == 0 && S_ISSOCK(st.st_mode) &&
+        st.st_dev == d->sock_dev && st.st_ino == d->sock_ino) {
+        unlink(d->path);
+    }
+    if (d->wake[0] >= 0) close(d->wake[0]);
+    if (d->wake[1] >= 0) close(d->wake[1]);
+    pthread_mutex_destroy(&d->lock);
+    pthread_cond_destroy(&d->idle);
+}
@@ -0,0 +1,116 @@
+/* lookupd.h
+ * Akira Youngblood, 2026-10-17
+ * Resolver daemon front end for multi-lookup (-U): a Unix domain socket that
+ * takes hostnames from many clients and hands them to the resolver pool
+ *
+ * The pool, the cache and the queue stay up between jobs, so a short job
+ * pays for none of the thread creation, cache warmup or file handling of a
+ * fresh multi-lookup run. Each connection gets a reader thread that parses
+ * requests and queues them in batches; resolver threads answer each request
+ * on the connection it came from as soon as it is resolved, so responses
+ * come back in completion order, not request order (match them up by id).
+ *
+ * Protocol, every integer big-endian, every frame length-prefixed:
+ *
+ *   request:  u16 length | u32 id | name (length - 4 bytes, no NUL)
+ *   response: u16 length | u32 id | u8 status | result (length - 5 bytes)
+ *
+ * The result is the address, or with -A every address comma-separated, and
+ * empty unless status is LOOKUPD_OK. A client may send any number of
+ * requests without waiting (pipelining), but must keep reading responses
+ * while it does: a connection that stops reading for LOOKUPD_SEND_TIMEOUT_S
+ * has its remaining responses dropped. Shutting down the write side after
+ * the last request gets every response and then end of file.
+ */
+
+#ifndef LOOKUPD_H
+#define LOOKUPD_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define LOOKUPD_MAX_NAME 1024      // longer names get LOOKUPD_BADREQUEST
+#define LOOKUPD_MAX_RESULT 1024
+#define LOOKUPD_BATCH 64           // requests queued at once, at most
+#define LOOKUPD_SEND_TIMEOUT_S 5
+#define LOOKUPD_BACKLOG 128
+
+// Response statuses
+#define LOOKUPD_OK 0
+#define LOOKUPD_NOTFOUND 1   // the lookup failed
+#define LOOKUPD_BADREQUEST 2 // empty or too long name
+#define LOOKUPD_SHUTDOWN 3   // the daemon is stopping, not looked up
+
+typedef struct lookupd_s lookupd;
+
+typedef struct lookupd_conn_s {
+    int fd;
+    lookupd* d;
+    pthread_mutex_t lock;        // one response written at a time
+    int broken;                  // a write failed, responses are dropped
+    atomic_int refs;             // the reader, plus requests not yet answered
+    struct lookupd_conn_s* next; // in lookupd.conns while the reader runs
+} lookupd_conn;
+
+// One hostname to resolve, queued as a payload like a name from a file
+typedef struct lookupd_request_s {
+    lookupd_conn* conn;
+    uint32_t id;
+    char name[]; // NUL-terminated
+} lookupd_request;
+
+/* Hands n requests to the resolvers
+ * Returns how many were taken, the rest are answered LOOKUPD_SHUTDOWN
+ */
+typedef int (*lookupd_submit)(void* arg, lookupd_request** reqs, int n);
+
+struct lookupd_s {
+    int listen_fd;
+    int wake[2];                 // self-pipe, written by lookupd_stop()
+    const char* path;
+    int bound;                   // path is our socket, identified by:
+    dev_t sock_dev;
+    ino_t sock_ino;
+    lookupd_submit submit;
+    void* submit_arg;
+    atomic_int stopping;
+    // Connections with a reader running, under lock
+    pthread_mutex_t lock;
+    pthread_cond_t idle;         // signalled when a reader exits
+    lookupd_conn* conns;
+    int readers;
+    // Counters
+    atomic_ulong connections;
+    atomic_ulong requests;
+    atomic_ulong bad_requests;
+    atomic_ulong dropped;        // responses for connections that broke
+};
+
+/* Bind and listen on path (a stale socket file is replaced; a live one, or
+ * anything that isn't a socket, is an error). submit(arg, ...) queues
+ * requests for the resolvers.
+ * Returns 0 on success, -1 on failure
+ */
+int lookupd_listen(lookupd* d, const char* path, lookupd_submit submit, void* arg);
+
+/* Accept connections until lookupd_stop(), then stop reading from every
+ * connection and wait until no reader is left. Requests already queued are
+ * still answered by the resolvers afterwards.
+ * Returns 0, or -1 if accepting failed for good
+ */
+int lookupd_run(lookupd* d);
+
+/* Make lookupd_run() return. Async-signal-safe. */
+void lookupd_stop(lookupd* d);
+
+/* Answer a request with status and result, and free it. Called by the
+ * resolver that looked it up, from any thread.
+ */
+void lookupd_respond(lookupd_request* req, int status, const char* result);
+
+/* Close the socket and remove its file */
+void lookupd_cleanup(lookupd* d);
+
+#endif
@@ -0,0 +1,116 @@
+/* mapinput.c
+ * Akira Youngblood, 2026-10-17
+ * Memory-mapped, zero-copy hostname input for multi-lookup (-m)
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "mapinput.h"
+
+// Delimiters are the bytes fscanf("%s") stops at, plus NUL
+#ifdef __SSE2__
+// Bit i set if byte i of the block is a delimiter, 16 bytes at a time
+static unsigned delim_mask(const char* block) {
+    __m128i x = _mm_load_si128((const __m128i*)block);
+    // '\t'..'\r' are 9..13: subtract 9 and keep what is still <= 4
+    __m128i t = _mm_sub_epi8(x, _mm_set1_epi8(9));
+    __m128i ctl = _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(4)), t);
+    __m128i sp = _mm_cmpeq_epi8(x, _mm_set1_epi8(' '));
+    __m128i nul = _mm_cmpeq_epi8(x, _mm_setzero_si128());
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(ctl, sp), nul));
+}
+#else
+static int is_delim(char c) {
+    return c == '\0' || c == ' ' || (c >= '\t' && c <= '\r');
+}
+#endif
+
+// First byte at or after p (and before limit) that is a delimiter if want is
+// 1, or a name byte if want is 0. Returns limit if there is none.
+static const char* scan(const char* p, const char* limit, int want) {
+#ifdef __SSE2__
+    // Aligned loads never cross a page, but the rest of the block past the
+    // terminator is read too: p must be inside a mapping, or a buffer padded
+    // past the name (see READ_PAD in uring.c), never a plain malloc'ed string
+    unsigned misalign = (uintptr_t)p & 15;
+    const char* block = p - misalign;
+    unsigned m = delim_mask(block);
+    if (!want) m = ~m & 0xFFFF;
+    m &= 0xFFFFu << misalign;
+    for (;;) {
+        if (m) {
+            const char* hit = block + __builtin_ctz(m);
+            return hit < limit ? hit : limit;
+        }
+        block += 16;
+        if (block >= limit) return limit;
+        m = delim_mask(block);
+        if (!want) m = ~m & 0xFFFF;
+    }
+#else
+    while (p < limit && is_delim(*p) != want) p++;
+    return p;
+#endif
+}
+
+int mapinput_open(mapped_file* mf, const char* path) {
+    struct stat st;
+    long page = sysconf(_SC_PAGESIZE);
+    int fd = open(path, O_RDONLY);
+
+    mf->base = NULL;
+    if (fd < 0) return -1;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+    mf->size = st.st_size;
+    // Reserve the file rounded up to pages plus one page of zeros, then map
+    // the file over the front of it
+    mf->reserved = (mf->size + page - 1) / page * page + page;
+    char* base = mmap(NULL, mf->reserved, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    if (mf->size > 0) {
+        if (mmap(base, mf->size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            munmap(base, mf->reserved);
+            close(fd);
+            return -1;
+        }
+        madvise(base, mf->size, MADV_SEQUENTIAL);
+    }
+    close(fd); // the mapping keeps the file alive
+    mf->base = base;
+    return 0;
+}
+
+const char* mapinput_next(const char* cur, const char* end, size_t* len) {
+    const char* name = scan(cur, end, 0);
+    if (name >= end) return NULL;
+    *len = mapinput_name_len(name);
+    return name;
+}
+
+size_t mapinput_name_len(const char* name) {
+    return scan(name, name + MAPINPUT_MAX_NAME, 1) - name;
+}
+
+const char* mapinput_name_end(const char* p, const char* end) {
+    return p < end ? scan(p, end, 1) : end;
+}
+
+void mapinput_close(mapped_file* mf) {
+    if (mf->base) munmap(mf->base, mf->reserved);
+    mf->base = NULL;
+}
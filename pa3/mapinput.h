@@ -0,0 +1,52 @@
+/* mapinput.h
+ * Akira Youngblood, 2026-10-17
+ * Memory-mapped, zero-copy hostname input for multi-lookup (-m)
+ *
+ * An input file is mapped read-only and scanned in place. Hostnames are
+ * handed to resolvers as pointers into the mapping; a name runs until the
+ * next whitespace or NUL byte, so its length can be recovered from the
+ * pointer alone and nothing is allocated or copied per name. The mapping is
+ * followed by at least one page of zeros, so every name is terminated even
+ * when the file doesn't end in a newline, and the vectorized scans can read
+ * a full 16 byte block past the last name.
+ */
+
+#ifndef MAPINPUT_H
+#define MAPINPUT_H
+
+#include <stddef.h>
+
+// Same limit as fscanf("%1024s") in the stdio reader: longer tokens are
+// split into 1024 byte names
+#define MAPINPUT_MAX_NAME 1024
+
+typedef struct mapped_file_s {
+    char* base;      // NULL if the file could not be mapped
+    size_t size;     // file size
+    size_t reserved; // bytes of address space reserved, file + zero pages
+} mapped_file;
+
+/* Map path read-only
+ * Returns 0 on success, -1 on failure (base is NULL then)
+ */
+int mapinput_open(mapped_file* mf, const char* path);
+
+/* Find the next name at or after cur (cur < end)
+ * Returns a pointer to it and sets *len, or NULL when no names are left
+ */
+const char* mapinput_next(const char* cur, const char* end, size_t* len);
+
+/* Length of the name starting at name, up to whitespace, NUL or
+ * MAPINPUT_MAX_NAME. name must point into a mapping: the scan reads 16 byte
+ * blocks, up to 15 bytes past the end of a name.
+ */
+size_t mapinput_name_len(const char* name);
+
+/* First delimiter at or after p, i.e. the end of the name p is in (if any),
+ * or end. Splitting a mapping there never cuts a name in two.
+ */
+const char* mapinput_name_end(const char* p, const char* end);
+
+void mapinput_close(mapped_file* mf);
+
+#endif
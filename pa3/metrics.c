@@ -0,0 +1,146 @@
+/* metrics.c
+ * Akira Youngblood, 2026-10-17
+ * Run metrics for multi-lookup
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "metrics.h"
+
+#define SUB_COUNT (1 << METRICS_SUB_BITS)
+#define SERIES_MAX 2048 // samples kept for the depth series
+
+uint64_t metrics_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// Values below SUB_COUNT get a bucket each. Above that, the top
+// METRICS_SUB_BITS+1 bits pick the bucket within the value's power of two.
+static int bucket_of(uint64_t v) {
+    if (v < SUB_COUNT) return (int)v;
+    int e = 63 - __builtin_clzll(v);
+    int shift = e - METRICS_SUB_BITS;
+    return ((shift + 1) << METRICS_SUB_BITS) + (int)((v >> shift) - SUB_COUNT);
+}
+
+// Middle of bucket i's value range
+static uint64_t value_of(int i) {
+    if (i < SUB_COUNT) return i;
+    int shift = (i >> METRICS_SUB_BITS) - 1;
+    uint64_t low = (uint64_t)((i & (SUB_COUNT - 1)) + SUB_COUNT) << shift;
+    return low + (((uint64_t)1 << shift) >> 1);
+}
+
+void metrics_hist_record(metrics_hist* h, uint64_t value) {
+    h->counts[bucket_of(value)]++;
+    h->total++;
+    h->sum += value;
+    if (value > h->max) h->max = value;
+}
+
+void metrics_hist_merge(metrics_hist* dst, const metrics_hist* src) {
+    int i;
+    for (i = 0; i < METRICS_BUCKETS; ++i) {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->total += src->total;
+    dst->sum += src->sum;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+uint64_t metrics_hist_percentile(const metrics_hist* h, double p) {
+    uint64_t rank, seen = 0;
+    int i;
+    if (h->total == 0) return 0;
+    // Smallest value with at least p% of the samples at or below it
+    rank = (uint64_t)(p / 100.0 * h->total + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > h->total) rank = h->total;
+    for (i = 0; i < METRICS_BUCKETS; ++i) {
+        seen += h->counts[i];
+        if (seen >= rank) break;
+    }
+    uint64_t v = value_of(i);
+    return v < h->max ? v : h->max;
+}
+
+void metrics_thread_start(metrics_thread* m) {
+    memset(m, 0, sizeof(*m));
+    m->start_ns = metrics_now_ns();
+}
+
+void metrics_thread_stop(metrics_thread* m) {
+    m->end_ns = metrics_now_ns();
+}
+
+static void* sampler_main(void* arg) {
+    metrics_sampler* s = arg;
+    struct timespec nap = { s->interval_ms / 1000, (s->interval_ms % 1000) * 1000000L };
+    unsigned long n;
+    for (n = 0; !atomic_load(&s->stop); ++n) {
+        int depth = s->depth(s->arg);
+        metrics_hist_record(&s->hist, depth);
+        if (depth >= s->capacity) s->full++;
+        if (depth == 0) s->empty++;
+        // When the series is full, drop every other point and keep half as
+        // many from now on, so it always covers the whole run
+        if (n % s->stride == 0) {
+            if (s->nseries == s->capseries) {
+                int i;
+                for (i = 0; i < s->nseries / 2; ++i) s->series[i] = s->series[2 * i];
+                s->nseries /= 2;
+                s->stride *= 2;
+            }
+            if (n % s->stride == 0) s->series[s->nseries++] = depth;
+        }
+        nanosleep(&nap, NULL);
+    }
+    return NULL;
+}
+
+int metrics_sampler_start(metrics_sampler* s, int (*depth)(void*), void* arg,
+                          int capacity, int interval_ms) {
+    memset(s, 0, sizeof(*s));
+    s->depth = depth;
+    s->arg = arg;
+    s->capacity = capacity;
+    s->interval_ms = interval_ms > 0 ? interval_ms : 10;
+    s->start_ns = metrics_now_ns();
+    s->stride = 1;
+    s->capseries = SERIES_MAX;
+    s->series = malloc(sizeof(int) * s->capseries);
+    atomic_init(&s->stop, 0);
+    if (s->series == NULL) return -1;
+    if (pthread_create(&s->thread, NULL, sampler_main, s)) {
+        free(s->series);
+        s->series = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+void metrics_sampler_stop(metrics_sampler* s) {
+    atomic_store(&s->stop, 1);
+    pthread_join(s->thread, NULL);
+}
+
+void metrics_sampler_cleanup(metrics_sampler* s) {
+    free(s->series);
+    s->series = NULL;
+}
+
+void metrics_hist_json(FILE* fp, const metrics_hist* h, double scale) {
+    fprintf(fp, "{\"count\": %llu, \"mean\": %.6g, \"p50\": %.6g, \"p90\": %.6g, "
+                "\"p99\": %.6g, \"p999\": %.6g, \"max\": %.6g}",
+            (unsigned long long)h->total,
+            h->total ? (double)h->sum / h->total / scale : 0.0,
+            metrics_hist_percentile(h, 50) / scale,
+            metrics_hist_percentile(h, 90) / scale,
+            metrics_hist_percentile(h, 99) / scale,
+            metrics_hist_percentile(h, 99.9) / scale,
+            h->max / scale);
+}
@@ -0,0 +1,89 @@
+/* metrics.h
+ * Akira Youngblood, 2026-10-17
+ * Run metrics for multi-lookup: wall-clock timers, latency histograms,
+ * queue depth sampling, per-thread counters, and a JSON dump
+ *
+ * Histograms are log-linear like HdrHistogram: every power of two is split
+ * into 64 equal buckets, so any recorded value is reported to within about
+ * 1.6% from a fixed 30 KB table, without storing samples. Each thread
+ * records into its own metrics_thread with no locking, and the tables are
+ * merged once the threads are joined.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define METRICS_SUB_BITS 6
+#define METRICS_BUCKETS ((65 - METRICS_SUB_BITS) << METRICS_SUB_BITS)
+
+typedef struct metrics_hist_s {
+    uint64_t counts[METRICS_BUCKETS];
+    uint64_t total;
+    uint64_t sum;
+    uint64_t max;
+} metrics_hist;
+
+// Counters for one requester or resolver thread
+typedef struct metrics_thread_s {
+    uint64_t start_ns;
+    uint64_t end_ns;
+    unsigned long items;  // names queued (requesters) or resolved (resolvers)
+    uint64_t blocked_ns;  // waiting on the queue: full for requesters,
+                          // empty for resolvers
+    metrics_hist latency; // resolvers: queue pop to result written, ns
+} metrics_thread;
+
+// Queue depth, sampled from a thread of its own at a fixed interval
+typedef struct metrics_sampler_s {
+    int (*depth)(void* arg);
+    void* arg;
+    int capacity;         // queue size, to tell "full" apart
+    int interval_ms;
+    uint64_t start_ns;
+    // Every sample goes into the histogram, a thinned-out series is kept
+    // for plotting
+    metrics_hist hist;
+    unsigned long full;
+    unsigned long empty;
+    int* series;          // depth every stride * interval_ms, from start_ns
+    int stride;           // doubles whenever the series fills up
+    int nseries;
+    int capseries;
+    atomic_int stop;
+    pthread_t thread;
+} metrics_sampler;
+
+/* Monotonic clock in nanoseconds */
+uint64_t metrics_now_ns(void);
+
+void metrics_hist_record(metrics_hist* h, uint64_t value);
+void metrics_hist_merge(metrics_hist* dst, const metrics_hist* src);
+
+/* Value at percentile p (0-100), to histogram precision
+ * Returns 0 for an empty histogram
+ */
+uint64_t metrics_hist_percentile(const metrics_hist* h, double p);
+
+/* Start/stop timing a thread (start_ns/end_ns), zeroing it on start */
+void metrics_thread_start(metrics_thread* m);
+void metrics_thread_stop(metrics_thread* m);
+
+/* Start sampling depth(arg) every interval_ms until metrics_sampler_stop()
+ * Returns 0 on success, -1 on failure
+ */
+int metrics_sampler_start(metrics_sampler* s, int (*depth)(void*), void* arg,
+                          int capacity, int interval_ms);
+void metrics_sampler_stop(metrics_sampler* s);
+void metrics_sampler_cleanup(metrics_sampler* s);
+
+/* Write a histogram as a JSON object (count, mean, max and percentiles,
+ * divided by scale, e.g. 1e6 for ns -> ms)
+ */
+void metrics_hist_json(FILE* fp, const metrics_hist* h, double scale);
+
+#endif
@@ -4,166 +4,1863 @@
  * Based on `pthread_hello.c` from PA3 assignment files
  * All error and debug messages are sent to stderr
  *
- * Uses queue.c/.h and util.c/.h from the PA3 files, unmodified
+ * Uses queue.c/.h and util.c/.h from the PA3 files, queue.c extended with
+ * batched push/pop
+ * Hostnames are handed off through handoff.c/.h, which fronts either
+ * bqueue.c/.h (a blocking wrapper around queue.c), lfqueue.c/.h (a
+ * lock-free ring) or a mesh of spsc.c/.h rings, one per requester and
+ * resolver pair, selected with -q, in batches of up to -b names
+ * With -a, the resolver pool is replaced by a single event-driven thread
+ * using dnsasync.c/.h, which keeps many raw UDP queries in flight at once
+ * Either way, lookups go through the dnscache.c/.h result cache first, and
+ * with -p through the persistent diskcache.c/.h file before the network
+ * Requesters copy hostnames into arenas of their own (arena.c/.h), freed a
+ * chunk at a time once resolvers are done with every name in it; with -M
+ * each name is malloc'ed and freed on its own
+ * With -m, input files are memory-mapped (mapinput.c/.h) and hostnames are
+ * queued as pointers into the mapping instead of copies
+ * With -u, input files are read and output buffers written through io_uring
+ * (uring.c/.h), several large reads and a write per thread in flight at once
+ * Each resolver buffers its results and writes them out in large blocks
+ * (outbuf.c/.h); with -o they go to spill files and are put back in input
+ * order at the end
+ * Timing, latency histograms and queue depth are collected with metrics.c/.h,
+ * printed at exit and with -j written out as JSON
+ * The resolver threads form a pool.c/.h pool that grows and shrinks with
+ * lookup latency and queue backlog, between the -t bounds
+ * With -w, requesters and the queue are replaced by work-stealing workers
+ * (steal.c/.h) that split the mapped input into chunks and resolve names
+ * from deques of their own, stealing from each other when they run dry
+ * With -d, names pass through the dedup.c/.h set first: each unique name is
+ * queued and resolved once, and its result written for every occurrence
+ * Lookups go to getaddrinfo(), or with -r to another dnsbackend.c/.h backend:
+ * raw UDP to one nameserver, an in-memory hosts/zone file table, or answers
+ * made up from a hash of each name (synth), to time the rest of the program
+ * With -T, -R or -H, the backend is wrapped by hedge.c/.h, which makes each
+ * lookup on helper threads with a deadline, retries and a hedged duplicate
+ * With -L or -I, queries to the backend go through ratelimit.c/.h, a token
+ * bucket and an in-flight cap shared by every thread
+ * With -k, each resolver thread runs many lookups at once as coroutines
+ * (coro.c/.h) that park on their sockets and timers instead of blocking,
+ * so thousands can be in flight on a few pinned threads
+ * An input file named - is stdin and an output file named - is stdout, so
+ * the program can sit in a pipeline: results are written as each lookup
+ * completes, and memory stays bounded however long the input runs
+ * With -U, there are no files: the program stays up as a daemon and answers
+ * hostnames sent over a Unix socket (lookupd.c/.h), keeping the pool and
+ * the cache warm between jobs
  */
 
 #include "multi-lookup.h"
 
-// Ratio of threads per core
+// Ratio of threads per core, to start with
 const int threadsPerCore = 4;
+// Resolver pool bounds (-t), 0 until given: cores..maxThreadsPerCore*cores
+int poolMin = 0, poolMax = 0;
+const int maxThreadsPerCore = 64;
+const int maxThreads = 1024;
+pool resolvers;
 
 // Global queue
-const int queueSize = 32; // Size doesn't seem to change much in benchmarking
-queue q;
+int queueSize = 32; // -s, see make bench-sweep
+handoff_kind queueKind = HANDOFF_BLOCKING;
+handoff q;
+// Names moved per queue operation (-b), 1 disables batching. Batches live
+// on the threads' stacks, hence the cap.
+int batchSize = 16;
+const int maxBatchSize = 1024;
 // Global output file
-FILE* outputfp = NULL;
-// Global locks
-pthread_mutex_t queue_lock, output_lock;
+int outputFd = -1;
+// Output isn't a regular file (stdout, a pipe): write each result as soon
+// as it is in rather than a buffer at a time
+int streamOutput = 0;
+// Global output lock (the queue has its own), only taken to flush a buffer
+pthread_mutex_t output_lock;
+// Write results in input order (-o) rather than as they complete
+int orderedOutput = 0;
+// The async resolver thread's state, for its completion callback
+resolver_ctx* asyncCtx = NULL;
+// Metrics as JSON (-j), NULL when not wanted
+const char* metricsPath = NULL;
+
+// Async resolver (-a): nameserver spec, or NULL for the getaddrinfo() pool
+const char* asyncServer = NULL;
+int asyncInflight = 4096; // lookups in flight at once, -n
+int asyncTimeoutMs = 1000; // per try, -T
+int asyncRetries = 2; // -R
+dnsasync engine;
+// Resolver backend behind dnslookup() (-r), NULL for getaddrinfo()
+const char* backendSpec = NULL;
+dnsbackend backend;
+// Deadline per lookup attempt in ms (-T), retries after one (-R) and hedging
+// (-H); any of them wraps the backend in hedge.h. -1 is unset.
+int lookupTimeoutMs = -1;
+int lookupRetries = -1;
+int hedging = 0;
+hedge hedger;
+dnsbackend hedgedBackend;
+// Queries/s to the backend (-L rate[:burst]) and lookups in progress in it
+// at once (-I), 0 for no limit; either wraps the backend in ratelimit.h
+double rateLimit = 0;
+int rateBurst = 0;
+int maxInflight = 0;
+ratelimit limiter;
+dnsbackend limitedBackend;
+
+// Result cache (-c/-N, seconds), -c 0 turns it off
+const int defaultCacheTtl = 300;
+int cacheTtl = 300; // used when the resolver doesn't report a TTL
+int cacheNegativeTtl = 30;
+dnscache cache;
+// Names the cache keeps at most (-C), 0 for no limit. Unset (-1), there is
+// no limit unless a - input could go on forever.
+long cacheMaxNames = -1;
+const long streamCacheNames = 65536;
+// Persistent cache file (-p), NULL when not used
+const char* diskCachePath = NULL;
+diskcache dcache;
+// Resolve each unique name once, answer its other occurrences from that (-d)
+int dedupNames = 0;
+dedup_set dedup;
+// Every address per hostname, IPv4 and IPv6, instead of the first (-A)
+int allAddresses = 0;
+// Memory-mapped input (-m): queued names point into the mapped files
+int inputMapped = 0;
+// Copied names come from the requesters' arenas, or with -M from malloc()
+int nameArenas = 1;
+// File input and output through io_uring (-u), off if it isn't available.
+// Output buffers then write at offsets claimed from outputOffset.
+int ioUring = 0;
+atomic_ullong outputOffset;
+// Inputs and output buffers that got a ring, of those that asked
+atomic_int uringInputs, uringInputsTried, uringOutputs, uringOutputsTried;
+// Coroutine tasks spread over the resolver threads (-k), 0 for a thread per
+// lookup. Each thread then has one per core by default, pinned to it.
+int resolverTasks = 0;
+// Work-stealing workers instead of requesters, resolvers and a queue (-w)
+int workStealing = 0;
+steal_sched sched;
+// Daemon mode (-U): the socket path, NULL when resolving files
+const char* daemonPath = NULL;
+lookupd lookupDaemon;
+
+static void PrintUsage(void) {
+    fprintf(stderr,"Usage:\n"
+                   "  resolve [options] infile [infile2 ...] outfile\n"
+                   "  (- as infile reads stdin, as outfile writes stdout)\n"
+                   "  resolve [options] -U socket\n"
+                   "  (daemon: answers lookups on a Unix socket until SIGINT/SIGTERM)\n"
+                   "Options:\n"
+                   "  -t n|min:max          resolver threads, fixed or sized at runtime between\n"
+                   "                        min and max (default: cores:64*cores, starting at\n"
+                   "                        4*cores)\n"
+                   "  -q blocking|lockfree|mesh\n"
+                   "                        requester/resolver queue (default: blocking); mesh:\n"
+                   "                        a ring per requester and resolver, fixed pool\n"
+                   "  -s size               queue slots, per ring with -q mesh (default: 32)\n"
+                   "  -b count              names moved per queue operation, at most 1024\n"
+                   "                        (default: 16)\n"
+                   "  -a server[:port]      resolve with one async thread talking straight to\n"
+                   "                        this nameserver (\"system\": from /etc/resolv.conf)\n"
+                   "  -n count              lookups in flight with -a (default: 4096)\n"
+                   "  -k count              resolve with count coroutine tasks spread over the\n"
+                   "                        -t threads (default: one per core, pinned), each\n"
+                   "                        parking on its socket; needs -r udp:, hosts: or\n"
+                   "                        synth\n"
+                   "  -r backend            resolver backend: getaddrinfo (default),\n"
+                   "                        udp:server[:port][,timeout=ms][,retries=n],\n"
+                   "                        hosts:file[,latency=ms][,jitter=ms][,fail=pct]\n"
+                   "                        [,seed=n] (hosts or zone file, no network) or\n"
+                   "                        synth[:latency=ms,...] (addresses made from a hash\n"
+                   "                        of each name, no table); both also take\n"
+                   "                        tail=pct,tail_latency=ms (slow share of lookups)\n"
+                   "  -T ms                 give up on a lookup attempt after ms (default: never;\n"
+                   "                        with -a, per try: 1000)\n"
+                   "  -R count              retries after -T runs out, with backoff (default: 0;\n"
+                   "                        with -a: 2)\n"
+                   "  -H                    hedge: repeat a lookup still unanswered after the\n"
+                   "                        p95 latency and take the first answer\n"
+                   "  -L rate[:burst]       send at most rate queries/s to the backend, in\n"
+                   "                        bursts of up to burst (default: rate/10)\n"
+                   "  -I count              lookups in progress in the backend at once, at most\n"
+                   "  -c seconds            cache TTL when the resolver gives none, 0 disables\n"
+                   "                        the cache (default: 300)\n"
+                   "  -N seconds            cache TTL for failed lookups (default: 30)\n"
+                   "  -C names              names the cache keeps at most, 0 for no limit\n"
+                   "                        (default: none, 65536 when reading stdin or with -U)\n"
+                   "  -p file               persistent cache file, created if missing; its\n"
+                   "                        entries keep -c's TTL, 300 s with -c 0\n"
+                   "  -m                    memory-map the input files instead of reading\n"
+                   "                        them with stdio\n"
+                   "  -M                    malloc() each name read on its own instead of\n"
+                   "                        copying it into the requester's arena\n"
+                   "  -u                    read input files and write the output through\n"
+                   "                        io_uring (if available)\n"
+                   "  -w                    work-stealing workers split the (mapped) input\n"
+                   "                        and resolve it, no requesters or shared queue\n"
+                   "  -d                    resolve each unique name (ignoring case) once\n"
+                   "                        and write its result for every occurrence\n"
+                   "  -A                    write every IPv4 and IPv6 address of each name,\n"
+                   "                        comma-separated, instead of the first\n"
+                   "  -o                    write results in input order\n"
+                   "  -U socket             run as a daemon on this Unix socket, see lookupd.h\n"
+                   "  -j file               write run metrics to file as JSON\n");
+}
+
+// Queue depth for the sampler
+static int QueueDepth(void* h) {
+    return handoff_depth((handoff*)h);
+}
+
+// Totals across threads: lookups, their latencies (ns), producer blocked time
+static unsigned long SumResolvers(const resolver_ctx* rlv, int nrlv, metrics_hist* latency) {
+    unsigned long lookups = 0;
+    int i;
+    memset(latency, 0, sizeof(*latency));
+    for (i = 0; i < nrlv; ++i) {
+        lookups += rlv[i].stats.items;
+        metrics_hist_merge(latency, &rlv[i].stats.latency);
+    }
+    return lookups;
+}
+
+static double SumBlocked(const requester_ctx* rqr, int nrqr) {
+    double blocked = 0;
+    int i;
+    for (i = 0; i < nrqr; ++i) {
+        blocked += rqr[i].stats.blocked_ns / 1e9;
+    }
+    return blocked;
+}
+
+// A thread's output buffer: straight to the output file, or with -o to a
+// spill file of its own
+// With -u, a regular file is written through a ring of the buffer's own
+static int SetupOutput(outbuf* out, int* spill) {
+    int rv;
+    *spill = orderedOutput ? outbuf_spill_fd() : -1;
+    if (orderedOutput) {
+        rv = *spill < 0 ? -1 : outbuf_init_spill(out, *spill);
+    } else if (streamOutput) {
+        return outbuf_init_stream(out, outputFd, &output_lock);
+    } else {
+        rv = outbuf_init(out, outputFd, &output_lock, 0);
+    }
+    if (rv == 0 && ioUring) {
+        atomic_fetch_add(&uringOutputsTried, 1);
+        // A spill file is a fresh file of its own, the output is shared
+        if (outbuf_use_uring(out, orderedOutput ? NULL : &outputOffset) == 0) {
+            atomic_fetch_add(&uringOutputs, 1);
+        }
+    }
+    return rv;
+}
+
+// Pool setup callback: give a resolver its id and output buffer just
+// before it first starts, so threads that are never needed cost nothing
+static int SetupResolver(void* ctx, int id) {
+    resolver_ctx* self = (resolver_ctx*)ctx;
+    self->id = id;
+    // A daemon answers on the connections, not in a file
+    if (daemonPath) {
+        self->spill = -1;
+        return 0;
+    }
+    return SetupOutput(&self->out, &self->spill);
+}
+
+// Most memory the process has had resident so far (ru_maxrss is KB on Linux)
+static double PeakRssMb(void) {
+    struct rusage ru;
+    return getrusage(RUSAGE_SELF, &ru) ? 0.0 : ru.ru_maxrss / 1024.0;
+}
+
+static double ThreadSeconds(const metrics_thread* m) {
+    return (m->end_ns - m->start_ns) / 1e9;
+}
+
+static void PrintMetrics(const requester_ctx* rqr, int nrqr, const resolver_ctx* rlv, int nrlv,
+                         const metrics_sampler* depth, double wall) {
+    metrics_hist* latency = malloc(sizeof(metrics_hist));
+    int i;
+    if (latency == NULL) return;
+    unsigned long lookups = SumResolvers(rlv, nrlv, latency);
+    printf("Lookups: %lu, %.1f/s; latency p50 %.1f us, p99 %.1f us, p999 %.1f us, max %.1f us\n",
+           lookups, wall > 0 ? lookups / wall : 0.0,
+           metrics_hist_percentile(latency, 50) / 1e3, metrics_hist_percentile(latency, 99) / 1e3,
+           metrics_hist_percentile(latency, 99.9) / 1e3, latency->max / 1e3);
+    free(latency);
+    if (depth->hist.total > 0) {
+        printf("Queue depth: mean %.1f, p99 %lu, max %lu (full %.1f%%, empty %.1f%% of %lu samples)\n",
+               (double)depth->hist.sum / depth->hist.total,
+               (unsigned long)metrics_hist_percentile(&depth->hist, 99), (unsigned long)depth->hist.max,
+               100.0 * depth->full / depth->hist.total, 100.0 * depth->empty / depth->hist.total,
+               (unsigned long)depth->hist.total);
+    }
+    if (nrqr > 0) {
+        printf("Requesters: %.3f s blocked on a full queue in total (%d threads)\n",
+               SumBlocked(rqr, nrqr), nrqr);
+    }
+    if (allAddresses) {
+        unsigned long v4 = 0, v6 = 0;
+        for (i = 0; i < nrlv; ++i) {
+            v4 += rlv[i].addrs4;
+            v6 += rlv[i].addrs6;
+        }
+        printf("Addresses: %lu IPv4, %lu IPv6\n", v4, v6);
+    }
+    if (resolverTasks) {
+        unsigned long switches = 0;
+        int tasks = 0, peak = 0;
+        for (i = 0; i < nrlv; ++i) {
+            tasks += rlv[i].tasks;
+            switches += rlv[i].switches;
+            peak += rlv[i].peak_waiting;
+        }
+        printf("Tasks: %d coroutines on %d threads, %lu switches, up to %d waiting at once\n",
+               tasks, nrlv, switches, peak);
+    }
+    if (nameArenas && !inputMapped && nrqr > 0) {
+        unsigned long names = 0, chunks = 0;
+        for (i = 0; i < nrqr; ++i) {
+            names += rqr[i].names.names;
+            chunks += rqr[i].names.chunks;
+        }
+        printf("Name arenas: %lu names copied into %lu chunks of %d KB\n",
+               names, chunks, ARENA_CHUNK_SIZE / 1024);
+    }
+    if (workStealing) {
+        unsigned long stolen = 0, races = 0;
+        for (i = 0; i < sched.nworkers; ++i) {
+            stolen += sched.workers[i].stolen;
+            races += sched.workers[i].steal_races;
+        }
+        printf("Work stealing: %d chunks, %lu names stolen, %lu steals lost a race\n",
+               sched.nchunks, stolen, races);
+    }
+    if (resolvers.min < resolvers.max) {
+        printf("Resolver pool: %d-%d threads, started at %d, peak %d, final %d "
+               "(%lu grows, %lu shrinks, %lu undone)\n",
+               resolvers.min, resolvers.max, resolvers.initial, resolvers.peak,
+               atomic_load(&resolvers.target), resolvers.grows, resolvers.shrinks, resolvers.reverts);
+    }
+    for (i = 0; i < nrlv; ++i) {
+        double secs = ThreadSeconds(&rlv[i].stats);
+        printf("Resolver %d: %lu lookups, %.1f/s, %.3f s waiting for names\n",
+               i, rlv[i].stats.items, secs > 0 ? rlv[i].stats.items / secs : 0.0,
+               rlv[i].stats.blocked_ns / 1e9);
+    }
+}
+
+// Write s as a JSON string
+static void JsonString(FILE* fp, const char* s) {
+    fputc('"', fp);
+    for (; *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(fp, "\\%c", c);
+        else if (c < 0x20) fprintf(fp, "\\u%04x", c);
+        else fputc(c, fp);
+    }
+    fputc('"', fp);
+}
+
+static int WriteMetricsJson(const char* path, const requester_ctx* rqr, int nrqr,
+                            const resolver_ctx* rlv, int nrlv, const metrics_sampler* depth,
+                            double wall, double cpu) {
+    metrics_hist* latency = malloc(sizeof(metrics_hist));
+    FILE* fp = fopen(path, "w");
+    int i;
+    if (latency == NULL || fp == NULL) {
+        free(latency);
+        if (fp) fclose(fp);
+        return -1;
+    }
+    unsigned long lookups = SumResolvers(rlv, nrlv, latency);
+    fprintf(fp, "{\n  \"wall_s\": %.6f,\n  \"cpu_s\": %.6f,\n  \"peak_rss_mb\": %.1f,\n",
+            wall, cpu, PeakRssMb());
+    fprintf(fp, "  \"queue\": {\"kind\": \"%s\", \"size\": %d, \"batch\": %d",
+            handoff_kind_name(queueKind), queueSize, batchSize);
+    if (queueKind == HANDOFF_MESH && !workStealing) {
+        fprintf(fp, ", \"rings\": %d", q.u.mesh.producers * q.u.mesh.consumers);
+    }
+    fprintf(fp, "},\n");
+    fprintf(fp, "  \"backend\": \"%s\",\n",
+            asyncServer ? "async" : backendSpec ? backend.name : "getaddrinfo");
+    fprintf(fp, "  \"lookups\": %lu,\n  \"lookups_per_s\": %.3f,\n  \"latency_ms\": ",
+            lookups, wall > 0 ? lookups / wall : 0.0);
+    metrics_hist_json(fp, latency, 1e6);
+    free(latency);
+    fprintf(fp, ",\n  \"queue_depth\": {\"samples\": %lu, \"full_pct\": %.3f, \"empty_pct\": %.3f, \"stats\": ",
+            (unsigned long)depth->hist.total,
+            depth->hist.total ? 100.0 * depth->full / depth->hist.total : 0.0,
+            depth->hist.total ? 100.0 * depth->empty / depth->hist.total : 0.0);
+    metrics_hist_json(fp, &depth->hist, 1);
+    fprintf(fp, ",\n    \"series_interval_ms\": %d, \"series\": [",
+            depth->interval_ms * depth->stride);
+    for (i = 0; i < depth->nseries; ++i) {
+        fprintf(fp, "%s%d", i ? ", " : "", depth->series[i]);
+    }
+    fprintf(fp, "]},\n  \"requesters\": [\n");
+    for (i = 0; i < nrqr; ++i) {
+        fprintf(fp, "    {\"file\": ");
+        JsonString(fp, rqr[i].file_name);
+        fprintf(fp, ", \"names\": %lu, \"elapsed_s\": %.6f, \"blocked_s\": %.6f}%s\n",
+                rqr[i].stats.items, ThreadSeconds(&rqr[i].stats), rqr[i].stats.blocked_ns / 1e9,
+                i + 1 < nrqr ? "," : "");
+    }
+    fprintf(fp, "  ],\n  \"pool\": {\"min\": %d, \"max\": %d, \"initial\": %d, \"peak\": %d, "
+                "\"final\": %d, \"grows\": %lu, \"shrinks\": %lu, \"reverts\": %lu,\n"
+                "    \"history\": [",
+            resolvers.min, resolvers.max, resolvers.initial, resolvers.peak,
+            atomic_load(&resolvers.target), resolvers.grows, resolvers.shrinks, resolvers.reverts);
+    for (i = 0; i < resolvers.nhistory; ++i) {
+        fprintf(fp, "%s[%u, %d]", i ? ", " : "", resolvers.history[i].ms, resolvers.history[i].target);
+    }
+    fprintf(fp, "]},\n  \"resolvers\": [\n");
+    for (i = 0; i < nrlv; ++i) {
+        double secs = ThreadSeconds(&rlv[i].stats);
+        fprintf(fp, "    {\"lookups\": %lu, \"elapsed_s\": %.6f, \"lookups_per_s\": %.3f, "
+                    "\"waiting_s\": %.6f, \"latency_ms\": ",
+                rlv[i].stats.items, secs, secs > 0 ? rlv[i].stats.items / secs : 0.0,
+                rlv[i].stats.blocked_ns / 1e9);
+        metrics_hist_json(fp, &rlv[i].stats.latency, 1e6);
+        fprintf(fp, "}%s\n", i + 1 < nrlv ? "," : "");
+    }
+    fprintf(fp, "  ]");
+    if (cacheTtl > 0) {
+        fprintf(fp, ",\n  \"cache\": {\"hits\": %lu, \"misses\": %lu, \"coalesced\": %lu, "
+                    "\"limit\": %ld, \"evictions\": %lu}",
+                atomic_load(&cache.hits), atomic_load(&cache.misses), atomic_load(&cache.coalesced),
+                cacheMaxNames, atomic_load(&cache.evictions));
+    }
+    if (dedupNames) {
+        fprintf(fp, ",\n  \"names\": {\"total\": %lu, \"unique\": %lu}",
+                atomic_load(&dedup.total), atomic_load(&dedup.unique));
+    }
+    if (diskCachePath) {
+        fprintf(fp, ",\n  \"cache_file\": {\"hits\": %lu, \"stores\": %lu}",
+                atomic_load(&dcache.hits), atomic_load(&dcache.stores));
+    }
+    if (allAddresses) {
+        unsigned long v4 = 0, v6 = 0;
+        for (i = 0; i < nrlv; ++i) {
+            v4 += rlv[i].addrs4;
+            v6 += rlv[i].addrs6;
+        }
+        fprintf(fp, ",\n  \"addresses\": {\"ipv4\": %lu, \"ipv6\": %lu}", v4, v6);
+    }
+    if (nameArenas && !inputMapped && nrqr > 0) {
+        unsigned long names = 0, chunks = 0;
+        for (i = 0; i < nrqr; ++i) {
+            names += rqr[i].names.names;
+            chunks += rqr[i].names.chunks;
+        }
+        fprintf(fp, ",\n  \"arenas\": {\"chunk_bytes\": %d, \"chunks\": %lu, \"names\": %lu}",
+                ARENA_CHUNK_SIZE, chunks, names);
+    }
+    if (resolverTasks) {
+        fprintf(fp, ",\n  \"tasks\": {\"stack_bytes\": %d, \"threads\": [", CORO_STACK_SIZE);
+        for (i = 0; i < nrlv; ++i) {
+            fprintf(fp, "%s{\"tasks\": %d, \"switches\": %lu, \"peak_waiting\": %d}", i ? ", " : "",
+                    rlv[i].tasks, rlv[i].switches, rlv[i].peak_waiting);
+        }
+        fprintf(fp, "]}");
+    }
+    if (workStealing) {
+        fprintf(fp, ",\n  \"steal\": {\"chunk_bytes\": %d, \"chunks\": %d, \"workers\": [",
+                STEAL_CHUNK_SIZE, sched.nchunks);
+        for (i = 0; i < sched.nworkers; ++i) {
+            fprintf(fp, "%s{\"chunks\": %lu, \"stolen\": %lu, \"races\": %lu}", i ? ", " : "",
+                    sched.workers[i].chunks, sched.workers[i].stolen, sched.workers[i].steal_races);
+        }
+        fprintf(fp, "]}");
+    }
+    if (limitedBackend.lookup) {
+        fprintf(fp, ",\n  \"ratelimit\": {\"rate\": %g, \"burst\": %d, \"max_inflight\": %d, "
+                    "\"queries\": %lu, \"rate_waits\": %lu, \"rate_wait_s\": %.6f, "
+                    "\"inflight_waits\": %lu, \"inflight_wait_s\": %.6f, \"peak_inflight\": %d}",
+                rateLimit, limiter.burst, maxInflight, atomic_load(&limiter.queries),
+                atomic_load(&limiter.rate_waits), atomic_load(&limiter.rate_wait_ns) / 1e9,
+                atomic_load(&limiter.inflight_waits), atomic_load(&limiter.inflight_wait_ns) / 1e9,
+                atomic_load(&limiter.peak_inflight));
+    }
+    if (hedgedBackend.lookup) {
+        fprintf(fp, ",\n  \"deadlines\": {\"timeout_ms\": %d, \"retries\": %d, \"hedging\": %d, "
+                    "\"lookups\": %lu, \"attempts\": %lu, \"timeouts\": %lu, \"deadlines_missed\": %lu, "
+                    "\"retries_sent\": %lu, \"hedges\": %lu, \"hedge_wins\": %lu, \"late\": %lu, "
+                    "\"hedge_delay_ms\": %.3f}",
+                hedger.timeout_ms, hedger.retries, hedger.hedging,
+                atomic_load(&hedger.lookups), atomic_load(&hedger.attempts),
+                atomic_load(&hedger.timeouts), atomic_load(&hedger.deadlines),
+                atomic_load(&hedger.retries_sent), atomic_load(&hedger.hedges),
+                atomic_load(&hedger.hedge_wins), atomic_load(&hedger.late),
+                atomic_load(&hedger.hedge_ns) / 1e6);
+    }
+    if (ioUring) {
+        fprintf(fp, ",\n  \"io_uring\": {\"inputs\": %d, \"inputs_tried\": %d, "
+                    "\"outputs\": %d, \"outputs_tried\": %d}",
+                atomic_load(&uringInputs), atomic_load(&uringInputsTried),
+                atomic_load(&uringOutputs), atomic_load(&uringOutputsTried));
+    }
+    if (daemonPath) {
+        fprintf(fp, ",\n  \"daemon\": {\"connections\": %lu, \"requests\": %lu, "
+                    "\"bad_requests\": %lu, \"dropped\": %lu}",
+                atomic_load(&lookupDaemon.connections), atomic_load(&lookupDaemon.requests),
+                atomic_load(&lookupDaemon.bad_requests), atomic_load(&lookupDaemon.dropped));
+    }
+    if (asyncServer) {
+        fprintf(fp, ",\n  \"async\": {\"sent\": %lu, \"retransmits\": %lu, \"timeouts\": %lu}",
+                engine.sent, engine.retransmits, engine.timeouts);
+    }
+    fprintf(fp, "\n}\n");
+    return fclose(fp) ? -1 : 0;
+}
+
+// Daemon: queue requests from a connection like names from a file
+static int SubmitRequests(void* arg, lookupd_request** reqs, int n) {
+    void* batch[LOOKUPD_BATCH];
+    (void)arg;
+    memcpy(batch, reqs, n * sizeof(void*));
+    return handoff_push_batch(&q, batch, n);
+}
+
+static void StopDaemon(int sig) {
+    (void)sig;
+    lookupd_stop(&lookupDaemon);
+}
 
 int main(int argc, char *argv[]) {
-    int i, rv;
+    int i, rv, opt;
     clock_t tic = clock();
+    uint64_t wall_tic = metrics_now_ns();
+    metrics_sampler depth;
+    // Parse command-line options
+    while ((opt = getopt(argc, argv, "t:q:s:b:a:n:k:r:T:R:HL:I:c:N:C:p:mMuwdAoj:U:")) != -1) {
+        switch (opt) {
+            case 't':
+                if (pool_parse_bounds(optarg, &poolMin, &poolMax) || poolMax > maxThreads) {
+                    fprintf(stderr,"Invalid thread count: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'q':
+                if (handoff_parse_kind(optarg, &queueKind)) {
+                    fprintf(stderr,"Unknown queue type: %s\n", optarg);
+                    PrintUsage();
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 's':
+                queueSize = atoi(optarg);
+                if (queueSize <= 0) {
+                    fprintf(stderr,"Invalid queue size: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'b':
+                batchSize = atoi(optarg);
+                if (batchSize <= 0 || batchSize > maxBatchSize) {
+                    fprintf(stderr,"Invalid batch size: %s (1 to %d)\n", optarg, maxBatchSize);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'a':
+                asyncServer = optarg;
+                break;
+            case 'n':
+                asyncInflight = atoi(optarg);
+                if (asyncInflight <= 0) {
+                    fprintf(stderr,"Invalid in-flight count: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'k':
+                resolverTasks = atoi(optarg);
+                if (resolverTasks <= 0) {
+                    fprintf(stderr,"Invalid task count: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'r':
+                backendSpec = optarg;
+                break;
+            case 'T':
+                lookupTimeoutMs = atoi(optarg);
+                if (lookupTimeoutMs <= 0) {
+                    fprintf(stderr,"Invalid timeout: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'R':
+                lookupRetries = atoi(optarg);
+                if (lookupRetries < 0) {
+                    fprintf(stderr,"Invalid retry count: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'H':
+                hedging = 1;
+                break;
+            case 'L':
+                if (ratelimit_parse(optarg, &rateLimit, &rateBurst)) {
+                    fprintf(stderr,"Invalid rate limit: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'I':
+                maxInflight = atoi(optarg);
+                if (maxInflight <= 0) {
+                    fprintf(stderr,"Invalid in-flight cap: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'c':
+                cacheTtl = atoi(optarg);
+                break;
+            case 'N':
+                cacheNegativeTtl = atoi(optarg);
+                break;
+            case 'C':
+                cacheMaxNames = atol(optarg);
+                if (cacheMaxNames < 0) {
+                    fprintf(stderr,"Invalid cache size: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'p':
+                diskCachePath = optarg;
+                break;
+            case 'm':
+                inputMapped = 1;
+                break;
+            case 'M':
+                nameArenas = 0;
+                break;
+            case 'u':
+                ioUring = 1;
+                break;
+            case 'w':
+                workStealing = 1;
+                inputMapped = 1; // workers find names in the mappings
+                break;
+            case 'd':
+                dedupNames = 1;
+                break;
+            case 'A':
+                allAddresses = 1;
+                break;
+            case 'o':
+                orderedOutput = 1;
+                break;
+            case 'j':
+                metricsPath = optarg;
+                break;
+            case 'U':
+                daemonPath = optarg;
+                break;
+            default:
+                PrintUsage();
+                return EXIT_FAILURE;
+        }
+    }
     // Parse command-line arguments
-    if (argc <= 2) {
+    if (daemonPath) {
+        // Names come from the socket, results go back on it
+        if (argc - optind > 0) {
+            fprintf(stderr,"-U takes no input or output files.\n");
+            PrintUsage();
+            return EXIT_FAILURE;
+        }
+        // Every option that works on whole files, or replaces the queue
+        if (inputMapped || orderedOutput || dedupNames || asyncServer || ioUring ||
+            queueKind == HANDOFF_MESH) {
+            fprintf(stderr,"-U can't be combined with -m, -w, -o, -d, -a, -u or -q mesh.\n");
+            return EXIT_FAILURE;
+        }
+    } else if (argc - optind < 2) {
         // Need at least two file names (in and out), warn and print usage
         fprintf(stderr,"Not enough arguments provided.\n");
-        fprintf(stderr,"Usage:\n"
-                       "  resolve infile [infile2 ...] outfile\n");
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+    // Mapped names and daemon requests aren't copied at all
+    if (!nameArenas && (inputMapped || daemonPath)) {
+        fprintf(stderr,"-M can't be combined with -m, -w or -U.\n");
+        return EXIT_FAILURE;
+    }
+    if (workStealing && asyncServer) {
+        fprintf(stderr,"-w and -a can't be combined.\n");
+        return EXIT_FAILURE;
+    }
+    // The async resolver is a backend of its own
+    if (backendSpec && asyncServer) {
+        fprintf(stderr,"-r and -a can't be combined.\n");
+        return EXIT_FAILURE;
+    }
+    // The async resolver has its own timeouts and retries (-T and -R set
+    // them), and one thread can't wait on a hedge
+    if (hedging && asyncServer) {
+        fprintf(stderr,"-H can't be combined with -a.\n");
+        return EXIT_FAILURE;
+    }
+    // The async resolver's window is its in-flight cap (-n)
+    if ((rateLimit > 0 || maxInflight > 0) && asyncServer) {
+        fprintf(stderr,"-L and -I can't be combined with -a (-n caps its lookups in flight).\n");
+        return EXIT_FAILURE;
+    }
+    // Tasks replace the resolver threads' lookups; anything that blocks a
+    // whole thread per lookup would hold up every task on it
+    if (resolverTasks && (asyncServer || workStealing || daemonPath)) {
+        fprintf(stderr,"-k can't be combined with -a, -w or -U.\n");
+        return EXIT_FAILURE;
+    }
+    if (resolverTasks && (lookupTimeoutMs > 0 || lookupRetries >= 0 || hedging || maxInflight > 0)) {
+        fprintf(stderr,"-k can't be combined with -T, -R, -H or -I (the udp backend has its own "
+                       "timeout and retries, -k caps lookups in flight).\n");
+        return EXIT_FAILURE;
+    }
+    if (lookupRetries > 0 && lookupTimeoutMs < 0 && !asyncServer) {
+        fprintf(stderr,"-R retries lookups that time out, it needs -T.\n");
+        return EXIT_FAILURE;
+    }
+    // The async resolver only asks for A records, and cache file slots hold
+    // a single address
+    if (allAddresses && (asyncServer || diskCachePath)) {
+        fprintf(stderr,"-A can't be combined with -a or -p.\n");
+        return EXIT_FAILURE;
+    }
+    // stdin can't be mapped or read a second time (-o replays the inputs),
+    // and -d remembers every name it has seen
+    int streamInput = 0;
+    for (i = optind; i < argc-1; ++i) {
+        if (strcmp(argv[i], "-") == 0) streamInput++;
+    }
+    if (streamInput && (inputMapped || orderedOutput || dedupNames)) {
+        fprintf(stderr,"Reading stdin (-) can't be combined with -m, -w, -o or -d.\n");
+        return EXIT_FAILURE;
+    }
+    if (streamInput > 1) {
+        fprintf(stderr,"stdin (-) can only be read once.\n");
         return EXIT_FAILURE;
     }
     // We have at least one input file and an output file
     // Open the output file
-    outputfp = fopen(argv[argc-1],"w");
-    if (!outputfp) {
+    if (daemonPath) {
+        // Bind before any threads exist, a socket in use is an early exit
+        if (lookupd_listen(&lookupDaemon, daemonPath, SubmitRequests, NULL)) {
+            fprintf(stderr,"Error: unable to listen on %s\n", daemonPath);
+            return EXIT_FAILURE;
+        }
+    } else if (strcmp(argv[argc-1], "-") == 0) {
+        // Results go to stdout, so the summary (printed to stdout) moves to
+        // stderr: keep a descriptor for the real stdout and point fd 1 at
+        // stderr
+        outputFd = dup(STDOUT_FILENO);
+        if (outputFd >= 0 && dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+            close(outputFd);
+            outputFd = -1;
+        }
+    } else {
+        outputFd = open(argv[argc-1], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (outputFd < 0 && !daemonPath) {
         fprintf(stderr,"Unable to open output file, exiting.\n");
         return EXIT_FAILURE;
     }
-    // Initialize the queue
-    if (queue_init(&q,queueSize) == QUEUE_FAILURE){
-        fprintf(stderr,"Error: queue_init failed!\n");
+    struct stat outputStat;
+    streamOutput = !daemonPath && fstat(outputFd, &outputStat) == 0 && !S_ISREG(outputStat.st_mode);
+    if (ioUring && !uring_supported()) {
+        fprintf(stderr,"io_uring isn't available, reading and writing files as usual.\n");
+        ioUring = 0;
+    }
+    atomic_init(&outputOffset, 0); // truncated when opened
+    // Set up the async resolver before any threads exist
+    if (asyncServer) {
+        struct sockaddr_storage server;
+        if (lookupTimeoutMs > 0) asyncTimeoutMs = lookupTimeoutMs;
+        if (lookupRetries >= 0) asyncRetries = lookupRetries;
+        socklen_t serverlen;
+        if (dnsasync_parse_server(asyncServer, &server, &serverlen) == DNS_FAILURE ||
+            dnsasync_init(&engine, (struct sockaddr*)&server, serverlen, asyncInflight,
+                          asyncTimeoutMs, asyncRetries) == DNS_FAILURE) {
+            fprintf(stderr,"Error: unable to start async resolver!\n");
+            return EXIT_FAILURE;
+        }
+    }
+    // The backend, then the limits on what is sent to it, then deadlines
+    // around that: every retry or hedge is one more query to limit
+    const dnsbackend* upstream = NULL;
+    if (backendSpec) {
+        if (dnsbackend_open(&backend, backendSpec)) {
+            fprintf(stderr,"Error: unable to set up resolver backend %s\n", backendSpec);
+            return EXIT_FAILURE;
+        }
+        upstream = &backend;
+    }
+    if (resolverTasks && backend.lookup == NULL) {
+        fprintf(stderr,"-k needs a backend its tasks can wait on: -r udp:, -r hosts: or -r synth.\n");
+        return EXIT_FAILURE;
+    }
+    if (rateLimit > 0 || maxInflight > 0) {
+        if (ratelimit_init(&limiter, upstream, rateLimit, rateBurst, maxInflight, &limitedBackend)) {
+            fprintf(stderr,"Error: ratelimit_init failed!\n");
+            return EXIT_FAILURE;
+        }
+        upstream = &limitedBackend;
+    }
+    if (!asyncServer && (lookupTimeoutMs > 0 || hedging)) {
+        if (hedge_init(&hedger, upstream, lookupTimeoutMs > 0 ? lookupTimeoutMs : 0,
+                       lookupRetries > 0 ? lookupRetries : 0, hedging, &hedgedBackend)) {
+            fprintf(stderr,"Error: hedge_init failed!\n");
+            return EXIT_FAILURE;
+        }
+        upstream = &hedgedBackend;
+    }
+    dnslookup_set_backend(upstream);
+    if (diskCachePath && diskcache_open(&dcache, diskCachePath, 0)) {
+        fprintf(stderr,"Error: unable to use cache file %s\n", diskCachePath);
+        return EXIT_FAILURE;
+    }
+    if (cacheTtl > 0 && dnscache_init(&cache, cacheTtl, cacheNegativeTtl)) {
+        fprintf(stderr,"Error: dnscache_init failed!\n");
+        return EXIT_FAILURE;
+    }
+    // A daemon runs as long as stdin might, bound it alike
+    if (cacheMaxNames < 0) cacheMaxNames = streamInput || daemonPath ? streamCacheNames : 0;
+    if (cacheTtl > 0) dnscache_limit(&cache, cacheMaxNames);
+    if (dedupNames && dedup_init(&dedup)) {
+        fprintf(stderr,"Error: dedup_init failed!\n");
         return EXIT_FAILURE;
     }
-    // Initialize the locks
-    if (pthread_mutex_init(&queue_lock,NULL) || pthread_mutex_init(&output_lock,NULL)) {
+    // Initialize the output lock
+    if (pthread_mutex_init(&output_lock,NULL)) {
         fprintf(stderr,"Error: pthread_mutex_init failed!\n");
         return EXIT_FAILURE;
     }
     // Create a requester thread pool based on number of input files
     // Some may be invalid, but that is handled by the threads
-    const int NUM_THREADS_RQR = argc-2;
-    pthread_t threads_rqr[NUM_THREADS_RQR];
-    for (i = 0; i < NUM_THREADS_RQR; ++i) {
-        // Create the thread and make sure it was created, pass the filename
-        rv = pthread_create(&(threads_rqr[i]), NULL, RequesterThreadAction, argv[i+1]);
-        if (rv) {
-            fprintf(stderr,"Error: failed to create requester thread %d, rv = %d\n", i, rv);
-            exit(EXIT_FAILURE);
-        }
+    // (a daemon has none, its connections' readers take their place)
+    const int NUM_THREADS_RQR = daemonPath ? 0 : argc-optind-1;
+    pthread_t threads_rqr[NUM_THREADS_RQR > 0 ? NUM_THREADS_RQR : 1];
+    requester_ctx* rqr = calloc(NUM_THREADS_RQR > 0 ? NUM_THREADS_RQR : 1, sizeof(requester_ctx));
+    if (rqr == NULL) {
+        fprintf(stderr,"Out of memory.\n");
+        return EXIT_FAILURE;
     }
-    // Create a resolver thread pool based on number of cores
+    // Size the resolver thread pool based on number of cores
     // This is not entirely portable, but hopefully "portable enough"
     const int NUM_CORES = sysconf(_SC_NPROCESSORS_ONLN);
-    const int NUM_THREADS_RLV = threadsPerCore*NUM_CORES;
-    pthread_t threads_rlv[NUM_THREADS_RLV];
-    fprintf(stderr, "Detected %d cores, using %d threads\n",NUM_CORES,NUM_THREADS_RLV);
-    for (i = 0; i < NUM_THREADS_RLV; ++i) {
-        // Create the thread and make sure it was created, pass the file pointer
-        rv = pthread_create(&(threads_rlv[i]),NULL, ResolverThreadAction, outputfp);
-        if (rv) {
-            fprintf(stderr,"Error: failed to create resolver %d, rv = %d\n", i, rv);
-            exit(EXIT_FAILURE);
+    // Lookups mostly wait on the network, so the pool starts at a few threads
+    // per core and is resized from there as latency and backlog dictate.
+    // The async resolver needs just one thread no matter how many cores, and
+    // work-stealing workers (-w) and mesh consumers (-q mesh, each owns rings
+    // only it drains) don't resize: -t n, or the upper bound.
+    int initial = threadsPerCore*NUM_CORES;
+    if (asyncServer) {
+        poolMin = poolMax = initial = 1;
+    } else if (resolverTasks) {
+        // A thread per core is plenty when none of them block; never more
+        // threads than tasks
+        if (poolMax == 0) poolMax = NUM_CORES;
+        if (poolMax > resolverTasks) poolMax = resolverTasks;
+        poolMin = initial = poolMax;
+    } else if (workStealing || queueKind == HANDOFF_MESH) {
+        if (poolMax == 0) poolMax = initial;
+        poolMin = initial = poolMax;
+    } else if (poolMax == 0) {
+        poolMin = NUM_CORES;
+        poolMax = maxThreadsPerCore*NUM_CORES;
+        if (poolMax > maxThreads) poolMax = maxThreads;
+    }
+    // Initialize the queue, a mesh for exactly the requesters and resolvers
+    const int QUEUE_CAPACITY = queueKind == HANDOFF_MESH
+                             ? handoff_init_mesh(&q,queueSize,NUM_THREADS_RQR,poolMax)
+                             : handoff_init(&q,queueKind,queueSize);
+    if (QUEUE_CAPACITY == QUEUE_FAILURE){
+        fprintf(stderr,"Error: handoff_init failed!\n");
+        return EXIT_FAILURE;
+    }
+    // With -m (and -w), map every input up front; mappings stay until the end
+    // With -d, requesters answer duplicates of resolved names themselves
+    const int requesterOutput = dedupNames && !workStealing;
+    for (i = 0; i < NUM_THREADS_RQR; ++i) {
+        rqr[i].file_name = argv[optind+i];
+        arena_init(&rqr[i].names);
+        if (inputMapped && mapinput_open(&rqr[i].input, argv[optind+i])) {
+            fprintf(stderr,"Failed to open input file %s\n",argv[optind+i]);
+        }
+        if (requesterOutput && SetupOutput(&rqr[i].out, &rqr[i].spill)) {
+            fprintf(stderr,"Error: unable to set up output buffers!\n");
+            return EXIT_FAILURE;
         }
     }
+    if (workStealing) {
+        // The workers take the input straight from the mappings, in chunks
+        if (steal_init(&sched, poolMax)) {
+            fprintf(stderr,"Error: steal_init failed!\n");
+            return EXIT_FAILURE;
+        }
+        for (i = 0; i < NUM_THREADS_RQR; ++i) {
+            if (steal_add_input(&sched, &rqr[i].input)) {
+                fprintf(stderr,"Out of memory.\n");
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    // Sample the queue depth (with -w, names waiting in deques) for as long
+    // as the threads run
+    if (workStealing ? metrics_sampler_start(&depth, steal_depth, &sched, poolMax*STEAL_DEQUE_SIZE, 10)
+                     : metrics_sampler_start(&depth, QueueDepth, &q, QUEUE_CAPACITY, 10)) {
+        fprintf(stderr,"Error: unable to start queue depth sampler!\n");
+        return EXIT_FAILURE;
+    }
+    if (!workStealing) {
+        // Register every requester before any of them can finish, the last
+        // one to finish closes the queue (end-of-input protocol, see handoff.h)
+        handoff_add_producers(&q, daemonPath ? 1 : NUM_THREADS_RQR);
+        for (i = 0; i < NUM_THREADS_RQR; ++i) {
+            // Create the thread and make sure it was created, pass its state
+            rv = pthread_create(&(threads_rqr[i]), NULL,
+                                inputMapped ? MappedRequesterThreadAction :
+                                strcmp(rqr[i].file_name, "-") == 0 ? StreamRequesterThreadAction :
+                                ioUring ? UringRequesterThreadAction :
+                                RequesterThreadAction, &rqr[i]);
+            if (rv) {
+                fprintf(stderr,"Error: failed to create requester thread %d, rv = %d\n", i, rv);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    // One output buffer per resolver, each writing straight to the output
+    // file, or with -o to its own spill file
+    resolver_ctx* rlv = calloc(poolMax, sizeof(resolver_ctx));
+    if (rlv == NULL ||
+        pool_init(&resolvers, poolMin, poolMax, initial,
+                  asyncServer ? AsyncResolverThreadAction :
+                  resolverTasks ? TaskResolverThreadAction :
+                  workStealing ? WorkerThreadAction :
+                  daemonPath ? DaemonResolverThreadAction : ResolverThreadAction,
+                  SetupResolver, rlv, sizeof(resolver_ctx), QueueDepth, &q, QUEUE_CAPACITY)) {
+        fprintf(stderr,"Error: unable to set up the resolver pool!\n");
+        return EXIT_FAILURE;
+    }
+    if (backendSpec) {
+        fprintf(stderr, "Resolver backend: %s\n",backendSpec);
+    }
+    if (limitedBackend.lookup) {
+        if (rateLimit > 0) fprintf(stderr, "Rate limit: %g queries/s, burst %d", rateLimit, limiter.burst);
+        else fprintf(stderr, "Rate limit: none");
+        if (maxInflight > 0) fprintf(stderr, ", at most %d in flight\n", maxInflight);
+        else fprintf(stderr, "\n");
+    }
+    if (hedgedBackend.lookup) {
+        if (hedger.timeout_ms) {
+            fprintf(stderr, "Lookup deadline: %d ms, %d retries", hedger.timeout_ms, hedger.retries);
+        } else {
+            fprintf(stderr, "Lookup deadline: none");
+        }
+        fprintf(stderr, ", hedging %s\n", hedging ? "on" : "off");
+    }
+    if (asyncServer) {
+        fprintf(stderr, "Async resolver via %s, up to %d lookups in flight\n",asyncServer,engine.max_inflight);
+    } else if (resolverTasks) {
+        fprintf(stderr, "Detected %d cores, using %d tasks on %d threads\n",
+                NUM_CORES,resolverTasks,poolMax);
+    } else if (workStealing) {
+        fprintf(stderr, "Detected %d cores, using %d work-stealing workers on %d chunks\n",
+                NUM_CORES,poolMax,sched.nchunks);
+    } else if (poolMin < poolMax) {
+        fprintf(stderr, "Detected %d cores, using %d-%d threads, starting with %d\n",
+                NUM_CORES,poolMin,poolMax,resolvers.initial);
+    } else {
+        fprintf(stderr, "Detected %d cores, using %d threads\n",NUM_CORES,poolMax);
+    }
+    if (pool_start(&resolvers)) {
+        fprintf(stderr,"Error: failed to create resolver threads\n");
+        exit(EXIT_FAILURE);
+    }
 
+    if (daemonPath) {
+        // Serve until told to stop, then let the resolvers answer what was
+        // already queued. The daemon counts as the one producer.
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = StopDaemon;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+        fprintf(stderr, "Listening on %s\n", daemonPath);
+        if (lookupd_run(&lookupDaemon)) {
+            fprintf(stderr,"Error: daemon stopped accepting connections\n");
+        }
+        handoff_producer_done(&q);
+    }
     // Wait for requester threads to finish
-    for (i = 0; i < NUM_THREADS_RQR; ++i) {
+    for (i = 0; i < NUM_THREADS_RQR && !workStealing; ++i) {
         pthread_join(threads_rqr[i],NULL);
     }
-    // Wait for resolver threads to finish
+    // Input is all queued, let every resolver help drain the queue and wait
+    // for them to finish
+    pool_finish(&resolvers);
+    pool_join(&resolvers);
+    const int NUM_THREADS_RLV = resolvers.created;
+    metrics_sampler_stop(&depth);
+    // We are done, flush what the resolvers left buffered
     for (i = 0; i < NUM_THREADS_RLV; ++i) {
-        pthread_join(threads_rlv[i],NULL);
+        outbuf_cleanup(&rlv[i].out);
+    }
+    for (i = 0; i < NUM_THREADS_RQR && requesterOutput; ++i) {
+        outbuf_cleanup(&rqr[i].out);
     }
-    // We are done, close the output file and clean up
-    fclose(outputfp);
-    pthread_mutex_destroy(&queue_lock);
+    if (orderedOutput) {
+        const int NUM_SPILLS = NUM_THREADS_RLV + (requesterOutput ? NUM_THREADS_RQR : 0);
+        int spills[NUM_SPILLS];
+        for (i = 0; i < NUM_SPILLS; ++i) {
+            spills[i] = i < NUM_THREADS_RLV ? rlv[i].spill : rqr[i - NUM_THREADS_RLV].spill;
+        }
+        if (outbuf_merge_ordered(outputFd, spills, NUM_SPILLS, argv + optind, NUM_THREADS_RQR)) {
+            fprintf(stderr,"Error: unable to write ordered output!\n");
+        }
+        for (i = 0; i < NUM_SPILLS; ++i) {
+            close(spills[i]);
+        }
+    }
+    // Close the output file and clean up
+    if (daemonPath) lookupd_cleanup(&lookupDaemon);
+    else close(outputFd);
     pthread_mutex_destroy(&output_lock);
-    queue_cleanup(&q);
+    handoff_cleanup(&q);
+    if (inputMapped) {
+        // Resolvers are done with the names, the mappings can go
+        for (i = 0; i < NUM_THREADS_RQR; ++i) {
+            mapinput_close(&rqr[i].input);
+        }
+    }
     // Print benchmarking info
     clock_t toc = clock();
-    printf("Elapsed: %f s (%d resolver threads, queue size: %d)\n", (double)(toc - tic)/CLOCKS_PER_SEC, NUM_THREADS_RLV, queueSize);
+    double wall = (metrics_now_ns() - wall_tic) / 1e9;
+    double cpu = (double)(toc - tic)/CLOCKS_PER_SEC;
+    if (asyncServer) {
+        printf("Async: %lu queries sent, %lu retransmits, %lu timeouts\n",
+               engine.sent, engine.retransmits, engine.timeouts);
+    }
+    if (limitedBackend.lookup) {
+        printf("Rate limit: %lu queries (%.1f/s); %lu waited for a token, %.3f s in total; "
+               "%lu waited for a slot, %.3f s in total (peak %d in flight)\n",
+               atomic_load(&limiter.queries), wall > 0 ? atomic_load(&limiter.queries) / wall : 0.0,
+               atomic_load(&limiter.rate_waits), atomic_load(&limiter.rate_wait_ns) / 1e9,
+               atomic_load(&limiter.inflight_waits), atomic_load(&limiter.inflight_wait_ns) / 1e9,
+               atomic_load(&limiter.peak_inflight));
+    }
+    if (hedgedBackend.lookup) {
+        printf("Deadlines: %lu lookups in %lu attempts, %lu timed out (%lu deadlines missed, "
+               "%lu retries), %lu hedges, %lu won, %lu late answers\n",
+               atomic_load(&hedger.lookups), atomic_load(&hedger.attempts),
+               atomic_load(&hedger.timeouts), atomic_load(&hedger.deadlines),
+               atomic_load(&hedger.retries_sent), atomic_load(&hedger.hedges),
+               atomic_load(&hedger.hedge_wins), atomic_load(&hedger.late));
+    }
+    if (ioUring) {
+        printf("io_uring: %d of %d input files, %d of %d output buffers\n",
+               atomic_load(&uringInputs), atomic_load(&uringInputsTried),
+               atomic_load(&uringOutputs), atomic_load(&uringOutputsTried));
+    }
+    if (daemonPath) {
+        printf("Daemon: %lu connections, %lu requests (%lu bad), %lu responses dropped\n",
+               atomic_load(&lookupDaemon.connections), atomic_load(&lookupDaemon.requests),
+               atomic_load(&lookupDaemon.bad_requests), atomic_load(&lookupDaemon.dropped));
+    }
+    printf("Elapsed: %f s wall, %f s CPU (%d resolver threads, queue size: %d, queue: %s, batch: %d)\n", wall, cpu, NUM_THREADS_RLV, queueSize, handoff_kind_name(queueKind), batchSize);
+    printf("Memory: %.1f MB peak RSS\n", PeakRssMb());
+    if (queueKind == HANDOFF_MESH && !workStealing) {
+        printf("Mesh: %d rings (%d requesters x %d resolvers), %d slots each\n",
+               q.u.mesh.producers * q.u.mesh.consumers, q.u.mesh.producers, q.u.mesh.consumers,
+               QUEUE_CAPACITY / (q.u.mesh.producers * q.u.mesh.consumers));
+    }
+    // (with -w there are no requester threads to report on)
+    const int nrqr = workStealing ? 0 : NUM_THREADS_RQR;
+    PrintMetrics(rqr, nrqr, rlv, NUM_THREADS_RLV, &depth, wall);
+    if (cacheTtl > 0) {
+        printf("Cache: %lu hits, %lu misses, %lu coalesced",
+               atomic_load(&cache.hits), atomic_load(&cache.misses), atomic_load(&cache.coalesced));
+        if (cacheMaxNames > 0) printf(", %lu evicted (limit %ld)", atomic_load(&cache.evictions), cacheMaxNames);
+        printf("\n");
+    }
+    if (diskCachePath) {
+        printf("Cache file: %lu hits, %lu stores\n",
+               atomic_load(&dcache.hits), atomic_load(&dcache.stores));
+    }
+    if (dedupNames) {
+        unsigned long total = atomic_load(&dedup.total), unique = atomic_load(&dedup.unique);
+        printf("Names: %lu total, %lu unique (%.1f%% duplicates)\n",
+               total, unique, total ? 100.0 * (total - unique) / total : 0.0);
+    }
+    if (metricsPath && WriteMetricsJson(metricsPath, rqr, nrqr, rlv, NUM_THREADS_RLV,
+                                        &depth, wall, cpu)) {
+        fprintf(stderr,"Error: unable to write metrics to %s\n", metricsPath);
+    }
+    if (asyncServer) dnsasync_cleanup(&engine);
+    // A lookup given up on may still be running in the backend: leave the
+    // backend to the exit then
+    int stuck = hedgedBackend.lookup ? hedge_cleanup(&hedger) : 0;
+    if (limitedBackend.lookup && !stuck) ratelimit_cleanup(&limiter);
+    if (backendSpec && !stuck) dnsbackend_close(&backend);
+    if (cacheTtl > 0) dnscache_cleanup(&cache);
+    if (dedupNames) dedup_cleanup(&dedup);
+    if (diskCachePath) diskcache_close(&dcache);
+    metrics_sampler_cleanup(&depth);
+    pool_cleanup(&resolvers);
+    if (workStealing) steal_cleanup(&sched);
+    free(rqr);
+    free(rlv);
     return 0;
 }
 
+// Copy a hostname from the queue into a buffer of MAPINPUT_MAX_NAME+1 bytes.
+// Mapped names end at whitespace rather than a NUL, and everything past the
+// queue (getaddrinfo(), the caches, the async engine) wants a C string.
+// Only mapped names may be scanned with mapinput_name_len(): it reads whole
+// blocks past the name, which only the mapping's zero pages make safe.
+static void CopyName(char* buf, const char* name) {
+    size_t len = inputMapped ? mapinput_name_len(name) : strnlen(name, MAPINPUT_MAX_NAME);
+    memcpy(buf, name, len);
+    buf[len] = '\0';
+}
+
+// Done with a hostname from the queue: give it back to its arena (or free
+// it with -M), unless it lives in a mapping
+static void ReleaseName(char* name) {
+    if (inputMapped) return;
+    if (nameArenas) arena_release(name);
+    else free(name);
+}
+
+// A requester's copy of a name for the queue, NULL if out of memory
+static char* CopyForQueue(requester_ctx* self, const char* name, size_t len) {
+    char* copy;
+    if (nameArenas) return arena_copy(&self->names, name, len);
+    copy = malloc(len + 1);
+    if (copy) {
+        memcpy(copy, name, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+// Write one result line, ipstr NULL means the lookup failed
+// With -d, also write it for the duplicates that were waiting on this lookup
+static void WriteResult(outbuf* out, const char* hostname, const char* ipstr) {
+    if (ipstr == NULL) {
+        fprintf(stderr, "dnslookup error: %s\n", hostname);
+        ipstr = "";
+    }
+    // Add line to this thread's buffer, no lock unless it has to be flushed
+    outbuf_line(out, hostname, ipstr);
+    if (dedupNames) {
+        dedup_waiter* w = dedup_complete(&dedup, hostname, *ipstr ? ipstr : NULL);
+        while (w) {
+            dedup_waiter* next = w->next;
+            char name[MAPINPUT_MAX_NAME + 1];
+            // Under its own spelling
+            CopyName(name, w->payload);
+            outbuf_line(out, name, ipstr);
+            ReleaseName(w->payload);
+            free(w);
+            w = next;
+        }
+    }
+}
+
+// With -d, check a name from the input against the names seen so far
+// Returns 1 if it is the first occurrence and must be resolved, 0 if it was
+// taken care of: answered right away into out, or left with the set until
+// the first occurrence's lookup completes
+static int Deduplicate(outbuf* out, void* name) {
+    char hostname[MAPINPUT_MAX_NAME + 1], ipstr[UTIL_ADDRS_STRLEN];
+    CopyName(hostname, name);
+    switch (dedup_add(&dedup, hostname, name, ipstr, sizeof(ipstr))) {
+        case DEDUP_NEW:
+            return 1;
+        case DEDUP_WAITING:
+            return 0;
+        case DEDUP_HIT:
+            outbuf_line(out, hostname, ipstr);
+            break;
+        default:
+            outbuf_line(out, hostname, "");
+            break;
+    }
+    ReleaseName(name);
+    return 0;
+}
+
+// TTL for cache file entries when the resolver gives none: -c 0 only turns
+// off the in-process cache, the file still has to keep what it stores
+static uint32_t DiskCacheTtl(void) {
+    return cacheTtl > 0 ? (uint32_t)cacheTtl : (uint32_t)defaultCacheTtl;
+}
+
+// dnslookup() in the shape the cache wants, behind the cache file if there
+// is one. No backend gives a TTL, so fresh results get the default.
+// With -A, every address instead of the first, comma-separated.
+static int ResolveHostname(const char* hostname, char* ipstr, int size, uint32_t* ttl) {
+    int rv;
+    if (allAddresses) {
+        dnsaddr addrs[UTIL_MAX_ADDRS];
+        int count;
+        *ttl = 0;
+        rv = dnslookup_all(hostname, addrs, UTIL_MAX_ADDRS, &count);
+        if (rv == UTIL_SUCCESS) dnsaddr_join(addrs, count, ipstr, size);
+        return rv;
+    }
+    if (diskCachePath) {
+        switch (diskcache_get(&dcache, hostname, ipstr, size, ttl)) {
+            case DISKCACHE_POSITIVE:
+                return UTIL_SUCCESS;
+            case DISKCACHE_NEGATIVE:
+                return UTIL_FAILURE;
+        }
+    }
+    *ttl = 0;
+    rv = dnslookup(hostname, ipstr, size);
+    if (diskCachePath) {
+        diskcache_put(&dcache, hostname, rv == UTIL_SUCCESS ? ipstr : NULL,
+                      rv == UTIL_SUCCESS ? DiskCacheTtl() : (uint32_t)cacheNegativeTtl);
+    }
+    return rv;
+}
+
+// Count the addresses in a -A result by family (IPv6 ones have colons)
+static void CountAddresses(resolver_ctx* self, const char* list) {
+    int v6 = 0;
+    for (;; ++list) {
+        if (*list == ':') v6 = 1;
+        if (*list == ',' || *list == '\0') {
+            if (v6) self->addrs6++;
+            else self->addrs4++;
+            v6 = 0;
+            if (*list == '\0') break;
+        }
+    }
+}
+
+// Resolve a hostname, through the cache if it is on
+static int LookupHostname(resolver_ctx* self, const char* hostname, char* ipstr, int size) {
+    int rv;
+    if (cacheTtl > 0) {
+        rv = dnscache_lookup(&cache, hostname, ipstr, size, ResolveHostname);
+    } else {
+        uint32_t ttl;
+        rv = ResolveHostname(hostname, ipstr, size, &ttl);
+    }
+    if (allAddresses && rv != UTIL_FAILURE) CountAddresses(self, ipstr);
+    return rv;
+}
+
+// Record the latency of one name, counted from start
+// Returns when it was done
+static uint64_t RecordLookup(resolver_ctx* self, uint64_t start) {
+    uint64_t now = metrics_now_ns();
+    metrics_hist_record(&self->stats.latency, now - start);
+    self->stats.items++;
+    // Feed the pool's sizing, per name since a batch of slow lookups can
+    // take longer than a controller tick
+    pool_report(&resolvers, 1, now - start);
+    return now;
+}
+
+// Resolve a hostname from the queue (or a deque), write the result and
+// record its latency, counted from start
+// Returns when it was done
+static uint64_t ResolveName(resolver_ctx* self, void* name, uint64_t start) {
+    char hostname[MAPINPUT_MAX_NAME + 1];
+    char firstipstr[UTIL_ADDRS_STRLEN]; // all of them with -A
+    int rv;
+    // Copy to local stack space and release
+    CopyName(hostname,name);
+    ReleaseName(name);
+    rv = LookupHostname(self, hostname, firstipstr, sizeof(firstipstr));
+    WriteResult(&self->out, hostname, rv == UTIL_FAILURE ? NULL : firstipstr);
+    // Latency of this one name: cache check to result written
+    return RecordLookup(self, start);
+}
+
 // Run by each resolver thread.
-// Pulls from queue and writes to output file, exits when queue is empty
-void* ResolverThreadAction(void* fp) {
-    char hostname[1025];
+// Pulls from queue and writes to output file, exits once every requester is
+// done and the queue is drained (an empty queue alone doesn't stop it)
+void* ResolverThreadAction(void* ctx) {
+    resolver_ctx* self = (resolver_ctx*)ctx;
+    void* batch[batchSize];
+    int i, n;
+    uint64_t now, waited;
+    metrics_thread_start(&self->stats);
+    // Get hostnames from the queue a batch at a time and resolve them,
+    // sleeping while it is empty
+    for (;;) {
+        // Park here while the pool is sized below this thread
+        pool_admit(&resolvers, self->id);
+        waited = metrics_now_ns();
+        n = handoff_pop_batch(&q, batch, batchSize);
+        now = metrics_now_ns();
+        self->stats.blocked_ns += now - waited;
+        if (n <= 0) break;
+        for (i = 0; i < n; ++i) {
+            now = ResolveName(self, batch[i], now);
+        }
+    }
+    metrics_thread_stop(&self->stats);
+    return NULL;
+}
+
+// Run by each resolver thread with -U.
+// Like ResolverThreadAction, but the queue holds requests from the daemon's
+// connections and each result goes back on the connection it came from
+void* DaemonResolverThreadAction(void* ctx) {
+    resolver_ctx* self = (resolver_ctx*)ctx;
+    void* batch[batchSize];
+    char ipstr[UTIL_ADDRS_STRLEN];
+    int i, n, rv;
+    uint64_t now, waited;
+    metrics_thread_start(&self->stats);
+    for (;;) {
+        pool_admit(&resolvers, self->id);
+        waited = metrics_now_ns();
+        n = handoff_pop_batch(&q, batch, batchSize);
+        now = metrics_now_ns();
+        self->stats.blocked_ns += now - waited;
+        if (n <= 0) break;
+        for (i = 0; i < n; ++i) {
+            lookupd_request* req = batch[i];
+            rv = LookupHostname(self, req->name, ipstr, sizeof(ipstr));
+            lookupd_respond(req, rv == UTIL_FAILURE ? LOOKUPD_NOTFOUND : LOOKUPD_OK, ipstr);
+            // Latency of this one name: cache check to response sent
+            now = RecordLookup(self, now);
+        }
+    }
+    metrics_thread_stop(&self->stats);
+    return NULL;
+}
+
+// Run by each worker thread with -w.
+// Resolves names from its own deque, fresh chunks of input or other
+// workers' deques (steal.h), exits once every name has been resolved
+void* WorkerThreadAction(void* ctx) {
+    resolver_ctx* self = (resolver_ctx*)ctx;
+    const char* name;
+    metrics_thread_start(&self->stats);
+    uint64_t now, waited = self->stats.start_ns;
+    while ((name = steal_next(&sched, self->id)) != NULL) {
+        // Waiting is the time spent finding a name, mostly napping while
+        // there was nothing to steal
+        now = metrics_now_ns();
+        self->stats.blocked_ns += now - waited;
+        // Names are only read past here, dropping const is safe
+        if (dedupNames && !Deduplicate(&self->out, (void*)name)) {
+            waited = metrics_now_ns();
+        } else {
+            waited = ResolveName(self, (void*)name, now);
+        }
+        steal_done(&sched);
+    }
+    self->stats.blocked_ns += metrics_now_ns() - waited;
+    metrics_thread_stop(&self->stats);
+    return NULL;
+}
+
+// Count one name answered by the async resolver thread
+static void AsyncAnswered(uint64_t latency_ns) {
+    metrics_hist_record(&asyncCtx->stats.latency, latency_ns);
+    asyncCtx->stats.items++;
+}
+
+// Completion callback for the async resolver, arg is the name from the queue
+static void AsyncLookupDone(void* arg, const char* hostname, int status, const char* ipstr,
+                            uint32_t ttl, long long latency_us) {
+    if (cacheTtl > 0) {
+        dnscache_complete(&cache, hostname, status == DNSASYNC_OK, ipstr, ttl);
+    }
+    if (diskCachePath) {
+        if (status == DNSASYNC_OK) {
+            diskcache_put(&dcache, hostname, ipstr, ttl ? ttl : DiskCacheTtl());
+        } else {
+            diskcache_put(&dcache, hostname, NULL, cacheNegativeTtl);
+        }
+    }
+    WriteResult(&asyncCtx->out, hostname, status == DNSASYNC_OK ? ipstr : NULL);
+    ReleaseName(arg);
+    AsyncAnswered((uint64_t)latency_us * 1000);
+}
+
+// Start an async lookup for a hostname from the queue, answering it straight
+// from the cache when possible. Returns 1 if the same name is already in
+// flight, in which case the caller holds on to it until that one completes.
+static int AsyncStart(char* name) {
+    char hostname[MAPINPUT_MAX_NAME + 1];
+    uint64_t start = metrics_now_ns();
+    CopyName(hostname, name);
+    if (cacheTtl > 0) {
+        char ipstr[INET6_ADDRSTRLEN];
+        switch (dnscache_begin(&cache, hostname, ipstr, sizeof(ipstr), 0)) {
+            case DNSCACHE_PENDING:
+                return 1;
+            case DNSCACHE_HIT:
+                WriteResult(&asyncCtx->out, hostname, ipstr);
+                ReleaseName(name);
+                AsyncAnswered(metrics_now_ns() - start);
+                return 0;
+            case DNSCACHE_NEGATIVE:
+                WriteResult(&asyncCtx->out, hostname, NULL);
+                ReleaseName(name);
+                AsyncAnswered(metrics_now_ns() - start);
+                return 0;
+        }
+    }
+    if (diskCachePath) {
+        char ipstr[INET6_ADDRSTRLEN];
+        uint32_t ttl;
+        int status = diskcache_get(&dcache, hostname, ipstr, sizeof(ipstr), &ttl);
+        if (status != DISKCACHE_EMPTY) {
+            if (cacheTtl > 0) {
+                dnscache_complete(&cache, hostname, status == DISKCACHE_POSITIVE, ipstr, ttl);
+            }
+            WriteResult(&asyncCtx->out, hostname, status == DISKCACHE_POSITIVE ? ipstr : NULL);
+            ReleaseName(name);
+            AsyncAnswered(metrics_now_ns() - start);
+            return 0;
+        }
+    }
+    if (dnsasync_submit(&engine, hostname, AsyncLookupDone, name) != DNSASYNC_QUEUED) {
+        AsyncLookupDone(name, hostname, DNSASYNC_SERVFAIL, "", 0, 0);
+    }
+    return 0;
+}
+
+// Run by the single async resolver thread (-a).
+// Keeps up to asyncInflight lookups outstanding, exits once every requester
+// is done, the queue is drained and the last answer is in
+void* AsyncResolverThreadAction(void* ctx) {
+    int closed = 0, i;
     char* temp;
-    // Get hostnames from the queue and resolve them
-    pthread_mutex_lock(&queue_lock);
-    while (!queue_is_empty(&q)) {
-        // Get an element from the queue
-        if ((temp = queue_pop(&q)) == NULL) {
-            fprintf(stderr,"Failed to pop from queue. Thread halting.\n");
-            return NULL;
-        }
-        pthread_mutex_unlock(&queue_lock); // end of queue critical section
-        // Copy to local stack space and free
-        strcpy(hostname,temp);
-        free(temp);
-        // Resolve the hostname
-        char firstipstr[INET6_ADDRSTRLEN];
-        if (dnslookup(hostname, firstipstr, sizeof(firstipstr)) == UTIL_FAILURE) {
-            fprintf(stderr, "dnslookup error: %s\n", hostname);
-            strncpy(firstipstr, "", sizeof(firstipstr));
-        }
-        // Lock the output file, add line to output file, and release
-        pthread_mutex_lock(&output_lock);
-        fprintf(fp, "%s,%s\n", hostname, firstipstr);
-        pthread_mutex_unlock(&output_lock);
-
-        pthread_mutex_lock(&queue_lock);
-    }
-    pthread_mutex_unlock(&queue_lock);
+    // Duplicates of names already in flight (coalesced through the cache),
+    // and when they were put aside
+    struct { char* name; uint64_t since; }* deferred = NULL;
+    int ndeferred = 0, capdeferred = 0;
+    asyncCtx = (resolver_ctx*)ctx; // for AsyncLookupDone
+    metrics_thread_start(&asyncCtx->stats);
+    while (!closed || dnsasync_inflight(&engine) > 0 || ndeferred > 0) {
+        // Top up from the queue. Only sleep on the queue when nothing is in
+        // flight, otherwise answers would sit unread.
+        while (!closed && dnsasync_inflight(&engine) < engine.max_inflight) {
+            if (dnsasync_inflight(&engine) == 0 && ndeferred == 0) {
+                uint64_t waited = metrics_now_ns();
+                temp = handoff_pop(&q);
+                asyncCtx->stats.blocked_ns += metrics_now_ns() - waited;
+                closed = (temp == NULL);
+            } else {
+                temp = handoff_trypop(&q, &closed);
+            }
+            if (temp == NULL) break;
+            if (AsyncStart(temp)) {
+                if (ndeferred == capdeferred) {
+                    int cap = capdeferred ? capdeferred * 2 : 64;
+                    void* grown = realloc(deferred, cap * sizeof(*deferred));
+                    if (grown == NULL) {
+                        // Keep what is deferred already, and answer this
+                        // duplicate as failed rather than lose it
+                        char hostname[MAPINPUT_MAX_NAME + 1];
+                        CopyName(hostname, temp);
+                        fprintf(stderr,"Out of memory, giving up on %s.\n", hostname);
+                        WriteResult(&asyncCtx->out, hostname, NULL);
+                        ReleaseName(temp);
+                        AsyncAnswered(0);
+                        continue;
+                    }
+                    deferred = grown;
+                    capdeferred = cap;
+                }
+                deferred[ndeferred].name = temp;
+                deferred[ndeferred++].since = metrics_now_ns();
+            }
+        }
+        if (dnsasync_inflight(&engine) > 0) {
+            // Queue ran dry: poll it again soon. Window full or input done: just
+            // wait for answers (dnsasync_run wakes up for retransmits itself).
+            int wait_ms = (closed || dnsasync_inflight(&engine) >= engine.max_inflight) ? -1 : 1;
+            if (dnsasync_run(&engine, wait_ms) < 0) {
+                fprintf(stderr,"Async resolver failed. Thread halting.\n");
+                break;
+            }
+        }
+        // Answer the duplicates whose lookup has completed
+        for (i = 0; i < ndeferred; ) {
+            char ipstr[INET6_ADDRSTRLEN], hostname[MAPINPUT_MAX_NAME + 1];
+            CopyName(hostname, deferred[i].name);
+            int status = dnscache_peek(&cache, hostname, ipstr, sizeof(ipstr));
+            if (status == DNSCACHE_PENDING) {
+                i++;
+                continue;
+            }
+            temp = deferred[i].name;
+            uint64_t since = deferred[i].since;
+            deferred[i] = deferred[--ndeferred];
+            if (status == DNSCACHE_MISS) {
+                // Already expired again (TTL 0), look it up for real
+                if (AsyncStart(temp)) {
+                    deferred[ndeferred].name = temp;
+                    deferred[ndeferred++].since = since;
+                }
+            } else {
+                WriteResult(&asyncCtx->out, hostname, status == DNSCACHE_HIT ? ipstr : NULL);
+                ReleaseName(temp);
+                AsyncAnswered(metrics_now_ns() - since);
+            }
+        }
+    }
+    free(deferred);
+    metrics_thread_stop(&asyncCtx->stats);
     return NULL;
 }
 
-// Run by each requester thread.
-// Opens file, adds hostnames to queue, and exits
-void* RequesterThreadAction(void* file_name) {
-    // Try to open the file
-    FILE* fp = fopen((char*)file_name,"r");
-    if (!fp) {
-        fprintf(stderr,"Failed to open input file %s\n",(char*)file_name);
-        return NULL; // exit quietly
+// A -k resolver thread's names, taken off the queue for its tasks
+typedef struct task_feed_s {
+    resolver_ctx* self;
+    void** names;         // ring of up to cap names
+    int head, count, cap;
+    int closed;           // the queue is closed and drained
+    coro_cond more;       // tasks waiting for names
+    coro_cond room;       // the feeder waiting for the ring to empty out
+} task_feed;
+
+// How long the feeder naps when the queue runs dry while lookups are in
+// flight (with none, it sleeps on the queue instead)
+const uint64_t feedPollNs = 1000000;
+
+// Feeder task, one per thread: keeps the ring topped up from the queue
+// without ever blocking the thread while other tasks have work in progress
+static void FeedTasks(void* arg) {
+    task_feed* feed = arg;
+    void* name;
+    while (!feed->closed) {
+        int got = 0, closed = 0;
+        while (feed->count < feed->cap) {
+            if (feed->count == 0 && got == 0 && !coro_busy()) {
+                // Every task is idle: the thread may as well sleep here
+                uint64_t waited = metrics_now_ns();
+                name = handoff_pop(&q);
+                feed->self->stats.blocked_ns += metrics_now_ns() - waited;
+                closed = (name == NULL);
+            } else {
+                name = handoff_trypop(&q, &closed);
+            }
+            if (name == NULL) break;
+            feed->names[(feed->head + feed->count++) % feed->cap] = name;
+            got++;
+        }
+        // A task per new name, not all of them: most would find none left
+        feed->closed = closed;
+        if (closed) {
+            coro_cond_broadcast(&feed->more);
+            break;
+        }
+        while (got-- > 0) coro_cond_signal(&feed->more);
+        if (feed->count == feed->cap) {
+            coro_cond_wait(&feed->room);
+        } else if (got > 0 || coro_runnable()) {
+            // The requesters are still filling the queue, or the tasks still
+            // have names to get through: back for more once they have had
+            // their turn, rather than a poll interval later
+            coro_yield();
+        } else {
+            coro_sleep_ns(feedPollNs);
+        }
+    }
+}
+
+// Resolver task: the loop of ResolverThreadAction, as a coroutine. The
+// backend parks it while its lookup is on the network.
+static void ResolveTask(void* arg) {
+    task_feed* feed = arg;
+    void* name;
+    for (;;) {
+        while (feed->count == 0 && !feed->closed) coro_cond_wait(&feed->more);
+        if (feed->count == 0) break;
+        name = feed->names[feed->head];
+        feed->head = (feed->head + 1) % feed->cap;
+        // Wake the feeder once the ring is half empty, not for every name
+        if (--feed->count == feed->cap / 2) coro_cond_signal(&feed->room);
+        ResolveName(feed->self, name, metrics_now_ns());
+    }
+}
+
+// Run by each resolver thread with -k.
+// Runs its share of the tasks and a feeder on a coroutine scheduler, pinned
+// to a core, exits once every requester is done and the queue is drained
+void* TaskResolverThreadAction(void* ctx) {
+    resolver_ctx* self = (resolver_ctx*)ctx;
+    coro_sched tasks;
+    task_feed feed;
+    int i, n = resolverTasks / poolMax + (self->id < resolverTasks % poolMax);
+    metrics_thread_start(&self->stats);
+    coro_pin_thread(self->id);
+    memset(&feed, 0, sizeof(feed));
+    feed.self = self;
+    feed.cap = n;
+    coro_cond_init(&feed.more);
+    coro_cond_init(&feed.room);
+    feed.names = malloc(n * sizeof(void*));
+    if (feed.names == NULL || coro_sched_init(&tasks) || coro_spawn(&tasks, FeedTasks, &feed)) {
+        fprintf(stderr,"Unable to start resolver tasks. Thread halting.\n");
+        free(feed.names);
+        return NULL;
+    }
+    for (i = 0; i < n && coro_spawn(&tasks, ResolveTask, &feed) == 0; ++i);
+    if (i < n) fprintf(stderr,"Out of memory, resolver %d runs %d tasks of %d.\n", self->id, i, n);
+    if (coro_sched_run(&tasks)) {
+        fprintf(stderr,"Resolver tasks stalled. Thread halting.\n");
     }
-    // File opened succesfully, read lines and add to queue
+    self->tasks = (int)tasks.spawned - 1; // not the feeder
+    self->switches = tasks.switches;
+    self->peak_waiting = tasks.peak_waiting;
+    coro_sched_cleanup(&tasks);
+    free(feed.names);
+    metrics_thread_stop(&self->stats);
+    return NULL;
+}
+
+// Hand a requester's batch of names to the resolvers (sleeps while the queue
+// is full). Returns QUEUE_FAILURE if the queue was closed under it, after
+// releasing the names that didn't make it.
+static int PushBatch(requester_ctx* self, void** batch, int n) {
+    uint64_t start = metrics_now_ns();
+    int i, pushed = handoff_push_batch(&q, batch, n);
+    // Mostly time asleep on a full queue, plus the lock itself
+    self->stats.blocked_ns += metrics_now_ns() - start;
+    self->stats.items += pushed;
+    if (pushed == n) return QUEUE_SUCCESS;
+    fprintf(stderr,"Failed to push to queue. Thread halting.\n");
+    for (i = pushed; i < n; ++i) {
+        ReleaseName(batch[i]);
+    }
+    return QUEUE_FAILURE;
+}
+
+// Read hostnames from fp and add them to the queue a batch at a time
+static void ReadNames(requester_ctx* self, FILE* fp) {
     char hostname[1025];
+    void* batch[batchSize];
+    int n = 0;
     while (fscanf(fp, "%1024s", hostname) > 0) {
-        pthread_mutex_lock(&queue_lock);
-        // Spin on full queue, sleeping for random time between 0-100 us
-        while (queue_is_full(&q)) {
-            pthread_mutex_unlock(&queue_lock);
-            usleep(rand()%100);
-            pthread_mutex_lock(&queue_lock);
-        }
-        // Put the hostname on the heap so we can queue it.
-        // malloc'ed memory is freed by resolver threads
-        char* temp = (char*)malloc(strlen(hostname)+1);
+        // Copy the hostname out so we can queue it, resolver threads
+        // release it
+        char* temp = CopyForQueue(self, hostname, strlen(hostname));
         if (temp == NULL) {
             fprintf(stderr,"Out of memory. Thread halting.\n");
-            return NULL; // exit quietly
+            break;
         }
-        strcpy(temp, hostname);
-        // Add to queue and stop if something goes horribly wrong
-        if (queue_push(&q, temp) == QUEUE_FAILURE) {
-            fprintf(stderr,"Failed to push to queue. Thread halting.\n");
-            return NULL; // exit quietly
+        // Only first occurrences go on to the resolvers with -d
+        if (dedupNames && !Deduplicate(&self->out, temp)) continue;
+        batch[n++] = temp;
+        // Add to queue once the batch is full (sleeps while the queue is
+        // full) and stop if something goes horribly wrong
+        if (n == batchSize) {
+            int rv = PushBatch(self, batch, n);
+            n = 0;
+            if (rv == QUEUE_FAILURE) break;
         }
-        // printf("%s: %s\n",(char*)file_name,hostname);
-        pthread_mutex_unlock(&queue_lock);
     }
-    // Processed all lines in the file, close the file and halt
+    // Hand off the partial last batch
+    if (n > 0) PushBatch(self, batch, n);
+    arena_finish(&self->names);
+}
+
+// Run by each requester thread.
+// Opens file, adds hostnames to queue, and exits
+// Must report handoff_producer_done() on every way out, or resolvers never stop
+void* RequesterThreadAction(void* ctx) {
+    requester_ctx* self = (requester_ctx*)ctx;
+    metrics_thread_start(&self->stats);
+    // Try to open the file
+    FILE* fp = fopen(self->file_name,"r");
+    if (!fp) {
+        fprintf(stderr,"Failed to open input file %s\n",self->file_name);
+        handoff_producer_done(&q);
+        metrics_thread_stop(&self->stats);
+        return NULL; // exit quietly
+    }
+    // File opened succesfully, queue its names
+    ReadNames(self, fp);
+    // Processed all lines in the file (or gave up), close the file and halt
     fclose(fp);
+    handoff_producer_done(&q);
+    metrics_thread_stop(&self->stats);
+    return NULL;
+}
+
+// Run by each requester thread with -u.
+// Reads the file through io_uring (uring.h), a few large reads ahead of the
+// names being queued, and scans each chunk in place; names are copied out
+// as RequesterThreadAction copies them. A file that can't be read that way
+// (not a regular file, no ring to be had) is read with stdio after all.
+// Same exit rules as RequesterThreadAction.
+void* UringRequesterThreadAction(void* ctx) {
+    requester_ctx* self = (requester_ctx*)ctx;
+    uring_reader rd;
+    void* batch[batchSize];
+    char* data;
+    size_t keep = 0, namelen;
+    ssize_t len = 0;
+    int n = 0, last = 0, rv = QUEUE_SUCCESS;
+    metrics_thread_start(&self->stats);
+    int fd = open(self->file_name, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr,"Failed to open input file %s\n",self->file_name);
+        handoff_producer_done(&q);
+        metrics_thread_stop(&self->stats);
+        return NULL;
+    }
+    atomic_fetch_add(&uringInputsTried, 1);
+    if (uring_reader_init(&rd, fd)) {
+        FILE* fp = fdopen(fd, "r");
+        if (fp) {
+            ReadNames(self, fp);
+            fclose(fp);
+        } else {
+            close(fd);
+        }
+        handoff_producer_done(&q);
+        metrics_thread_stop(&self->stats);
+        return NULL;
+    }
+    atomic_fetch_add(&uringInputs, 1);
+    while (!last && rv == QUEUE_SUCCESS && (len = uring_reader_next(&rd, keep, &data, &last)) >= 0) {
+        const char *p = data, *end = data + len;
+        keep = 0;
+        while (p < end && (p = mapinput_next(p, end, &namelen)) != NULL) {
+            // A name running up to the end of the chunk may go on in the
+            // next one, unless there is no next one
+            if (p + namelen == end && !last && namelen < MAPINPUT_MAX_NAME) {
+                keep = namelen;
+                break;
+            }
+            char* temp = CopyForQueue(self, p, namelen);
+            if (temp == NULL) {
+                fprintf(stderr,"Out of memory. Thread halting.\n");
+                rv = QUEUE_FAILURE;
+                break;
+            }
+            p += namelen;
+            if (dedupNames && !Deduplicate(&self->out, temp)) continue;
+            batch[n++] = temp;
+            if (n == batchSize) {
+                rv = PushBatch(self, batch, n);
+                n = 0;
+                if (rv == QUEUE_FAILURE) break;
+            }
+        }
+    }
+    if (len < 0) fprintf(stderr,"Error reading input file %s: %s\n",self->file_name,strerror(errno));
+    if (n > 0 && rv == QUEUE_SUCCESS) PushBatch(self, batch, n);
+    arena_finish(&self->names);
+    uring_reader_cleanup(&rd);
+    close(fd);
+    handoff_producer_done(&q);
+    metrics_thread_stop(&self->stats);
+    return NULL;
+}
+
+// Run by the requester for an input named -.
+// Reads stdin (a pipe, FIFO or socket) with read() rather than stdio, so it
+// knows when the input has run dry for now: a partial batch is pushed before
+// waiting for more, and names trickling in aren't held back until a batch
+// fills up. Memory stays bounded by the buffer and the queue, however long
+// the input runs. Same exit rules as RequesterThreadAction.
+void* StreamRequesterThreadAction(void* ctx) {
+    requester_ctx* self = (requester_ctx*)ctx;
+    // Room for a full read plus a name cut off at its end, and zero padding
+    // for mapinput_next()'s block reads past the data
+    enum { READ_SIZE = 64 * 1024, PAD = 64 };
+    char* buf = malloc(READ_SIZE + MAPINPUT_MAX_NAME + PAD);
+    void* batch[batchSize];
+    size_t len = 0, namelen;
+    int n = 0, eof = 0, rv = QUEUE_SUCCESS;
+    metrics_thread_start(&self->stats);
+    if (buf == NULL) {
+        fprintf(stderr,"Out of memory. Thread halting.\n");
+        eof = 1;
+    }
+    while (!eof && rv == QUEUE_SUCCESS) {
+        ssize_t got = read(STDIN_FILENO, buf + len, READ_SIZE);
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0) perror("Error reading stdin");
+        eof = got <= 0;
+        if (got > 0) len += got;
+        memset(buf + len, 0, PAD);
+        const char *p = buf, *end = buf + len;
+        while (p < end && (p = mapinput_next(p, end, &namelen)) != NULL) {
+            // A name running up to the end of the data may go on in the
+            // next read, unless there is no next read
+            if (p + namelen == end && !eof && namelen < MAPINPUT_MAX_NAME) break;
+            char* temp = CopyForQueue(self, p, namelen);
+            if (temp == NULL) {
+                fprintf(stderr,"Out of memory. Thread halting.\n");
+                eof = 1;
+                break;
+            }
+            p += namelen;
+            batch[n++] = temp;
+            if (n == batchSize) {
+                rv = PushBatch(self, batch, n);
+                n = 0;
+                if (rv == QUEUE_FAILURE) break;
+            }
+        }
+        // Keep the cut-off name for the next read
+        if (p == NULL) p = end;
+        memmove(buf, p, end - p);
+        len = end - p;
+        // The next read may block, hand off what there is first
+        if (n > 0 && rv == QUEUE_SUCCESS) {
+            rv = PushBatch(self, batch, n);
+            n = 0;
+        }
+    }
+    free(buf);
+    arena_finish(&self->names);
+    handoff_producer_done(&q);
+    metrics_thread_stop(&self->stats);
+    return NULL;
+}
+
+// Run by each requester thread with -m.
+// Walks a mapped input file and queues pointers to the names in place, no
+// copies and no allocation. Same exit rules as RequesterThreadAction.
+void* MappedRequesterThreadAction(void* ctx) {
+    requester_ctx* self = (requester_ctx*)ctx;
+    mapped_file* file = &self->input;
+    const char *p, *end;
+    void* batch[batchSize];
+    size_t len;
+    int n = 0;
+    metrics_thread_start(&self->stats);
+    if (file->base == NULL) {
+        // Couldn't be mapped, main already said so
+        handoff_producer_done(&q);
+        metrics_thread_stop(&self->stats);
+        return NULL;
+    }
+    end = file->base + file->size;
+    for (p = file->base; p < end && (p = mapinput_next(p, end, &len)) != NULL; p += len) {
+        // Names are only read past here, dropping const is safe
+        if (dedupNames && !Deduplicate(&self->out, (void*)p)) continue;
+        batch[n++] = (void*)p;
+        if (n == batchSize) {
+            int rv = PushBatch(self, batch, n);
+            n = 0;
+            if (rv == QUEUE_FAILURE) break;
+        }
+    }
+    if (n > 0) PushBatch(self, batch, n);
+    handoff_producer_done(&q);
+    metrics_thread_stop(&self->stats);
     return NULL;
 }
@@ -3,14 +3,63 @@
  * For multi-threaded DNS resolution engine
  */
 
+#include <fcntl.h>
 #include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <time.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 
-#include "queue.h"
+#include "arena.h"
+#include "coro.h"
+#include "dedup.h"
+#include "dnsasync.h"
+#include "dnsbackend.h"
+#include "dnscache.h"
+#include "diskcache.h"
+#include "handoff.h"
+#include "hedge.h"
+#include "lookupd.h"
+#include "mapinput.h"
+#include "metrics.h"
+#include "outbuf.h"
+#include "pool.h"
+#include "ratelimit.h"
+#include "steal.h"
+#include "uring.h"
 #include "util.h"
 
-void* RequesterThreadAction(void* file_name);
-void* ResolverThreadAction(void* fp);
+// Per-thread state, handed to each thread action
+typedef struct requester_ctx_s {
+    const char* file_name;
+    mapped_file input;    // with -m, mapped by main() and kept until the end
+    name_arena names;     // copies of the names read, unless -M or -m
+    outbuf out;           // -d: duplicates answered straight from the set
+    int spill;
+    metrics_thread stats;
+} requester_ctx;
+
+typedef struct resolver_ctx_s {
+    int id;               // position in the resolver pool
+    outbuf out;
+    int spill;            // -o: this thread's spill file, -1 otherwise
+    unsigned long addrs4; // -A: addresses written, by family
+    unsigned long addrs6;
+    int tasks;            // -k: coroutines this thread ran
+    unsigned long switches; // ... and switches into them
+    int peak_waiting;     // most of them parked on a socket or timer at once
+    metrics_thread stats;
+} resolver_ctx;
+
+void* RequesterThreadAction(void* ctx);
+void* MappedRequesterThreadAction(void* ctx);
+void* StreamRequesterThreadAction(void* ctx);
+void* UringRequesterThreadAction(void* ctx);
+void* ResolverThreadAction(void* ctx);
+void* DaemonResolverThreadAction(void* ctx);
+void* AsyncResolverThreadAction(void* ctx);
+void* TaskResolverThreadAction(void* ctx);
+void* WorkerThreadAction(void* ctx);
@@ -0,0 +1,343 @@
+/* outbuf.c
+ * Akira Youngblood, 2026-10-17
+ * Per-thread result buffers for multi-lookup's output file
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapinput.h"
+#include "outbuf.h"
+
+// Room for the longest line the requesters can produce
+#define OUTBUF_MIN_SIZE 2048
+
+static int write_all(int fd, const char* p, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int pwrite_all(int fd, const char* p, size_t len, uint64_t off) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= n;
+        off += n;
+    }
+    return 0;
+}
+
+int outbuf_init(outbuf* ob, int fd, pthread_mutex_t* lock, size_t cap) {
+    if (cap == 0) cap = OUTBUF_DEFAULT_SIZE;
+    if (cap < OUTBUF_MIN_SIZE) cap = OUTBUF_MIN_SIZE;
+    ob->buf = malloc(cap);
+    if (ob->buf == NULL) {
+        perror("Error on outbuf malloc");
+        return -1;
+    }
+    ob->fd = fd;
+    ob->lock = lock;
+    ob->len = 0;
+    ob->cap = cap;
+    ob->failed = 0;
+    ob->sep = ',';
+    ob->flush_lines = 0;
+    ob->offset = NULL;
+    ob->ring.fd = -1;
+    ob->spare = NULL;
+    ob->spare_len = 0;
+    return 0;
+}
+
+int outbuf_init_spill(outbuf* ob, int fd) {
+    if (outbuf_init(ob, fd, NULL, 0)) return -1;
+    ob->sep = '\t';
+    return 0;
+}
+
+int outbuf_init_stream(outbuf* ob, int fd, pthread_mutex_t* lock) {
+    // Never holds more than a line, the minimum will do
+    if (outbuf_init(ob, fd, lock, OUTBUF_MIN_SIZE)) return -1;
+    ob->flush_lines = 1;
+    return 0;
+}
+
+int outbuf_use_uring(outbuf* ob, atomic_ullong* offset) {
+    if (offset == NULL) {
+        atomic_init(&ob->own_offset, 0);
+        offset = &ob->own_offset;
+    }
+    ob->offset = offset;
+    ob->spare = malloc(ob->cap);
+    if (ob->spare == NULL || uring_init(&ob->ring, 2)) {
+        free(ob->spare);
+        ob->spare = NULL;
+        return -1;
+    }
+    ob->spare_cap = ob->cap;
+    return 0;
+}
+
+// Wait for the spare buffer's write, if one is out, and finish it if it
+// came up short
+static int finish_spare(outbuf* ob) {
+    uring_result res;
+    size_t len = ob->spare_len;
+    if (len == 0) return 0;
+    ob->spare_len = 0;
+    if (uring_wait(&ob->ring, &res)) return -1;
+    if (res.res < 0) {
+        errno = -res.res;
+        return -1;
+    }
+    return pwrite_all(ob->fd, ob->spare + res.res, len - res.res, ob->spare_off + res.res);
+}
+
+// Claim the next len bytes of the file and write the buffer there: through
+// the ring if there is one, swapping in the spare buffer to fill meanwhile
+static int flush_at_offset(outbuf* ob) {
+    uint64_t off = atomic_fetch_add(ob->offset, ob->len);
+    int rv = finish_spare(ob);
+    if (rv == 0 && ob->ring.fd >= 0 &&
+        uring_write(&ob->ring, ob->fd, ob->buf, ob->len, off, 0) == 0) {
+        char* buf = ob->buf;
+        size_t cap = ob->cap;
+        ob->buf = ob->spare;
+        ob->cap = ob->spare_cap;
+        ob->spare = buf;
+        ob->spare_cap = cap;
+        ob->spare_len = ob->len;
+        ob->spare_off = off;
+    } else if (rv == 0) {
+        rv = pwrite_all(ob->fd, ob->buf, ob->len, off);
+    }
+    ob->len = 0;
+    if (rv < 0) {
+        perror("Error writing output");
+        ob->failed = 1;
+    }
+    return rv;
+}
+
+int outbuf_flush(outbuf* ob) {
+    int rv;
+    if (ob->len == 0 || ob->failed) {
+        ob->len = 0;
+        return ob->failed ? -1 : 0;
+    }
+    if (ob->offset) return flush_at_offset(ob);
+    if (ob->lock) pthread_mutex_lock(ob->lock);
+    rv = write_all(ob->fd, ob->buf, ob->len);
+    if (ob->lock) pthread_mutex_unlock(ob->lock);
+    ob->len = 0;
+    if (rv < 0) {
+        perror("Error writing output");
+        ob->failed = 1;
+    }
+    return rv;
+}
+
+// Make room for n more bytes: flush if they don't fit, and grow the buffer
+// if they wouldn't fit even in an empty one
+static int reserve(outbuf* ob, size_t n) {
+    if (ob->len + n > ob->cap && outbuf_flush(ob) < 0) return -1;
+    if (n > ob->cap) {
+        char* bigger = realloc(ob->buf, n);
+        if (bigger == NULL) {
+            perror("Error on outbuf realloc");
+            ob->failed = 1;
+            return -1;
+        }
+        ob->buf = bigger;
+        ob->cap = n;
+    }
+    return 0;
+}
+
+// Append "name,ipstr\n" as one unit, so a flush never splits a line
+static int append_line(outbuf* ob, const char* name, size_t namelen, const char* ipstr) {
+    size_t iplen = strlen(ipstr);
+    size_t n = namelen + iplen + 2;
+    if (reserve(ob, n) < 0) return -1;
+    char* p = ob->buf + ob->len;
+    memcpy(p, name, namelen);
+    p[namelen] = ob->sep;
+    memcpy(p + namelen + 1, ipstr, iplen);
+    p[n - 1] = '\n';
+    ob->len += n;
+    return 0;
+}
+
+int outbuf_line(outbuf* ob, const char* hostname, const char* ipstr) {
+    if (append_line(ob, hostname, strlen(hostname), ipstr) < 0) return -1;
+    return ob->flush_lines ? outbuf_flush(ob) : 0;
+}
+
+void outbuf_cleanup(outbuf* ob) {
+    outbuf_flush(ob);
+    if (finish_spare(ob) < 0) {
+        perror("Error writing output");
+        ob->failed = 1;
+    }
+    // (a ring is only ever set up along with the spare buffer)
+    if (ob->spare) uring_cleanup(&ob->ring);
+    free(ob->spare);
+    ob->spare = NULL;
+    free(ob->buf);
+    ob->buf = NULL;
+}
+
+int outbuf_spill_fd(void) {
+    const char* dir = getenv("TMPDIR");
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/multi-lookup-XXXXXX", dir && *dir ? dir : "/tmp");
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("Error creating spill file");
+        return -1;
+    }
+    unlink(path); // gone as soon as it is closed
+    return fd;
+}
+
+// Results read back from the spill files, keyed by the exact hostname text
+typedef struct {
+    uint64_t hash;     // 0: empty slot
+    const char* name;  // not NUL-terminated, points into a spill mapping
+    size_t namelen;
+    const char* ipstr; // NUL-terminated in place
+} result_slot;
+
+static uint64_t hash_bytes(const char* p, size_t n) {
+    // FNV-1a, 64 bit
+    uint64_t h = 14695981039346656037ULL;
+    while (n-- > 0) {
+        h ^= (unsigned char)*p++;
+        h *= 1099511628211ULL;
+    }
+    return h ? h : 1;
+}
+
+static result_slot* find_slot(result_slot* table, size_t mask, uint64_t hash,
+                              const char* name, size_t namelen) {
+    size_t i = hash & mask;
+    for (;; i = (i + 1) & mask) {
+        result_slot* slot = &table[i];
+        if (slot->hash == 0) return slot;
+        if (slot->hash == hash && slot->namelen == namelen &&
+            memcmp(slot->name, name, namelen) == 0) {
+            return slot;
+        }
+    }
+}
+
+int outbuf_merge_ordered(int fd, const int* spills, int nspills,
+                         char* const* inputs, int ninputs) {
+    char* maps[nspills];
+    size_t sizes[nspills];
+    size_t lines = 0, cap = 1;
+    unsigned long missing = 0;
+    result_slot* table = NULL;
+    outbuf out;
+    int i, rv = -1;
+
+    for (i = 0; i < nspills; ++i) {
+        maps[i] = NULL;
+        sizes[i] = 0;
+    }
+    // Map every spill file privately, so lines can be cut up in place
+    for (i = 0; i < nspills; ++i) {
+        struct stat st;
+        if (fstat(spills[i], &st) < 0) {
+            perror("Error reading spill file");
+            goto done;
+        }
+        if (st.st_size == 0) continue;
+        sizes[i] = st.st_size;
+        maps[i] = mmap(NULL, sizes[i], PROT_READ | PROT_WRITE, MAP_PRIVATE, spills[i], 0);
+        if (maps[i] == MAP_FAILED) {
+            maps[i] = NULL;
+            perror("Error mapping spill file");
+            goto done;
+        }
+        const char* p = maps[i];
+        const char* end = p + sizes[i];
+        while ((p = memchr(p, '\n', end - p)) != NULL) {
+            lines++;
+            p++;
+        }
+    }
+
+    // Index them, at most half full
+    while (cap < lines * 2) cap <<= 1;
+    table = calloc(cap, sizeof(result_slot));
+    if (table == NULL) {
+        perror("Error on result table calloc");
+        goto done;
+    }
+    for (i = 0; i < nspills; ++i) {
+        char* p = maps[i];
+        char* end = p + sizes[i];
+        while (p < end) {
+            char* eol = memchr(p, '\n', end - p);
+            if (eol == NULL) break;
+            // Hostnames never contain whitespace, so the first tab ends it
+            char* tab = memchr(p, '\t', eol - p);
+            if (tab) {
+                *eol = '\0';
+                size_t namelen = tab - p;
+                uint64_t hash = hash_bytes(p, namelen);
+                result_slot* slot = find_slot(table, cap - 1, hash, p, namelen);
+                slot->hash = hash;
+                slot->name = p;
+                slot->namelen = namelen;
+                slot->ipstr = tab + 1;
+            }
+            p = eol + 1;
+        }
+    }
+
+    // Replay the inputs in order
+    if (outbuf_init(&out, fd, NULL, 0)) goto done;
+    for (i = 0; i < ninputs; ++i) {
+        mapped_file mf;
+        const char *p, *end;
+        size_t len;
+        if (mapinput_open(&mf, inputs[i])) continue;
+        end = mf.base + mf.size;
+        for (p = mf.base; p < end && (p = mapinput_next(p, end, &len)) != NULL; p += len) {
+            result_slot* slot = find_slot(table, cap - 1, hash_bytes(p, len), p, len);
+            if (slot->hash == 0) missing++;
+            append_line(&out, p, len, slot->hash ? slot->ipstr : "");
+        }
+        mapinput_close(&mf);
+    }
+    outbuf_cleanup(&out);
+    if (missing) fprintf(stderr, "Ordered output: %lu names had no result\n", missing);
+    rv = out.failed ? -1 : 0;
+
+done:
+    free(table);
+    for (i = 0; i < nspills; ++i) {
+        if (maps[i]) munmap(maps[i], sizes[i]);
+    }
+    return rv;
+}
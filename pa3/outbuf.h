@@ -0,0 +1,111 @@
+/* outbuf.h
+ * Akira Youngblood, 2026-10-17
+ * Per-thread result buffers for multi-lookup's output file
+ *
+ * Each resolver thread formats its "hostname,address" lines into a private
+ * buffer and hands the whole buffer to the kernel with one write() when it
+ * fills up, instead of taking a lock and calling fprintf() for every name.
+ * Only whole lines are ever written, so lines from different threads never
+ * interleave. Buffers that share a file descriptor pass the same lock, which
+ * is then held once per flush rather than once per line (a single write() is
+ * only atomic for regular files, not for pipes).
+ *
+ * With outbuf_use_uring() (-u), a flush claims the next stretch of the file
+ * instead, writes there with no lock, and hands the buffer to io_uring
+ * (uring.h): the thread fills a second buffer while the kernel writes the
+ * first.
+ *
+ * outbuf_merge_ordered() rebuilds the output in input order from per-thread
+ * spill files, for runs that need a stable, diffable result (-o).
+ */
+
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "uring.h"
+
+#define OUTBUF_DEFAULT_SIZE (64 * 1024)
+
+typedef struct outbuf_s {
+    int fd;
+    pthread_mutex_t* lock; // held around write(), NULL if fd isn't shared
+    char* buf;
+    size_t len;
+    size_t cap;
+    int failed;            // a write failed, later output is dropped
+    char sep;              // between hostname and address, ',' (spill
+                           // files: '\t', see outbuf_init_spill())
+    int flush_lines;       // write every line right away (outbuf_init_stream())
+    // outbuf_use_uring() only
+    atomic_ullong* offset; // where the next flush goes, NULL: write()
+    atomic_ullong own_offset;
+    uring ring;            // fd -1: pwrite() instead
+    char* spare;           // the buffer being written
+    size_t spare_cap;
+    size_t spare_len;      // 0: no write in flight
+    uint64_t spare_off;
+} outbuf;
+
+/* Set up a buffer of cap bytes (OUTBUF_DEFAULT_SIZE if 0) in front of fd
+ * Returns 0 on success, -1 if the buffer can't be allocated
+ */
+int outbuf_init(outbuf* ob, int fd, pthread_mutex_t* lock, size_t cap);
+
+/* Set up a buffer in front of a spill file for outbuf_merge_ordered().
+ * Lines are written "hostname\tipstr\n": hostnames never contain
+ * whitespace, while both they and -A address lists may contain commas.
+ * Returns 0 on success, -1 if the buffer can't be allocated
+ */
+int outbuf_init_spill(outbuf* ob, int fd);
+
+/* Set up a buffer that writes each line as soon as it is added, for output
+ * that something downstream is reading as it comes (stdout, a pipe)
+ * Returns 0 on success, -1 if the buffer can't be allocated
+ */
+int outbuf_init_stream(outbuf* ob, int fd, pthread_mutex_t* lock);
+
+/* Write to offsets taken from *offset (shared by every buffer on the fd, so
+ * starting at the end of what is there already), or from 0 if offset is
+ * NULL (a fresh file of its own), through a ring of the buffer's own. Every
+ * buffer writing to the fd has to do the same, they no longer share the
+ * file position.
+ * Returns 0 if writes go through io_uring, -1 if they are made with
+ * pwrite() instead (offsets still apply)
+ */
+int outbuf_use_uring(outbuf* ob, atomic_ullong* offset);
+
+/* Append "hostname,ipstr\n", flushing first if it doesn't fit
+ * Returns 0, or -1 if output has failed
+ */
+int outbuf_line(outbuf* ob, const char* hostname, const char* ipstr);
+
+/* Write out everything buffered (with io_uring, the write may still be in
+ * flight until the next flush or outbuf_cleanup())
+ * Returns 0, or -1 if output has failed
+ */
+int outbuf_flush(outbuf* ob);
+
+/* Flush and free the buffer (the fd is left open) */
+void outbuf_cleanup(outbuf* ob);
+
+/* Create an anonymous temporary file for a thread's unordered results
+ * Returns its fd, or -1 on failure
+ */
+int outbuf_spill_fd(void);
+
+/* Write one line per name in the inputs, in input order, to fd, taking the
+ * addresses from the nspills spill files (written through outbuf_init_spill()
+ * buffers).
+ * Inputs are read the same way the requesters read them (mapinput.c), and
+ * ones that can't be opened are skipped, as they were during the run.
+ * Returns 0 on success, -1 on failure
+ */
+int outbuf_merge_ordered(int fd, const int* spills, int nspills,
+                         char* const* inputs, int ninputs);
+
+#endif
@@ -0,0 +1,245 @@
+/* pool.c
+ * Akira Youngblood, 2026-10-17
+ * Self-sizing worker pool for multi-lookup's resolver threads
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pool.h"
+
+#define GROW_BUSY 0.75    // grow when more than this share of workers is busy
+#define SHRINK_BUSY 0.5   // shrink when less than this share is busy
+#define GROW_PAYOFF 1.05  // a grow must raise throughput by 5%
+#define HOLD_TICKS 10     // ticks to hold still after undoing a grow,
+#define HOLD_MAX 160      // doubling up to this while grows keep failing
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void* ctx_of(pool* p, int id) {
+    return p->ctxs + (size_t)id * p->ctx_size;
+}
+
+// Call with lock held: note a new target for the report
+static void record(pool* p, int target) {
+    if (target > p->peak) p->peak = target;
+    if (p->nhistory < POOL_HISTORY) {
+        p->history[p->nhistory].ms = (uint32_t)((now_ns() - p->start_ns) / 1000000);
+        p->history[p->nhistory].target = target;
+        p->nhistory++;
+    }
+}
+
+// Call with lock held: set the target, starting workers that don't exist yet.
+// If one can't be started the pool stays at the size it reached.
+static void resize(pool* p, int target) {
+    while (p->created < target) {
+        void* ctx = ctx_of(p, p->created);
+        if (p->setup(ctx, p->created) ||
+            pthread_create(&p->threads[p->created], NULL, p->action, ctx)) {
+            fprintf(stderr, "Resolver pool: unable to start worker %d\n", p->created);
+            target = p->created;
+            p->max = p->created > 0 ? p->created : 1; // don't keep trying
+            break;
+        }
+        p->created++;
+    }
+    if (target != atomic_load(&p->target)) {
+        atomic_store(&p->target, target);
+        record(p, target);
+        pthread_cond_broadcast(&p->wake);
+    }
+}
+
+// Wait out a tick, cut short by pool_finish()
+// Returns nonzero once the pool is finishing
+static int wait_tick(pool* p) {
+    struct timespec until;
+    int finishing;
+    // The condition variable waits on CLOCK_REALTIME
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += POOL_TICK_MS / 1000;
+    until.tv_nsec += (POOL_TICK_MS % 1000) * 1000000L;
+    if (until.tv_nsec >= 1000000000L) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&p->lock);
+    // Woken for workers too (and spuriously): keep waiting until it's time
+    while (!(finishing = atomic_load(&p->finishing)) &&
+           pthread_cond_timedwait(&p->wake, &p->lock, &until) != ETIMEDOUT) {
+    }
+    pthread_mutex_unlock(&p->lock);
+    return finishing;
+}
+
+static void* controller_main(void* arg) {
+    pool* p = arg;
+    unsigned long last_done = 0;
+    unsigned long long last_latency = 0;
+    uint64_t last_ns = now_ns();
+    double last_rate = 0;
+    int grew_from = 0, hold = 0, backoff = HOLD_TICKS;
+
+    for (;;) {
+        if (wait_tick(p)) break;
+
+        uint64_t ns = now_ns();
+        unsigned long done = atomic_load(&p->done);
+        unsigned long long latency = atomic_load(&p->latency_ns);
+        unsigned long n = done - last_done;
+        double secs = (ns - last_ns) / 1e9;
+        double rate = n / secs;
+        // Little's law: lookups in progress on average over the tick
+        double busy = n ? rate * ((latency - last_latency) / 1e9 / n) : 0;
+        int backlog = p->depth(p->depth_arg) * 2 >= p->capacity;
+        last_done = done;
+        last_latency = latency;
+        last_ns = ns;
+
+        pthread_mutex_lock(&p->lock);
+        if (atomic_load(&p->finishing)) {
+            pthread_mutex_unlock(&p->lock);
+            break;
+        }
+        int target = atomic_load(&p->target);
+        int next = target;
+        if (hold > 0) {
+            hold--;
+        } else if (grew_from && rate < last_rate * GROW_PAYOFF) {
+            // More threads didn't buy more throughput: go back, and wait
+            // longer each time this keeps happening
+            next = grew_from;
+            p->reverts++;
+            hold = backoff;
+            if (backoff < HOLD_MAX) backoff *= 2;
+        } else {
+            if (grew_from) backoff = HOLD_TICKS; // the last grow paid off
+            if (backlog && (n == 0 || busy > GROW_BUSY * target)) {
+                // Work is waiting and the workers are all stuck in lookups
+                next = target + (target / 4 > 1 ? target / 4 : 1);
+                if (next > p->max) next = p->max;
+                if (next > target) p->grows++;
+            } else if (!backlog && n > 0 && busy < SHRINK_BUSY * target) {
+                next = (int)(busy / GROW_BUSY) + 1;
+                if (next < target / 2) next = target / 2;
+                if (next < p->min) next = p->min;
+                if (next < target) p->shrinks++;
+            }
+        }
+        grew_from = (next > target) ? target : 0;
+        resize(p, next);
+        pthread_mutex_unlock(&p->lock);
+        last_rate = rate;
+    }
+    return NULL;
+}
+
+int pool_init(pool* p, int min, int max, int initial,
+              void* (*action)(void*), int (*setup)(void*, int), void* ctxs, size_t ctx_size,
+              int (*depth)(void*), void* depth_arg, int capacity) {
+    memset(p, 0, sizeof(*p));
+    if (min < 1 || max < min) return -1;
+    if (initial < min) initial = min;
+    if (initial > max) initial = max;
+    p->threads = malloc(sizeof(pthread_t) * max);
+    if (p->threads == NULL) return -1;
+    if (pthread_mutex_init(&p->lock, NULL)) goto fail;
+    if (pthread_cond_init(&p->wake, NULL)) {
+        pthread_mutex_destroy(&p->lock);
+        goto fail;
+    }
+    p->action = action;
+    p->setup = setup;
+    p->ctxs = ctxs;
+    p->ctx_size = ctx_size;
+    p->min = min;
+    p->max = max;
+    p->initial = initial;
+    p->depth = depth;
+    p->depth_arg = depth_arg;
+    p->capacity = capacity;
+    atomic_init(&p->target, 0);
+    atomic_init(&p->finishing, 0);
+    atomic_init(&p->done, 0);
+    atomic_init(&p->latency_ns, 0);
+    return 0;
+
+fail:
+    free(p->threads);
+    p->threads = NULL;
+    return -1;
+}
+
+int pool_start(pool* p) {
+    p->start_ns = now_ns();
+    pthread_mutex_lock(&p->lock);
+    resize(p, p->initial);
+    pthread_mutex_unlock(&p->lock);
+    if (p->created == 0) return -1;
+    if (p->min < p->max) {
+        p->controlled = !pthread_create(&p->controller, NULL, controller_main, p);
+    }
+    return 0;
+}
+
+void pool_admit(pool* p, int id) {
+    if (id < atomic_load(&p->target) || atomic_load(&p->finishing)) return;
+    pthread_mutex_lock(&p->lock);
+    while (id >= atomic_load(&p->target) && !atomic_load(&p->finishing)) {
+        pthread_cond_wait(&p->wake, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+
+void pool_report(pool* p, unsigned long lookups, uint64_t latency_ns) {
+    atomic_fetch_add_explicit(&p->done, lookups, memory_order_relaxed);
+    atomic_fetch_add_explicit(&p->latency_ns, latency_ns, memory_order_relaxed);
+}
+
+void pool_finish(pool* p) {
+    pthread_mutex_lock(&p->lock);
+    atomic_store(&p->finishing, 1);
+    pthread_cond_broadcast(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+    if (p->controlled) {
+        pthread_join(p->controller, NULL);
+        p->controlled = 0;
+    }
+}
+
+void pool_join(pool* p) {
+    int i;
+    for (i = 0; i < p->created; ++i) {
+        pthread_join(p->threads[i], NULL);
+    }
+}
+
+void pool_cleanup(pool* p) {
+    pthread_cond_destroy(&p->wake);
+    pthread_mutex_destroy(&p->lock);
+    free(p->threads);
+    p->threads = NULL;
+}
+
+int pool_parse_bounds(const char* spec, int* min, int* max) {
+    char* end;
+    long lo = strtol(spec, &end, 10), hi = lo;
+    if (end == spec) return -1;
+    if (*end == ':') {
+        const char* rest = end + 1;
+        hi = strtol(rest, &end, 10);
+        if (end == rest) return -1;
+    }
+    if (*end != '\0' || lo < 1 || hi < lo || hi > 65536) return -1;
+    *min = (int)lo;
+    *max = (int)hi;
+    return 0;
+}
@@ -0,0 +1,107 @@
+/* pool.h
+ * Akira Youngblood, 2026-10-17
+ * Self-sizing worker pool for multi-lookup's resolver threads
+ *
+ * Workers are numbered 0..max-1. Only the first `target` may take work;
+ * the rest are parked on a condition variable (or not created yet). A
+ * controller thread adjusts target every POOL_TICK_MS from what the workers
+ * report and how full the queue is:
+ *
+ *   - Throughput X (lookups/s) and mean latency W give the average number of
+ *     lookups actually in progress, L = X * W (Little's law). L / target is
+ *     how busy the pool is.
+ *   - A backlog (queue at least half full) with a busy pool means more
+ *     threads would overlap more lookups: grow by a quarter.
+ *   - No backlog and a mostly idle pool: shrink toward L, at most by half.
+ *   - Growing has to pay for itself: if throughput didn't rise by at least
+ *     5% after a grow (e.g. lookups are CPU-bound cache hits, not network
+ *     waits), the grow is undone and the pool holds still for a while.
+ *
+ * Lookups are I/O waits, so the right size depends on latency, not cores.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define POOL_TICK_MS 100
+#define POOL_HISTORY 1024 // resizes remembered for reporting
+
+typedef struct pool_s {
+    // Workers and their contexts (ctx_size bytes each, max of them)
+    void* (*action)(void* ctx);
+    int (*setup)(void* ctx, int id); // run before a worker is first started
+    char* ctxs;
+    size_t ctx_size;
+    pthread_t* threads;
+    int min;
+    int max;
+    int initial;
+    // Sizing, under lock
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    atomic_int target;    // workers allowed to run, written under lock
+    int created;          // workers started so far (ids 0..created-1)
+    atomic_int finishing; // input is done, everybody runs until the queue drains
+    // Reported by workers, read by the controller
+    atomic_ulong done;
+    atomic_ullong latency_ns;
+    // Queue depth, for the backlog test
+    int (*depth)(void* arg);
+    void* depth_arg;
+    int capacity;
+    // Controller
+    pthread_t controller;
+    int controlled;
+    unsigned long grows;
+    unsigned long shrinks;
+    unsigned long reverts;
+    int peak;
+    uint64_t start_ns;
+    int nhistory;
+    struct { uint32_t ms; int target; } history[POOL_HISTORY];
+} pool;
+
+/* Set up a pool of min..max workers running action(ctx), starting with
+ * initial of them. ctxs is an array of max contexts of ctx_size bytes,
+ * setup(ctx, id) prepares one before its worker starts (non-zero: failed).
+ * depth(depth_arg) and capacity describe the queue the workers drain.
+ * Returns 0 on success, -1 on failure
+ */
+int pool_init(pool* p, int min, int max, int initial,
+              void* (*action)(void*), int (*setup)(void*, int), void* ctxs, size_t ctx_size,
+              int (*depth)(void*), void* depth_arg, int capacity);
+
+/* Start the initial workers, and the controller if min < max
+ * Returns 0 on success, -1 if no worker could be started
+ */
+int pool_start(pool* p);
+
+/* Called by worker id before taking more work: parks while the pool is
+ * sized below id. Returns once the worker may run.
+ */
+void pool_admit(pool* p, int id);
+
+/* Called by workers after finishing some lookups */
+void pool_report(pool* p, unsigned long lookups, uint64_t latency_ns);
+
+/* Input is finished: stop resizing and release parked workers so they can
+ * see the end of the queue
+ */
+void pool_finish(pool* p);
+
+/* Wait for every started worker to exit */
+void pool_join(pool* p);
+
+void pool_cleanup(pool* p);
+
+/* Parse "n" (fixed size) or "min:max"
+ * Returns 0 on success, -1 if malformed
+ */
+int pool_parse_bounds(const char* spec, int* min, int* max);
+
+#endif
@@ -7,6 +7,7 @@
  * Create Date: 2010/02/12
  * Modify Date: 2011/02/04
  * Modify Date: 2012/02/01
+ * Modify Date: 2026/10/17
  * Description:
  * 	This file contains an implementation of a simple FIFO queue.
  *  
@@ -92,6 +93,31 @@ int queue_push(queue* q, void* new_payload){
     return QUEUE_SUCCESS;
 }
 
+int queue_push_batch(queue* q, void** payloads, int n){
+    int i;
+
+    for(i=0; i < n; ++i){
+	if(queue_push(q, payloads[i]) == QUEUE_FAILURE){
+	    break;
+	}
+    }
+
+    return i;
+}
+
+int queue_pop_batch(queue* q, void** payloads, int max){
+    int i;
+
+    for(i=0; i < max; ++i){
+	payloads[i] = queue_pop(q);
+	if(payloads[i] == NULL){
+	    break;
+	}
+    }
+
+    return i;
+}
+
 void queue_cleanup(queue* q)
 {
     while(!queue_is_empty(q)){
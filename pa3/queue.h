@@ -7,6 +7,7 @@
  * Create Date: 2010/02/12
  * Modify Date: 2011/02/05
  * Modify Date: 2012/02/01
+ * Modify Date: 2026/10/17
  * Description:
  * 	This is the header file for an implemenation of a simple FIFO queue.
  * 
@@ -61,6 +62,16 @@ int queue_push(queue* q, void* payload);
  */
 void* queue_pop(queue* q);
 
+/* Function to add up to n payloads to end of FIFO queue, in order
+ * Returns the number pushed, which is less than n if the queue fills up
+ */
+int queue_push_batch(queue* q, void** payloads, int n);
+
+/* Function to return up to max elements from queue in FIFO order
+ * Returns the number popped into payloads, 0 if queue is empty
+ */
+int queue_pop_batch(queue* q, void** payloads, int max);
+
 /* Function to free queue memory */
 void queue_cleanup(queue* q);
 
@@ -0,0 +1,182 @@
+/* ratelimit.c
+ * Akira Youngblood, 2026-10-17
+ * Query rate limit and in-flight cap toward the upstream resolver
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "coro.h"
+#include "ratelimit.h"
+
+// Tokens this thread has taken from the bucket and not spent yet
+static _Thread_local struct {
+    ratelimit* owner;
+    int tokens;
+    uint64_t expires_ns;
+} cache;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// Take up to r->chunk tokens from the bucket. With none left, reserve the
+// next one due and sleep until then: waiters line up one interval apart
+// instead of all waking for every token. Returns how many were taken.
+static int take_tokens(ratelimit* r) {
+    for (;;) {
+        uint64_t now = now_ns();
+        unsigned long long tat = atomic_load(&r->tat);
+        // An idle bucket doesn't fill past burst: tat never lags behind now
+        uint64_t base = tat > now ? tat : now;
+        uint64_t limit = now + r->burst * r->interval_ns;
+        uint64_t n = base + r->interval_ns <= limit ? (limit - base) / r->interval_ns : 0;
+        if (n > (uint64_t)r->chunk) n = r->chunk;
+        uint64_t next = base + (n ? n : 1) * r->interval_ns;
+        if (!atomic_compare_exchange_weak(&r->tat, &tat, next)) continue;
+        if (n == 0) {
+            uint64_t due = next - r->burst * r->interval_ns;
+            atomic_fetch_add(&r->rate_waits, 1);
+            atomic_fetch_add(&r->rate_wait_ns, due - now);
+            // A -k task parks instead, leaving the thread to the others
+            coro_sleep_ns(due - now);
+            n = 1;
+        }
+        return (int)n;
+    }
+}
+
+static void take_token(ratelimit* r) {
+    uint64_t now = now_ns();
+    if (cache.owner != r || now >= cache.expires_ns) {
+        cache.owner = r;
+        cache.tokens = 0;
+    }
+    if (cache.tokens == 0) {
+        // Added rather than set: with -k, other tasks on this thread may
+        // have topped the cache up while this one slept for its token
+        int n = take_tokens(r);
+        cache.tokens += n;
+        cache.expires_ns = now_ns() + RATELIMIT_CACHE_MS * 1000000ull;
+    }
+    cache.tokens--;
+}
+
+// Take an in-flight slot if one is free
+static int try_slot(ratelimit* r) {
+    int n = atomic_load(&r->inflight);
+    while (n < r->max_inflight) {
+        if (atomic_compare_exchange_weak(&r->inflight, &n, n + 1)) {
+            int peak = atomic_load(&r->peak_inflight);
+            while (n + 1 > peak && !atomic_compare_exchange_weak(&r->peak_inflight, &peak, n + 1));
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void enter(ratelimit* r) {
+    if (r->rate > 0) take_token(r);
+    if (r->max_inflight > 0 && !try_slot(r)) {
+        // Slow path only: sleep until a lookup leaves. waiting goes up
+        // before the last try, so a leave() that makes room after it is
+        // sure to see a waiter and signal.
+        uint64_t start = now_ns();
+        pthread_mutex_lock(&r->lock);
+        atomic_fetch_add(&r->waiting, 1);
+        while (!try_slot(r)) pthread_cond_wait(&r->slot, &r->lock);
+        atomic_fetch_sub(&r->waiting, 1);
+        pthread_mutex_unlock(&r->lock);
+        atomic_fetch_add(&r->inflight_waits, 1);
+        atomic_fetch_add(&r->inflight_wait_ns, now_ns() - start);
+    }
+    atomic_fetch_add(&r->queries, 1);
+}
+
+static void leave(ratelimit* r) {
+    if (r->max_inflight > 0) {
+        atomic_fetch_sub(&r->inflight, 1);
+        if (atomic_load(&r->waiting) > 0) {
+            pthread_mutex_lock(&r->lock);
+            pthread_cond_signal(&r->slot);
+            pthread_mutex_unlock(&r->lock);
+        }
+    }
+}
+
+static int ratelimit_lookup(void* state, const char* hostname, char* firstIPstr, int maxSize) {
+    ratelimit* r = state;
+    int rv;
+    enter(r);
+    rv = r->inner.lookup ? r->inner.lookup(r->inner.state, hostname, firstIPstr, maxSize)
+                         : dnslookup_system(hostname, firstIPstr, maxSize);
+    leave(r);
+    return rv;
+}
+
+static int ratelimit_lookup_all(void* state, const char* hostname, dnsaddr* addrs, int maxAddrs, int* count) {
+    ratelimit* r = state;
+    int rv;
+    enter(r);
+    rv = r->inner.lookup_all ? r->inner.lookup_all(r->inner.state, hostname, addrs, maxAddrs, count)
+                             : dnslookup_all_system(hostname, addrs, maxAddrs, count);
+    leave(r);
+    return rv;
+}
+
+int ratelimit_parse(const char* spec, double* rate, int* burst) {
+    char* end;
+    *rate = strtod(spec, &end);
+    if (end == spec || *rate <= 0) return -1;
+    if (*end == ':') {
+        const char* b = end + 1;
+        long n = strtol(b, &end, 10);
+        if (end == b || n <= 0) return -1;
+        *burst = (int)n;
+    } else {
+        *burst = (int)(*rate / 10);
+    }
+    if (*end != '\0') return -1;
+    if (*burst < 1) *burst = 1;
+    return 0;
+}
+
+int ratelimit_init(ratelimit* r, const dnsbackend* inner, double rate, int burst, int max_inflight,
+                   dnsbackend* out) {
+    memset(r, 0, sizeof(*r));
+    if (inner) r->inner = *inner;
+    r->rate = rate;
+    r->burst = burst > 0 ? burst : 1;
+    // About a millisecond's worth per chunk, never more than a burst
+    r->chunk = (int)(rate / 1000);
+    if (r->chunk > RATELIMIT_CHUNK_MAX) r->chunk = RATELIMIT_CHUNK_MAX;
+    if (r->chunk > r->burst) r->chunk = r->burst;
+    if (r->chunk < 1) r->chunk = 1;
+    r->interval_ns = rate > 0 ? (uint64_t)(1e9 / rate) : 0;
+    if (rate > 0 && r->interval_ns == 0) return -1;
+    r->max_inflight = max_inflight;
+    atomic_init(&r->tat, 0);
+    atomic_init(&r->inflight, 0);
+    atomic_init(&r->queries, 0);
+    atomic_init(&r->rate_waits, 0);
+    atomic_init(&r->rate_wait_ns, 0);
+    atomic_init(&r->inflight_waits, 0);
+    atomic_init(&r->inflight_wait_ns, 0);
+    atomic_init(&r->peak_inflight, 0);
+    atomic_init(&r->waiting, 0);
+    if (pthread_mutex_init(&r->lock, NULL) || pthread_cond_init(&r->slot, NULL)) return -1;
+    memset(out, 0, sizeof(*out));
+    out->name = inner && inner->name ? inner->name : "getaddrinfo";
+    out->lookup = ratelimit_lookup;
+    out->lookup_all = ratelimit_lookup_all;
+    out->state = r;
+    return 0;
+}
+
+void ratelimit_cleanup(ratelimit* r) {
+    pthread_mutex_destroy(&r->lock);
+    pthread_cond_destroy(&r->slot);
+}
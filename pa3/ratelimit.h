@@ -0,0 +1,78 @@
+/* ratelimit.h
+ * Akira Youngblood, 2026-10-17
+ * Query rate limit and in-flight cap toward the upstream resolver
+ * (multi-lookup's -L and -I)
+ *
+ * Upstream resolvers throttle clients that send too fast: queries get
+ * dropped or refused, and a run with many threads ends up slower than one
+ * with few. This caps what reaches the backend, across every thread:
+ *
+ *   - rate: a token bucket of rate queries/s holding up to burst tokens.
+ *     The bucket is one atomic "theoretical arrival time" (GCRA): taking n
+ *     tokens is one compare-and-swap that moves it n intervals ahead, and
+ *     refilling is just time passing. Threads take tokens in chunks of
+ *     about a millisecond's worth into a cache of their own and spend those
+ *     with no shared access at all; a cached token that isn't spent within
+ *     RATELIMIT_CACHE_MS is dropped, so idle caches can't add up to a burst.
+ *     With the bucket empty, a thread reserves the next token and sleeps
+ *     until it is due, so waiters wake one at a time, in order.
+ *   - in flight: at most max lookups inside the backend at once, one atomic
+ *     counter. Only when it is at the cap does a thread take a lock, to
+ *     sleep until a lookup leaves.
+ *
+ * ratelimit_init() wraps an existing backend into a new one to hand to
+ * dnslookup_set_backend(), so everything that calls dnslookup() is limited,
+ * including hedge.h's retries and hedges, which are queries like any other.
+ */
+
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "util.h"
+
+#define RATELIMIT_CHUNK_MAX 64   // tokens a thread takes at once, at most
+#define RATELIMIT_CACHE_MS 10
+
+typedef struct ratelimit_s {
+    dnsbackend inner;            // lookup NULL: getaddrinfo()
+    double rate;                 // queries/s, 0: no limit
+    int burst;
+    int chunk;
+    uint64_t interval_ns;        // between two tokens
+    atomic_ullong tat;           // when the bucket will be full again
+    int max_inflight;            // 0: no cap
+    atomic_int inflight;
+    pthread_mutex_t lock;        // for waiting at the cap
+    pthread_cond_t slot;
+    atomic_int waiting;
+    // Counters
+    atomic_ulong queries;
+    atomic_ulong rate_waits;     // queries that had to wait for a token
+    atomic_ullong rate_wait_ns;
+    atomic_ulong inflight_waits; // ... for a slot
+    atomic_ullong inflight_wait_ns;
+    atomic_int peak_inflight;
+} ratelimit;
+
+/* Parse "rate[:burst]" for -L, burst defaults to a tenth of a second's worth
+ * Returns 0 on success, -1 if malformed
+ */
+int ratelimit_parse(const char* spec, double* rate, int* burst);
+
+/* Wrap inner (NULL: getaddrinfo()) into out, a backend that sends at most
+ * rate queries/s (0: no limit) in bursts of up to burst, with at most
+ * max_inflight (0: no cap) in progress at once
+ * Returns 0 on success, -1 on failure
+ */
+int ratelimit_init(ratelimit* r, const dnsbackend* inner, double rate, int burst, int max_inflight,
+                   dnsbackend* out);
+
+/* Free what ratelimit_init() set up; nothing may be using out anymore
+ */
+void ratelimit_cleanup(ratelimit* r);
+
+#endif
@@ -0,0 +1,71 @@
+/* spsc.c
+ * Akira Youngblood, 2026-10-17
+ * Single-producer/single-consumer bounded ring
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "spsc.h"
+
+int spsc_init(spsc_ring* r, int size) {
+    size_t cap = 1;
+    if (size <= 0) size = QUEUEMAXSIZE;
+    // Round up to a power of two so positions wrap with a mask
+    while (cap < (size_t)size) cap <<= 1;
+
+    r->slots = malloc(sizeof(void*) * cap);
+    if (!r->slots) {
+        perror("Error on spsc malloc");
+        return QUEUE_FAILURE;
+    }
+    r->mask = cap - 1;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    r->tail_seen = 0;
+    r->head_seen = 0;
+    return (int)cap;
+}
+
+int spsc_push_batch(spsc_ring* r, void** payloads, int n) {
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    size_t room = r->mask + 1 - (tail - r->head_seen);
+    int i;
+    if (room < (size_t)n) {
+        // Looks full: see how far the consumer has got since
+        r->head_seen = atomic_load_explicit(&r->head, memory_order_acquire);
+        room = r->mask + 1 - (tail - r->head_seen);
+    }
+    if ((size_t)n > room) n = (int)room;
+    for (i = 0; i < n; ++i) r->slots[(tail + i) & r->mask] = payloads[i];
+    // Publish the slots and the new tail together
+    if (n > 0) atomic_store_explicit(&r->tail, tail + n, memory_order_release);
+    return n;
+}
+
+int spsc_pop_batch(spsc_ring* r, void** payloads, int max) {
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    size_t avail = r->tail_seen - head;
+    int i;
+    if (avail < (size_t)max) {
+        // Looks empty (or short): see what the producer has added since
+        r->tail_seen = atomic_load_explicit(&r->tail, memory_order_acquire);
+        avail = r->tail_seen - head;
+    }
+    if ((size_t)max > avail) max = (int)avail;
+    for (i = 0; i < max; ++i) payloads[i] = r->slots[(head + i) & r->mask];
+    // Hand the slots back only once they have been read
+    if (max > 0) atomic_store_explicit(&r->head, head + max, memory_order_release);
+    return max;
+}
+
+int spsc_depth(spsc_ring* r) {
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    return tail > head ? (int)(tail - head) : 0;
+}
+
+void spsc_cleanup(spsc_ring* r) {
+    free(r->slots);
+    r->slots = NULL;
+}
@@ -0,0 +1,59 @@
+/* spsc.h
+ * Akira Youngblood, 2026-10-17
+ * Single-producer/single-consumer bounded ring
+ *
+ * One thread pushes and one other thread pops, nobody else touches it, so
+ * neither side needs a CAS: the producer alone moves tail, the consumer alone
+ * moves head, and each publishes its index with a release store. Both calls
+ * finish in a bounded number of steps whatever the other side is doing.
+ *
+ * Each side also keeps a private copy of the other's index and only reloads
+ * it (the one read of a line the other side writes) when the copy says the
+ * ring is full or empty, so a steady stream of pushes and pops mostly stays
+ * on each side's own cache line.
+ */
+
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "lfqueue.h" // LFQUEUE_CACHE_LINE, QUEUE_SUCCESS, QUEUE_FAILURE
+
+typedef struct spsc_ring_s {
+    // The consumer's line
+    _Alignas(LFQUEUE_CACHE_LINE) atomic_size_t head; // next slot to pop
+    size_t tail_seen;                                // last tail it loaded
+    // The producer's line
+    _Alignas(LFQUEUE_CACHE_LINE) atomic_size_t tail; // next slot to push
+    size_t head_seen;                                // last head it loaded
+    // Read-only after spsc_init()
+    _Alignas(LFQUEUE_CACHE_LINE) void** slots;
+    size_t mask;
+} spsc_ring;
+
+/* Initialize a ring with room for at least size payloads
+ * (rounded up to a power of two, QUEUEMAXSIZE if size <= 0)
+ * On success, returns ring size
+ * On failure, returns QUEUE_FAILURE
+ */
+int spsc_init(spsc_ring* r, int size);
+
+/* Producer only: add up to n payloads without blocking
+ * Returns the number added, 0 if the ring is full
+ */
+int spsc_push_batch(spsc_ring* r, void** payloads, int n);
+
+/* Consumer only: take up to max payloads without blocking
+ * Returns the number taken, 0 if the ring is empty
+ */
+int spsc_pop_batch(spsc_ring* r, void** payloads, int max);
+
+/* Payloads in the ring, from any thread, for monitoring only */
+int spsc_depth(spsc_ring* r);
+
+/* Free ring memory */
+void spsc_cleanup(spsc_ring* r);
+
+#endif
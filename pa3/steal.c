@@ -0,0 +1,219 @@
+/* steal.c
+ * Akira Youngblood, 2026-10-17
+ * Work-stealing scheduler for multi-lookup (-w)
+ */
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "steal.h"
+
+#define MASK (STEAL_DEQUE_SIZE - 1)
+
+// Names in the deque, a snapshot
+static long deque_size(steal_deque* d) {
+    long n = atomic_load_explicit(&d->bottom, memory_order_relaxed) -
+             atomic_load_explicit(&d->top, memory_order_relaxed);
+    return n > 0 ? n : 0;
+}
+
+// Owner only. Fails (-1) if the deque is full.
+static int deque_push(steal_deque* d, const char* name) {
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    if (b - t > MASK) return -1;
+    atomic_store_explicit(&d->slots[b & MASK], name, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return 0;
+}
+
+// Owner only: newest name, or NULL if empty. The last name is raced for
+// against thieves on top.
+static const char* deque_pop(steal_deque* d) {
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&d->top, memory_order_relaxed);
+    const char* name = NULL;
+    if (t <= b) {
+        name = atomic_load_explicit(&d->slots[b & MASK], memory_order_relaxed);
+        if (t == b) {
+            if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                    memory_order_seq_cst, memory_order_relaxed)) {
+                name = NULL; // a thief got it
+            }
+            atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        }
+    } else {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return name;
+}
+
+// Any thread: oldest name. Returns 1 and sets *name, 0 if the deque is
+// empty, -1 if another thread took it first.
+static int deque_steal(steal_deque* d, const char** name) {
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (t >= b) return 0;
+    *name = atomic_load_explicit(&d->slots[t & MASK], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+            memory_order_seq_cst, memory_order_relaxed)) {
+        return -1;
+    }
+    return 1;
+}
+
+// Nothing to do right now: yield for a while, then nap, longer the longer
+// it lasts (up to 1 ms), so idle workers don't eat a core while the others
+// finish their lookups
+static void backoff(int* spins) {
+    if (*spins < 16) {
+        sched_yield();
+    } else {
+        long us = 50L << ((*spins - 16) / 16);
+        struct timespec nap = { 0, (us < 1000 ? us : 1000) * 1000 };
+        nanosleep(&nap, NULL);
+    }
+    (*spins)++;
+}
+
+int steal_init(steal_sched* s, int nworkers) {
+    int i;
+    memset(s, 0, sizeof(*s));
+    // Deques are cache line aligned, plain calloc() only promises 16 bytes
+    s->workers = aligned_alloc(STEAL_CACHE_LINE, sizeof(steal_worker) * nworkers);
+    if (s->workers == NULL) return -1;
+    memset(s->workers, 0, sizeof(steal_worker) * nworkers);
+    for (i = 0; i < nworkers; ++i) {
+        s->workers[i].seed = 2654435761u * (i + 1);
+    }
+    s->nworkers = nworkers;
+    atomic_init(&s->next, 0);
+    atomic_init(&s->unfinished, 0);
+    return 0;
+}
+
+int steal_add_input(steal_sched* s, const mapped_file* file) {
+    const char* p = file->base;
+    const char* end = p + file->size;
+    if (p == NULL) return 0;
+    // Cut at the first delimiter at or after each multiple of the chunk size
+    while (p < end) {
+        const char* cut = end;
+        if ((size_t)(end - p) > STEAL_CHUNK_SIZE) {
+            cut = mapinput_name_end(p + STEAL_CHUNK_SIZE - 1, end);
+        }
+        if (s->nchunks == s->capchunks) {
+            int cap = s->capchunks ? s->capchunks * 2 : 64;
+            steal_chunk* chunks = realloc(s->chunks, sizeof(steal_chunk) * cap);
+            if (chunks == NULL) return -1;
+            s->chunks = chunks;
+            s->capchunks = cap;
+        }
+        s->chunks[s->nchunks].begin = p;
+        s->chunks[s->nchunks++].end = cut;
+        p = cut;
+    }
+    return 0;
+}
+
+// Move up to STEAL_REFILL names from the worker's chunk into its deque,
+// claiming a new chunk first if it has none
+// Returns 0 once no chunks are left to claim, 1 otherwise
+static int refill(steal_sched* s, steal_worker* w) {
+    size_t len;
+    int n;
+    if (w->cursor == NULL) {
+        // Idle workers land here on every pass, look before claiming so
+        // the counter isn't bumped (and its line bounced) once all are gone
+        if (atomic_load_explicit(&s->next, memory_order_relaxed) >= s->nchunks) {
+            return 0;
+        }
+        // Count the chunk as unfinished before claiming it, so no other
+        // worker can see "nothing left" while it isn't split yet
+        atomic_fetch_add(&s->unfinished, 1);
+        int c = atomic_fetch_add(&s->next, 1);
+        if (c >= s->nchunks) {
+            atomic_fetch_sub(&s->unfinished, 1);
+            return 0;
+        }
+        w->cursor = s->chunks[c].begin;
+        w->end = s->chunks[c].end;
+        w->chunks++;
+    }
+    for (n = 0; n < STEAL_REFILL; ++n) {
+        const char* name = mapinput_next(w->cursor, w->end, &len);
+        if (name == NULL) {
+            w->cursor = w->end;
+            break;
+        }
+        atomic_fetch_add(&s->unfinished, 1);
+        if (deque_push(&w->deque, name)) {
+            // Full, leave the rest in the chunk for later
+            atomic_fetch_sub(&s->unfinished, 1);
+            w->cursor = name;
+            break;
+        }
+        w->cursor = name + len;
+    }
+    if (w->cursor >= w->end) {
+        // Chunk split up, its names are counted on their own now
+        w->cursor = NULL;
+        atomic_fetch_sub(&s->unfinished, 1);
+    }
+    return 1;
+}
+
+const char* steal_next(steal_sched* s, int id) {
+    steal_worker* w = &s->workers[id];
+    const char* name;
+    int spins = 0, i;
+    // Keep names from the chunk in hand topped up, so thieves find some
+    // while this worker is busy with its next lookup
+    if (w->cursor && deque_size(&w->deque) < STEAL_REFILL / 2) refill(s, w);
+    for (;;) {
+        if ((name = deque_pop(&w->deque)) != NULL) return name;
+        if (refill(s, w)) continue;
+        // No chunks left, take the oldest name of another worker, starting
+        // at a random one so thieves spread out
+        int start = (int)((w->seed = w->seed * 1103515245u + 12345u) >> 16) % s->nworkers;
+        for (i = 0; i < s->nworkers; ++i) {
+            steal_worker* victim = &s->workers[(start + i) % s->nworkers];
+            int rv;
+            if (victim == w) continue;
+            while ((rv = deque_steal(&victim->deque, &name)) < 0) w->steal_races++;
+            if (rv > 0) {
+                w->stolen++;
+                return name;
+            }
+        }
+        if (atomic_load(&s->unfinished) == 0) return NULL;
+        backoff(&spins);
+    }
+}
+
+void steal_done(steal_sched* s) {
+    atomic_fetch_sub_explicit(&s->unfinished, 1, memory_order_release);
+}
+
+int steal_depth(void* arg) {
+    steal_sched* s = arg;
+    long depth = 0;
+    int i;
+    for (i = 0; i < s->nworkers; ++i) {
+        depth += deque_size(&s->workers[i].deque);
+    }
+    return (int)depth;
+}
+
+void steal_cleanup(steal_sched* s) {
+    free(s->chunks);
+    free(s->workers);
+    s->chunks = NULL;
+    s->workers = NULL;
+}
@@ -0,0 +1,93 @@
+/* steal.h
+ * Akira Youngblood, 2026-10-17
+ * Work-stealing scheduler for multi-lookup (-w)
+ *
+ * Replaces the requester threads and the shared queue. The mapped input
+ * files are cut into byte-range chunks of about STEAL_CHUNK_SIZE bytes, split
+ * at whitespace so no name straddles two chunks. Every worker claims whole
+ * chunks from a shared counter and splits them, STEAL_REFILL names at a
+ * time, into a deque of its own (a Chase-Lev deque: the owner pushes and
+ * pops at the bottom without a lock, thieves take from the top with one
+ * CAS). A worker whose deque is empty and who finds no chunk left steals
+ * names from the other workers' deques, so one huge input file is shared
+ * out like any other and a worker stuck on a slow lookup doesn't hold back
+ * the names queued behind it.
+ *
+ * Everything is finished when no chunk is left to claim and the count of
+ * unfinished work (chunks being split plus names not yet resolved) is zero.
+ */
+
+#ifndef STEAL_H
+#define STEAL_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "mapinput.h"
+
+#define STEAL_CHUNK_SIZE 4096 // bytes of input per chunk
+#define STEAL_REFILL 32       // names moved from a chunk to the deque at once
+#define STEAL_DEQUE_SIZE 64   // deque slots, a power of two >= STEAL_REFILL
+#define STEAL_CACHE_LINE 64
+
+typedef struct steal_deque_s {
+    _Alignas(STEAL_CACHE_LINE) atomic_long top;    // thieves take here
+    _Alignas(STEAL_CACHE_LINE) atomic_long bottom; // owner pushes/pops here
+    _Alignas(STEAL_CACHE_LINE) _Atomic(const char*) slots[STEAL_DEQUE_SIZE];
+} steal_deque;
+
+typedef struct steal_chunk_s {
+    const char* begin;
+    const char* end;
+} steal_chunk;
+
+typedef struct steal_worker_s {
+    steal_deque deque;
+    // Chunk being split, owned by this worker alone (NULL: none)
+    const char* cursor;
+    const char* end;
+    unsigned seed; // picks steal victims
+    // Counters, written by the owner only
+    unsigned long chunks;      // chunks claimed
+    unsigned long stolen;      // names taken from other workers
+    unsigned long steal_races; // steals lost to another thread
+} steal_worker;
+
+typedef struct steal_sched_s {
+    steal_chunk* chunks;
+    int nchunks;
+    int capchunks;
+    steal_worker* workers;
+    int nworkers;
+    _Alignas(STEAL_CACHE_LINE) atomic_int next; // next chunk to claim
+    _Alignas(STEAL_CACHE_LINE) atomic_long unfinished;
+} steal_sched;
+
+/* Set up a scheduler for nworkers workers, with no input yet
+ * Returns 0 on success, -1 on failure
+ */
+int steal_init(steal_sched* s, int nworkers);
+
+/* Cut a mapped input file (see mapinput.h) into chunks, after those added
+ * before it. Call before any worker starts.
+ * Returns 0 on success, -1 on failure
+ */
+int steal_add_input(steal_sched* s, const mapped_file* file);
+
+/* Next hostname for worker id (a pointer into a mapping), napping while
+ * other workers still have names in hand
+ * Returns NULL once every name has been handed out and resolved
+ */
+const char* steal_next(steal_sched* s, int id);
+
+/* Worker is finished with a name from steal_next() */
+void steal_done(steal_sched* s);
+
+/* Names waiting in deques, for the queue depth sampler (arg is the
+ * steal_sched), a snapshot like lfqueue_depth()
+ */
+int steal_depth(void* arg);
+
+void steal_cleanup(steal_sched* s);
+
+#endif
@@ -0,0 +1,108 @@
+/* cache-tool.c
+ * Akira Youngblood, 2026-10-17
+ * Maintenance for multi-lookup's persistent cache file (-p, diskcache.c)
+ *
+ * Usage:
+ *   cache-tool stats file            count live, expired and empty slots
+ *   cache-tool rebuild file [slots]  drop expired entries and rehash into a
+ *                                    fresh table (default: keep the size, or
+ *                                    grow it to stay under half full)
+ *
+ * rebuild writes file.tmp and renames it over file, so a crash leaves the
+ * old cache intact. Like multi-lookup, it refuses to touch a file that a
+ * running multi-lookup has open.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../diskcache.h"
+
+static int Stats(const char* path) {
+    diskcache dc;
+    unsigned long positive = 0, negative = 0, expired = 0, empty = 0;
+    uint32_t i;
+    int64_t now = time(NULL);
+
+    if (diskcache_open(&dc, path, 0)) return EXIT_FAILURE;
+    for (i = 0; i <= dc.mask; ++i) {
+        diskcache_slot* slot = &dc.slots[i];
+        if (slot->hash == 0) empty++;
+        else if (slot->expires <= now) expired++;
+        else if (slot->state == DISKCACHE_POSITIVE) positive++;
+        else negative++;
+    }
+    printf("%s: %u slots, %lu positive, %lu negative, %lu expired, %lu empty (%.1f%% used)\n",
+           path, dc.mask + 1, positive, negative, expired, empty,
+           100.0 * (dc.mask + 1 - empty) / (dc.mask + 1));
+    diskcache_close(&dc);
+    return EXIT_SUCCESS;
+}
+
+static int Rebuild(const char* path, int nslots) {
+    diskcache old, fresh;
+    char tmp[4096];
+    unsigned long live = 0, dropped = 0, lost = 0;
+    uint32_t i, j;
+    int64_t now = time(NULL);
+
+    if (diskcache_open(&old, path, 0)) return EXIT_FAILURE;
+    for (i = 0; i <= old.mask; ++i) {
+        if (old.slots[i].hash != 0 && old.slots[i].expires > now) live++;
+    }
+    if (nslots <= 0) {
+        nslots = old.mask + 1;
+        while ((unsigned long)nslots < live * 2) nslots *= 2;
+    }
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    unlink(tmp);
+    if (diskcache_open(&fresh, tmp, nslots)) {
+        diskcache_close(&old);
+        return EXIT_FAILURE;
+    }
+    // Only hashes are stored, which is all placement needs
+    for (i = 0; i <= old.mask; ++i) {
+        diskcache_slot* slot = &old.slots[i];
+        if (slot->hash == 0) continue;
+        if (slot->expires <= now) {
+            dropped++;
+            continue;
+        }
+        uint32_t home = diskcache_home(slot->hash, fresh.mask);
+        for (j = 0; j < DISKCACHE_PROBES; ++j) {
+            diskcache_slot* dst = &fresh.slots[(home + j) & fresh.mask];
+            if (dst->hash == 0) {
+                *dst = *slot;
+                break;
+            }
+        }
+        if (j == DISKCACHE_PROBES) lost++;
+    }
+    uint32_t newslots = fresh.mask + 1;
+    diskcache_close(&fresh);
+    diskcache_close(&old);
+    if (rename(tmp, path) < 0) {
+        perror("Error replacing cache file");
+        return EXIT_FAILURE;
+    }
+    printf("%s: kept %lu, dropped %lu expired, %lu did not fit, now %u slots\n",
+           path, live - lost, dropped, lost, newslots);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 3 && strcmp(argv[1], "stats") == 0) {
+        return Stats(argv[2]);
+    }
+    if (argc >= 3 && strcmp(argv[1], "rebuild") == 0) {
+        return Rebuild(argv[2], argc > 3 ? atoi(argv[3]) : 0);
+    }
+    fprintf(stderr, "Usage:\n"
+                    "  %s stats file\n"
+                    "  %s rebuild file [slots]\n", argv[0], argv[0]);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,206 @@
+/* dns-stub.c
+ * Akira Youngblood, 2026-10-17
+ * Stub DNS server for testing multi-lookup's async resolver offline
+ *
+ * Answers every A/AAAA query on 127.0.0.1 with an address derived from a hash
+ * of the name (A: 10.x.y.z, AAAA: fd00::/8), so results are deterministic.
+ * Names under .invalid get NXDOMAIN. Can drop a percentage of queries to
+ * exercise retransmission, and hold every answer back for a fixed latency to
+ * stand in for a real upstream in benchmarks. With -r, it throttles like a
+ * busy upstream: queries past qps per second (in bursts of up to a tenth of
+ * that) are dropped.
+ *
+ * Usage: dns-stub [-b bind address] [-p port] [-t ttl] [-d drop percent]
+ *                 [-l latency ms] [-r qps]
+ */
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../dnsproto.h"
+
+// Answers held back for -l. Every answer waits the same time, so a FIFO
+// ring is already in due order.
+#define DELAY_SLOTS 16384
+
+typedef struct {
+    long long due; // ms, CLOCK_MONOTONIC
+    struct sockaddr_storage peer;
+    socklen_t peerlen;
+    int len;
+    unsigned char buf[DNS_MAX_PACKET];
+} delayed_answer;
+
+static delayed_answer delayed[DELAY_SLOTS];
+static int delay_head, delay_count;
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint32_t hash_name(const char* name) {
+    // FNV-1a over the lowercased name
+    uint32_t h = 2166136261u;
+    for (; *name; ++name) {
+        h ^= (unsigned char)tolower((unsigned char)*name);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int ends_with(const char* name, const char* suffix) {
+    size_t n = strlen(name), m = strlen(suffix);
+    if (n > 0 && name[n-1] == '.') n--;
+    return n >= m && strncasecmp(name + n - m, suffix, m) == 0;
+}
+
+// Turn the query in buf into an answer, returns the response length
+static int answer(unsigned char* buf, int len, uint32_t ttl) {
+    char name[DNS_MAX_NAME + 2];
+    uint16_t id, qtype;
+    int qend, off, rdlen = 0;
+    unsigned char rdata[16];
+
+    if (dns_parse_question(buf, len, &id, name, sizeof(name), &qtype, &qend) == DNS_FAILURE) return -1;
+
+    uint32_t h = hash_name(name);
+    if (qtype == DNS_TYPE_A) {
+        rdata[0] = 10;
+        rdata[1] = (h >> 16) & 0xFF;
+        rdata[2] = (h >> 8) & 0xFF;
+        rdata[3] = h & 0xFF;
+        rdlen = 4;
+    } else if (qtype == DNS_TYPE_AAAA) {
+        memset(rdata, 0, sizeof(rdata));
+        rdata[0] = 0xFD;
+        rdata[12] = h >> 24;
+        rdata[13] = (h >> 16) & 0xFF;
+        rdata[14] = (h >> 8) & 0xFF;
+        rdata[15] = h & 0xFF;
+        rdlen = 16;
+    }
+
+    // Header: keep ID and RD, set QR and RA, drop anything after the question
+    buf[2] = 0x80 | (buf[2] & 0x01);
+    buf[3] = 0x80;
+    buf[6] = buf[7] = 0;    // ANCOUNT
+    buf[8] = buf[9] = 0;    // NSCOUNT
+    buf[10] = buf[11] = 0;  // ARCOUNT
+    off = qend;
+    if (ends_with(name, ".invalid")) {
+        buf[3] |= DNS_RCODE_NXDOMAIN;
+        return off;
+    }
+    if (rdlen == 0) return off; // NODATA for other types
+
+    buf[7] = 1;
+    buf[off++] = 0xC0;      // name: pointer to the question
+    buf[off++] = DNS_HEADER_SIZE;
+    buf[off++] = qtype >> 8;
+    buf[off++] = qtype & 0xFF;
+    buf[off++] = 0;
+    buf[off++] = DNS_CLASS_IN;
+    buf[off++] = ttl >> 24;
+    buf[off++] = (ttl >> 16) & 0xFF;
+    buf[off++] = (ttl >> 8) & 0xFF;
+    buf[off++] = ttl & 0xFF;
+    buf[off++] = 0;
+    buf[off++] = rdlen;
+    memcpy(buf + off, rdata, rdlen);
+    return off + rdlen;
+}
+
+int main(int argc, char* argv[]) {
+    const char* bind_addr = "127.0.0.1";
+    int port = 5353, drop = 0, latency = 0, qps = 0, opt;
+    double tokens = 0;
+    long long refilled = now_ms();
+    uint32_t ttl = 300;
+    struct sockaddr_in addr;
+
+    while ((opt = getopt(argc, argv, "b:p:t:d:l:r:")) != -1) {
+        switch (opt) {
+            case 'b': bind_addr = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 't': ttl = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'd': drop = atoi(optarg); break;
+            case 'l': latency = atoi(optarg); break;
+            case 'r': qps = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-b bind address] [-p port] [-t ttl] [-d drop percent]"
+                                " [-l latency ms] [-r qps]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (fd < 0 || inet_pton(AF_INET, bind_addr, &addr.sin_addr) != 1 ||
+        bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("Error binding stub DNS server");
+        return EXIT_FAILURE;
+    }
+    int rcvbuf = 1 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    fprintf(stderr, "dns-stub listening on %s:%d\n", bind_addr, port);
+
+    for (;;) {
+        unsigned char buf[DNS_MAX_PACKET];
+        struct sockaddr_storage peer;
+        socklen_t peerlen = sizeof(peer);
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        long long now = now_ms();
+
+        // Send everything that has waited long enough
+        while (delay_count > 0 && delayed[delay_head].due <= now) {
+            delayed_answer* d = &delayed[delay_head];
+            sendto(fd, d->buf, d->len, 0, (struct sockaddr*)&d->peer, d->peerlen);
+            delay_head = (delay_head + 1) % DELAY_SLOTS;
+            delay_count--;
+        }
+        int wait_ms = delay_count > 0 ? (int)(delayed[delay_head].due - now) : -1;
+        if (poll(&pfd, 1, wait_ms) <= 0) continue;
+
+        ssize_t len = recvfrom(fd, buf, sizeof(buf), 0, (struct sockaddr*)&peer, &peerlen);
+        if (len < 0) continue;
+        if (drop > 0 && rand() % 100 < drop) continue;
+        if (qps > 0) {
+            // Token bucket, a tenth of a second deep
+            long long t = now_ms();
+            double depth = qps / 10.0 > 1 ? qps / 10.0 : 1;
+            tokens += (t - refilled) * qps / 1000.0;
+            if (tokens > depth) tokens = depth;
+            refilled = t;
+            if (tokens < 1) continue;
+            tokens--;
+        }
+        int rlen = answer(buf, (int)len, ttl);
+        if (rlen <= 0) continue;
+        if (latency <= 0) {
+            sendto(fd, buf, rlen, 0, (struct sockaddr*)&peer, peerlen);
+        } else if (delay_count < DELAY_SLOTS) {
+            // (a full ring drops the answer, like an overloaded server)
+            delayed_answer* d = &delayed[(delay_head + delay_count) % DELAY_SLOTS];
+            d->due = now_ms() + latency;
+            d->peer = peer;
+            d->peerlen = peerlen;
+            d->len = rlen;
+            memcpy(d->buf, buf, rlen);
+            delay_count++;
+        }
+    }
+}
@@ -0,0 +1,170 @@
+/* lookup-client.c
+ * Akira Youngblood, 2026-10-17
+ * Client for multi-lookup's daemon mode (-U, lookupd.h)
+ *
+ * Sends every hostname in the files (stdin if none) over one connection
+ * without waiting for answers, and prints "hostname,address" lines, like
+ * multi-lookup's output, as the answers come back (completion order). A
+ * writer thread sends while the main thread reads, so neither side of the
+ * socket fills up and stalls the other.
+ *
+ * Usage: lookup-client socket [file ...]
+ * Exits non-zero if the daemon couldn't be reached, or didn't look up every
+ * name (it was stopping, or it went away); failed lookups are printed with
+ * an empty address, as in multi-lookup's output.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../lookupd.h"
+
+typedef struct {
+    int fd;
+    char** names;
+    size_t count;
+    int failed;
+} client;
+
+static int WriteAll(int fd, const unsigned char* buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// Send every request, numbered by position, then shut down the write side
+// so the daemon knows no more are coming
+static void* Writer(void* arg) {
+    client* c = arg;
+    unsigned char buf[65536];
+    size_t i, len = 0;
+    for (i = 0; i < c->count; ++i) {
+        size_t n = strlen(c->names[i]);
+        if (len + 6 + n > sizeof(buf)) {
+            if (WriteAll(c->fd, buf, len)) break;
+            len = 0;
+        }
+        buf[len++] = (4 + n) >> 8;
+        buf[len++] = (4 + n) & 0xFF;
+        buf[len++] = i >> 24;
+        buf[len++] = (i >> 16) & 0xFF;
+        buf[len++] = (i >> 8) & 0xFF;
+        buf[len++] = i & 0xFF;
+        memcpy(buf + len, c->names[i], n);
+        len += n;
+    }
+    if (i < c->count || WriteAll(c->fd, buf, len)) {
+        perror("Error sending requests");
+        c->failed = 1;
+    }
+    shutdown(c->fd, SHUT_WR);
+    return NULL;
+}
+
+// Append every non-empty line of fp to the name list
+static int ReadNames(FILE* fp, client* c, size_t* cap) {
+    char line[LOOKUPD_MAX_NAME + 2];
+    while (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0') continue;
+        if (c->count == *cap) {
+            *cap = *cap ? 2 * *cap : 1024;
+            char** grown = realloc(c->names, *cap * sizeof(char*));
+            if (grown == NULL) return -1;
+            c->names = grown;
+        }
+        if ((c->names[c->count] = strdup(line)) == NULL) return -1;
+        c->count++;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    client c = { -1, NULL, 0, 0 };
+    size_t cap = 0, answered = 0, len = 0, off, i;
+    struct sockaddr_un addr;
+    unsigned char buf[65536 + 2];
+    pthread_t writer;
+    int k;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: lookup-client socket [file ...]\n");
+        return EXIT_FAILURE;
+    }
+    for (k = 2; k < argc || (k == 2 && argc == 2); ++k) {
+        FILE* fp = argc == 2 ? stdin : fopen(argv[k], "r");
+        if (fp == NULL) {
+            fprintf(stderr, "Failed to open input file %s\n", argv[k]);
+            continue;
+        }
+        if (ReadNames(fp, &c, &cap)) {
+            fprintf(stderr, "Out of memory.\n");
+            return EXIT_FAILURE;
+        }
+        if (fp != stdin) fclose(fp);
+    }
+    if (strlen(argv[1]) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, argv[1]);
+    c.fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (c.fd < 0 || connect(c.fd, (struct sockaddr*)&addr, sizeof(addr))) {
+        perror("Error connecting to daemon");
+        return EXIT_FAILURE;
+    }
+    if (pthread_create(&writer, NULL, Writer, &c)) {
+        fprintf(stderr, "Error: failed to create writer thread\n");
+        return EXIT_FAILURE;
+    }
+    // Read responses until the daemon closes the connection
+    for (;;) {
+        ssize_t got = read(c.fd, buf + len, sizeof(buf) - len);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) break;
+        len += got;
+        for (off = 0; len - off >= 2; off += 2 + ((buf[off] << 8) | buf[off + 1])) {
+            size_t flen = (buf[off] << 8) | buf[off + 1];
+            const unsigned char* frame = buf + off + 2;
+            if (len - off < 2 + flen) break;
+            if (flen < 5) continue;
+            uint32_t id = ((uint32_t)frame[0] << 24) | (frame[1] << 16) | (frame[2] << 8) | frame[3];
+            if (id >= c.count) continue;
+            printf("%s,%.*s\n", c.names[id], frame[4] == LOOKUPD_OK ? (int)(flen - 5) : 0,
+                   (const char*)frame + 5);
+            if (frame[4] == LOOKUPD_NOTFOUND) {
+                fprintf(stderr, "dnslookup error: %s\n", c.names[id]);
+            } else if (frame[4] != LOOKUPD_OK) {
+                // Not looked up at all: the daemon is stopping, or refused it
+                fprintf(stderr, "%s: %s\n", c.names[id],
+                        frame[4] == LOOKUPD_SHUTDOWN ? "daemon stopping" : "bad request");
+                c.failed = 1;
+            }
+            answered++;
+        }
+        memmove(buf, buf + off, len - off);
+        len -= off;
+    }
+    pthread_join(writer, NULL);
+    close(c.fd);
+    if (answered < c.count) {
+        fprintf(stderr, "Only %zu of %zu names answered\n", answered, c.count);
+        c.failed = 1;
+    }
+    for (i = 0; i < c.count; ++i) free(c.names[i]);
+    free(c.names);
+    return c.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,73 @@
+/* malloc-count.c
+ * Akira Youngblood, 2026-10-17
+ * Counts a program's allocator calls, glibc only
+ *
+ * Built as a shared library and preloaded, it stands in for malloc() and
+ * friends, counts every call and hands it on to glibc's own allocator
+ * (__libc_malloc() and so on, which glibc exports for this). Calls glibc
+ * makes internally (strdup(), fopen(), getaddrinfo()) are counted too. The
+ * totals go to stderr when the program exits.
+ *
+ * Usage: LD_PRELOAD=tools/malloc-count.so ./multi-lookup ...
+ */
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void* p, size_t size);
+extern void* __libc_memalign(size_t align, size_t size);
+extern void __libc_free(void* p);
+
+void* malloc(size_t size);
+void* calloc(size_t n, size_t size);
+void* realloc(void* p, size_t size);
+int posix_memalign(void** out, size_t align, size_t size);
+void* aligned_alloc(size_t align, size_t size);
+void free(void* p);
+
+static atomic_ulong mallocs, callocs, reallocs, aligned, frees;
+
+void* malloc(size_t size) {
+    atomic_fetch_add_explicit(&mallocs, 1, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) {
+    atomic_fetch_add_explicit(&callocs, 1, memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, size_t size) {
+    atomic_fetch_add_explicit(&reallocs, 1, memory_order_relaxed);
+    return __libc_realloc(p, size);
+}
+
+int posix_memalign(void** out, size_t align, size_t size) {
+    void* p;
+    atomic_fetch_add_explicit(&aligned, 1, memory_order_relaxed);
+    p = __libc_memalign(align, size);
+    if (p == NULL) return ENOMEM;
+    *out = p;
+    return 0;
+}
+
+void* aligned_alloc(size_t align, size_t size) {
+    atomic_fetch_add_explicit(&aligned, 1, memory_order_relaxed);
+    return __libc_memalign(align, size);
+}
+
+void free(void* p) {
+    if (p == NULL) return;
+    atomic_fetch_add_explicit(&frees, 1, memory_order_relaxed);
+    __libc_free(p);
+}
+
+__attribute__((destructor)) static void report(void) {
+    fprintf(stderr, "malloc-count: %lu malloc, %lu calloc, %lu realloc, %lu aligned, %lu free\n",
+            atomic_load(&mallocs), atomic_load(&callocs), atomic_load(&reallocs),
+            atomic_load(&aligned), atomic_load(&frees));
+}
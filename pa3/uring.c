@@ -0,0 +1,332 @@
+/* uring.c
+ * Akira Youngblood, 2026-10-17
+ * io_uring file input and output for multi-lookup (-u)
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "uring.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_RW_CUR_POS)
+#define HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+// Each reader buffer: room for the carried-over name, the read itself, and
+// zeros past it for mapinput_next()'s 16 byte block loads
+#define READ_PAD 64
+#define READ_STRIDE (URING_READ_KEEP + URING_READ_SIZE + READ_PAD)
+
+#ifdef HAVE_IO_URING
+
+static int sys_enter(int fd, unsigned submit, unsigned wait, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, submit, wait, flags, NULL, 0);
+}
+
+static void unmap(uring* r) {
+    if (r->sqes) munmap(r->sqes, r->sqes_size);
+    if (r->cq_map && r->cq_map != r->sq_map) munmap(r->cq_map, r->cq_map_size);
+    if (r->sq_map) munmap(r->sq_map, r->sq_map_size);
+}
+
+int uring_init(uring* r, unsigned entries) {
+    struct io_uring_params p;
+    char *sq, *cq;
+    int fd;
+
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+    memset(&p, 0, sizeof(p));
+    fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0) return -1;
+    // IORING_OP_READ and _WRITE came with this feature bit (5.6)
+    if (!(p.features & IORING_FEAT_RW_CUR_POS)) {
+        close(fd);
+        return -1;
+    }
+    r->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_map_size > r->sq_map_size) r->sq_map_size = r->cq_map_size;
+        r->cq_map_size = r->sq_map_size;
+    }
+    sq = mmap(NULL, r->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+              IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) goto fail;
+    r->sq_map = sq;
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        cq = sq;
+    } else {
+        cq = mmap(NULL, r->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                  IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) goto fail;
+    }
+    r->cq_map = cq;
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                   IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        r->sqes = NULL;
+        goto fail;
+    }
+    r->sq_head = (unsigned*)(sq + p.sq_off.head);
+    r->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned*)(sq + p.sq_off.array);
+    r->cq_head = (unsigned*)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    r->cqes = cq + p.cq_off.cqes;
+    r->fd = fd;
+    return 0;
+
+fail:
+    unmap(r);
+    close(fd);
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+    return -1;
+}
+
+// Put one entry on the submission ring and have the kernel take it
+static int submit(uring* r, const struct io_uring_sqe* sqe) {
+    // Only this thread moves the tail, the kernel moves the head
+    unsigned tail = *r->sq_tail;
+    unsigned head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    unsigned i = tail & *r->sq_mask;
+    if (tail - head > *r->sq_mask) return -1;
+    ((struct io_uring_sqe*)r->sqes)[i] = *sqe;
+    r->sq_array[i] = i;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    for (;;) {
+        if (sys_enter(r->fd, 1, 0, 0) >= 0) return 0;
+        if (errno == EINTR) continue;
+        // Not taken: the kernel only reads the ring inside io_uring_enter(),
+        // so the entry can be withdrawn before the next one goes after it
+        if (__atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) == tail) {
+            __atomic_store_n(r->sq_tail, tail, __ATOMIC_RELEASE);
+        }
+        return -1;
+    }
+}
+
+int uring_read(uring* r, int fd, void* buf, unsigned len, uint64_t off, int fixed, uint64_t tag) {
+    struct io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    // A fixed read names its registered buffer by index, there's only 0
+    sqe.opcode = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe.fd = fd;
+    sqe.addr = (uintptr_t)buf;
+    sqe.len = len;
+    sqe.off = off;
+    sqe.user_data = tag;
+    return submit(r, &sqe);
+}
+
+int uring_write(uring* r, int fd, const void* buf, unsigned len, uint64_t off, uint64_t tag) {
+    struct io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_WRITE;
+    sqe.fd = fd;
+    sqe.addr = (uintptr_t)buf;
+    sqe.len = len;
+    sqe.off = off;
+    sqe.user_data = tag;
+    return submit(r, &sqe);
+}
+
+int uring_register(uring* r, void* buf, size_t len) {
+    struct iovec iov = { buf, len };
+    return syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_BUFFERS, &iov, 1) < 0 ? -1 : 0;
+}
+
+int uring_wait(uring* r, uring_result* out) {
+    for (;;) {
+        unsigned head = *r->cq_head;
+        if (head != __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+            const struct io_uring_cqe* cqe = (const struct io_uring_cqe*)r->cqes + (head & *r->cq_mask);
+            out->tag = cqe->user_data;
+            out->res = cqe->res;
+            __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+            return 0;
+        }
+        if (sys_enter(r->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) return -1;
+    }
+}
+
+void uring_cleanup(uring* r) {
+    if (r->fd < 0) return;
+    unmap(r);
+    close(r->fd);
+    r->fd = -1;
+}
+
+#else
+
+// No io_uring in this build: every ring fails to set up, and callers read
+// and write the usual way
+
+int uring_init(uring* r, unsigned entries) {
+    (void)entries;
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+    errno = ENOSYS;
+    return -1;
+}
+
+int uring_read(uring* r, int fd, void* buf, unsigned len, uint64_t off, int fixed, uint64_t tag) {
+    (void)r; (void)fd; (void)buf; (void)len; (void)off; (void)fixed; (void)tag;
+    return -1;
+}
+
+int uring_write(uring* r, int fd, const void* buf, unsigned len, uint64_t off, uint64_t tag) {
+    (void)r; (void)fd; (void)buf; (void)len; (void)off; (void)tag;
+    return -1;
+}
+
+int uring_register(uring* r, void* buf, size_t len) {
+    (void)r; (void)buf; (void)len;
+    return -1;
+}
+
+int uring_wait(uring* r, uring_result* out) {
+    (void)r; (void)out;
+    return -1;
+}
+
+void uring_cleanup(uring* r) {
+    r->fd = -1;
+}
+
+#endif
+
+int uring_supported(void) {
+    static int supported = -1;
+    if (supported < 0) {
+        uring r;
+        supported = uring_init(&r, 2) == 0;
+        uring_cleanup(&r);
+    }
+    return supported;
+}
+
+static char* reader_buf(uring_reader* rd, int i) {
+    return rd->mem + (size_t)i * READ_STRIDE;
+}
+
+// Start buffer i's read of the next stretch of the file, if any is left
+static int reader_issue(uring_reader* rd, int i) {
+    uint64_t left = rd->size > rd->next_off ? rd->size - rd->next_off : 0;
+    rd->slot[i].off = rd->next_off;
+    rd->slot[i].want = left < URING_READ_SIZE ? (unsigned)left : URING_READ_SIZE;
+    rd->slot[i].res = 0;
+    rd->slot[i].done = rd->slot[i].want == 0;
+    rd->next_off += rd->slot[i].want;
+    if (rd->slot[i].done) return 0;
+    if (uring_read(&rd->ring, rd->fd, reader_buf(rd, i) + URING_READ_KEEP, rd->slot[i].want,
+                   rd->slot[i].off, rd->fixed, i)) {
+        rd->slot[i].res = -EIO;
+        rd->slot[i].done = 1;
+        return -1;
+    }
+    rd->pending++;
+    return 0;
+}
+
+int uring_reader_init(uring_reader* rd, int fd) {
+    struct stat st;
+    void* mem;
+    int i;
+
+    memset(rd, 0, sizeof(*rd));
+    rd->ring.fd = -1;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) return -1;
+    if (posix_memalign(&mem, 4096, (size_t)URING_READ_DEPTH * READ_STRIDE)) return -1;
+    if (uring_init(&rd->ring, URING_READ_DEPTH)) {
+        free(mem);
+        return -1;
+    }
+    rd->mem = mem;
+    rd->fd = fd;
+    rd->size = st.st_size;
+    rd->current = -1;
+    // Registered, the kernel pins the pages once instead of on every read.
+    // Past the memlock limit it can't, and plain reads will do.
+    rd->fixed = uring_register(&rd->ring, rd->mem, (size_t)URING_READ_DEPTH * READ_STRIDE) == 0;
+    for (i = 0; i < URING_READ_DEPTH; ++i) {
+        reader_issue(rd, i);
+    }
+    return 0;
+}
+
+ssize_t uring_reader_next(uring_reader* rd, size_t keep, char** data, int* last) {
+    int i = rd->head;
+    char* buf = reader_buf(rd, i);
+    uring_result res;
+
+    if (keep > rd->current_len) keep = rd->current_len;
+    if (keep > URING_READ_KEEP) keep = URING_READ_KEEP;
+    if (rd->current >= 0) {
+        // Carry the tail of the last chunk over, then its buffer can take
+        // the next read (the read into buffer i never touches its front)
+        char* prev = reader_buf(rd, rd->current) + URING_READ_KEEP + rd->slot[rd->current].res;
+        memcpy(buf + URING_READ_KEEP - keep, prev - keep, keep);
+        reader_issue(rd, rd->current);
+    }
+    rd->current = -1;
+    while (!rd->slot[i].done) {
+        if (uring_wait(&rd->ring, &res)) return -1;
+        rd->slot[res.tag].res = res.res;
+        rd->slot[res.tag].done = 1;
+        rd->pending--;
+    }
+    if (rd->slot[i].res < 0) {
+        errno = -rd->slot[i].res;
+        return -1;
+    }
+    // A short read isn't the end of the file, it was sized: finish it here
+    *last = rd->slot[i].off + rd->slot[i].want >= rd->size;
+    while ((unsigned)rd->slot[i].res < rd->slot[i].want) {
+        unsigned got = rd->slot[i].res;
+        ssize_t n = pread(rd->fd, buf + URING_READ_KEEP + got, rd->slot[i].want - got,
+                          rd->slot[i].off + got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        if (n == 0) {
+            // Shrunk since it was opened, stop here
+            *last = 1;
+            break;
+        }
+        rd->slot[i].res += n;
+    }
+    buf[URING_READ_KEEP + rd->slot[i].res] = '\0';
+    rd->current = i;
+    rd->current_len = keep + rd->slot[i].res;
+    rd->head = (i + 1) % URING_READ_DEPTH;
+    *data = buf + URING_READ_KEEP - keep;
+    return rd->current_len;
+}
+
+void uring_reader_cleanup(uring_reader* rd) {
+    uring_result res;
+    // The kernel may still be reading into the buffers
+    while (rd->pending > 0 && uring_wait(&rd->ring, &res) == 0) {
+        rd->pending--;
+    }
+    uring_cleanup(&rd->ring);
+    // If one couldn't be waited for, leaking the buffers beats freeing them
+    // under the kernel
+    if (rd->pending == 0) free(rd->mem);
+    rd->mem = NULL;
+}
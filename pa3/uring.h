@@ -0,0 +1,135 @@
+/* uring.h
+ * Akira Youngblood, 2026-10-17
+ * io_uring file input and output for multi-lookup (-u)
+ *
+ * A bare-bones io_uring: the three system calls and the kernel's own
+ * header, no liburing. One ring belongs to one thread at a time; nothing
+ * here is shared.
+ *
+ *   - uring_reader reads a regular file front to back with
+ *     URING_READ_DEPTH reads of URING_READ_SIZE in flight at once, into
+ *     buffers registered with the ring, so the kernel doesn't map them
+ *     anew for every read. The caller scans each chunk in place, like a
+ *     mapped file (mapinput.h), while the reads after it are under way.
+ *   - outbuf.h uses a ring to write a full buffer out while the next one
+ *     fills (outbuf_use_uring()).
+ *
+ * Where io_uring isn't available (not Linux, an old kernel, turned off with
+ * kernel.io_uring_disabled or by a seccomp filter) every call fails and the
+ * caller goes back to read() and write(), so -u never makes a run fail.
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "mapinput.h"
+
+#define URING_READ_SIZE (1024 * 1024) // bytes per read
+#define URING_READ_DEPTH 4            // reads in flight per file
+// Bytes of a chunk that can be carried over in front of the next one: the
+// longest name, cut off at the end of a read
+#define URING_READ_KEEP MAPINPUT_MAX_NAME
+
+typedef struct uring_s {
+    int fd;                   // -1: not set up
+    // Submission and completion rings, shared with the kernel
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    void* sqes;               // struct io_uring_sqe[]
+    void* cqes;               // struct io_uring_cqe[]
+    void* sq_map;
+    size_t sq_map_size;
+    void* cq_map;             // == sq_map if the kernel maps both at once
+    size_t cq_map_size;
+    size_t sqes_size;
+} uring;
+
+typedef struct uring_result_s {
+    uint64_t tag;             // as given to uring_read()/uring_write()
+    int res;                  // bytes done, or -errno
+} uring_result;
+
+/* Whether io_uring works here at all (checked once)
+ * Returns 1 if it does, 0 if not
+ */
+int uring_supported(void);
+
+/* Set up a ring for up to entries operations in flight
+ * Returns 0 on success, -1 on failure (r->fd is -1 then)
+ */
+int uring_init(uring* r, unsigned entries);
+
+/* Start a read of len bytes at off into buf. fixed says buf lies in the
+ * buffer registered with uring_register().
+ * Returns 0, or -1 if it couldn't be started (the ring is full)
+ */
+int uring_read(uring* r, int fd, void* buf, unsigned len, uint64_t off, int fixed, uint64_t tag);
+
+/* Start a write of len bytes from buf at off
+ * Returns 0, or -1 if it couldn't be started (the ring is full)
+ */
+int uring_write(uring* r, int fd, const void* buf, unsigned len, uint64_t off, uint64_t tag);
+
+/* Register buf with the kernel, for uring_read() with fixed set
+ * Returns 0 on success, -1 on failure (reads into it can still go unfixed)
+ */
+int uring_register(uring* r, void* buf, size_t len);
+
+/* Wait for one read or write to complete, any one
+ * Returns 0 and fills *out, or -1 on failure
+ */
+int uring_wait(uring* r, uring_result* out);
+
+/* Tear the ring down. Operations still in flight must have been waited for
+ * first: the kernel may still be using their buffers.
+ */
+void uring_cleanup(uring* r);
+
+typedef struct uring_reader_s {
+    uring ring;
+    int fd;
+    int fixed;                // buffers are registered
+    char* mem;                // URING_READ_DEPTH buffers, see uring.c
+    uint64_t size;            // of the file, when it was opened
+    uint64_t next_off;        // where the next read starts
+    int head;                 // buffer with the next chunk, in file order
+    int current;              // buffer handed out last, -1 before the first
+    size_t current_len;
+    int pending;              // reads in flight
+    struct {
+        uint64_t off;
+        unsigned want;        // 0: past the end of the file, no read
+        int res;
+        int done;
+    } slot[URING_READ_DEPTH];
+} uring_reader;
+
+/* Start reading fd (a regular file, from the start) through a new ring
+ * Returns 0 on success, -1 if it can't be read that way (not a regular
+ * file, no io_uring): read it with stdio instead
+ */
+int uring_reader_init(uring_reader* rd, int fd);
+
+/* The next chunk of the file, in order. The last keep bytes of the previous
+ * chunk (at most URING_READ_KEEP) are put back in front of it, so a name cut
+ * off at the end of one chunk comes out whole at the start of the next.
+ * *data stays valid until the next call, is followed by a NUL byte and may
+ * be scanned in place with mapinput_next(). *last is set on the final
+ * chunk.
+ * Returns the chunk's length (0 for an empty file), or -1 on a read error
+ */
+ssize_t uring_reader_next(uring_reader* rd, size_t keep, char** data, int* last);
+
+/* Wait for reads still in flight and free the ring (fd is left open) */
+void uring_reader_cleanup(uring_reader* rd);
+
+#endif
@@ -3,7 +3,7 @@
  * Author: Andy Sayler
  * Project: CSCI 3753 Programming Assignment 2
  * Create Date: 2012/02/01
- * Modify Date: 2012/02/01
+ * Modify Date: 2026/10/17
  * Description:
  * 	This file contains declarations of utility functions for
  *      Programming Assignment 2.
@@ -12,13 +12,30 @@
 
 #include "util.h"
 
+/* Current backend, NULL for getaddrinfo() */
+static const dnsbackend* backend = NULL;
+
+void dnslookup_set_backend(const dnsbackend* b){
+    backend = (b && b->lookup) ? b : NULL;
+}
+
 int dnslookup(const char* hostname, char* firstIPstr, int maxSize){
 
+    if(backend){
+	return backend->lookup(backend->state, hostname,
+			       firstIPstr, maxSize);
+    }
+    return dnslookup_system(hostname, firstIPstr, maxSize);
+}
+
+int dnslookup_system(const char* hostname, char* firstIPstr, int maxSize){
+
     /* Local vars */
     struct addrinfo* headresult = NULL;
     struct addrinfo* result = NULL;
     struct sockaddr_in* ipv4sock = NULL;
     struct in_addr* ipv4addr = NULL;
+    struct sockaddr_in6* ipv6sock = NULL;
     char ipv4str[INET_ADDRSTRLEN];
     char ipstr[INET6_ADDRSTRLEN];
     int addrError = 0;
@@ -55,11 +72,16 @@ int dnslookup(const char* hostname, char* firstIPstr, int maxSize){
 	}
 	else if(result->ai_addr->sa_family == AF_INET6){
 	    /* IPv6 Handling */
+	    ipv6sock = (struct sockaddr_in6*)(result->ai_addr);
+	    if(!inet_ntop(AF_INET6, &(ipv6sock->sin6_addr),
+			  ipstr, sizeof(ipstr))){
+		perror("Error Converting IP to String");
+		freeaddrinfo(headresult);
+		return UTIL_FAILURE;
+	    }
 #ifdef UTIL_DEBUG
-	    fprintf(stdout, "IPv6 Address: Not Handled\n");
+	    fprintf(stdout, "%s\n", ipstr);
 #endif
-	    strncpy(ipstr, "UNHANDELED", sizeof(ipstr));
-	    ipstr[sizeof(ipstr)-1] = '\0';
 	}
 	else{
 	    /* Unhandlded Protocol Handling */
@@ -81,3 +103,102 @@ int dnslookup(const char* hostname, char* firstIPstr, int maxSize){
 
     return UTIL_SUCCESS;
 }
+
+int dnslookup_all(const char* hostname, dnsaddr* addrs,
+		  int maxAddrs, int* count){
+
+    if(backend){
+	*count = 0;
+	return backend->lookup_all(backend->state, hostname,
+				   addrs, maxAddrs, count);
+    }
+    return dnslookup_all_system(hostname, addrs, maxAddrs, count);
+}
+
+int dnslookup_all_system(const char* hostname, dnsaddr* addrs,
+			 int maxAddrs, int* count){
+
+    /* Local vars */
+    struct addrinfo hints;
+    struct addrinfo* headresult = NULL;
+    struct addrinfo* result = NULL;
+    const void* addr = NULL;
+    char ipstr[INET6_ADDRSTRLEN];
+    int addrError = 0;
+    int i;
+
+    *count = 0;
+
+    /* Lookup Hostname, A and AAAA at once. One socket type,
+     * or every address comes back once per type */
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrError = getaddrinfo(hostname, NULL, &hints, &headresult);
+    if(addrError){
+	fprintf(stderr, "Error looking up Address: %s\n",
+		gai_strerror(addrError));
+	return UTIL_FAILURE;
+    }
+    /* Loop Through result Linked List */
+    for(result=headresult; result != NULL && *count < maxAddrs;
+	result = result->ai_next){
+	if(result->ai_addr->sa_family == AF_INET){
+	    addr = &((struct sockaddr_in*)result->ai_addr)->sin_addr;
+	}
+	else if(result->ai_addr->sa_family == AF_INET6){
+	    addr = &((struct sockaddr_in6*)result->ai_addr)->sin6_addr;
+	}
+	else{
+	    /* Unknown Protocol, skip it */
+	    continue;
+	}
+	if(!inet_ntop(result->ai_addr->sa_family, addr,
+		      ipstr, sizeof(ipstr))){
+	    perror("Error Converting IP to String");
+	    continue;
+	}
+	/* Skip Duplicates (e.g. repeated in /etc/hosts) */
+	for(i = 0; i < *count; ++i){
+	    if(strcmp(addrs[i].str, ipstr) == 0){
+		break;
+	    }
+	}
+	if(i < *count){
+	    continue;
+	}
+	addrs[*count].family = result->ai_addr->sa_family;
+	strcpy(addrs[*count].str, ipstr);
+	(*count)++;
+    }
+
+    /* Cleanup */
+    freeaddrinfo(headresult);
+
+    return *count > 0 ? UTIL_SUCCESS : UTIL_FAILURE;
+}
+
+int dnsaddr_join(const dnsaddr* addrs, int count,
+		 char* buf, int size){
+
+    int i;
+    int len = 0;
+    int n;
+
+    if(size <= 0){
+	return 0;
+    }
+    buf[0] = '\0';
+    for(i = 0; i < count; ++i){
+	n = snprintf(buf + len, size - len, "%s%s",
+		     i ? "," : "", addrs[i].str);
+	if(n < 0 || n >= size - len){
+	    /* Didn't fit, drop the partial copy */
+	    buf[len] = '\0';
+	    break;
+	}
+	len += n;
+    }
+
+    return i;
+}
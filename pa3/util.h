@@ -3,7 +3,7 @@
  * Author: Andy Sayler
  * Project: CSCI 3753 Programming Assignment 2
  * Create Date: 2012/02/01
- * Modify Date: 2012/02/01
+ * Modify Date: 2026/10/17
  * Description:
  * 	This file contains declarations of utility functions for
  *      Programming Assignment 2.
@@ -29,6 +29,39 @@
 #define UTIL_FAILURE -1
 #define UTIL_SUCCESS 0
 
+/* Addresses kept by dnslookup_all() at most, and room for
+ * all of them joined with commas by dnsaddr_join()
+ */
+#define UTIL_MAX_ADDRS 16
+#define UTIL_ADDRS_STRLEN (UTIL_MAX_ADDRS * INET6_ADDRSTRLEN)
+
+/* One address found by dnslookup_all() */
+typedef struct dnsaddr_s {
+    int family; /* AF_INET or AF_INET6 */
+    char str[INET6_ADDRSTRLEN];
+} dnsaddr;
+
+/* Resolver backend behind dnslookup() and dnslookup_all(),
+ * see dnsbackend.h. lookup() and lookup_all() behave like
+ * the functions they stand in for, state is the backend's.
+ * A backend with no lookup() is getaddrinfo().
+ */
+typedef struct dnsbackend_s {
+    const char* name;
+    int (*lookup)(void* state, const char* hostname,
+		  char* firstIPstr, int maxSize);
+    int (*lookup_all)(void* state, const char* hostname,
+		      dnsaddr* addrs, int maxAddrs, int* count);
+    void (*cleanup)(void* state);
+    void* state;
+} dnsbackend;
+
+/* Function to route every lookup through backend
+ * (NULL: getaddrinfo()). Call before any thread looks
+ * anything up, the backend is shared by all of them.
+ */
+void dnslookup_set_backend(const dnsbackend* backend);
+
 /* Fuction to return the first IP address found
  * for hostname. IP address returned as string
  * firstIPstr of size maxsize
@@ -37,4 +70,34 @@ int dnslookup(const char* hostname,
 	      char* firstIPstr,
 	      int maxSize);
 
+/* Function to return every IPv4 and IPv6 address
+ * found for hostname from a single lookup, each once,
+ * in resolver order. Up to maxAddrs are stored in
+ * the caller's addrs array (nothing is allocated),
+ * *count is set to the number stored.
+ */
+int dnslookup_all(const char* hostname,
+		  dnsaddr* addrs,
+		  int maxAddrs,
+		  int* count);
+
+/* dnslookup() and dnslookup_all() straight to
+ * getaddrinfo(), whatever the backend. For backends
+ * that wrap the system resolver.
+ */
+int dnslookup_system(const char* hostname,
+		     char* firstIPstr,
+		     int maxSize);
+int dnslookup_all_system(const char* hostname,
+			 dnsaddr* addrs,
+			 int maxAddrs,
+			 int* count);
+
+/* Join count addresses as "a,b,c" into buf of size
+ * bytes, stopping before an address that doesn't fit.
+ * Returns the number of addresses written
+ */
+int dnsaddr_join(const dnsaddr* addrs, int count,
+		 char* buf, int size);
+
 #endif